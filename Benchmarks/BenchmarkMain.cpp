@@ -0,0 +1,401 @@
+#include "GrainEnvelopeTable.h"
+#include "GrainResampler.h"
+#include "GrainScheduler.h"
+#include "InputCaptureBuffer.h"
+#include "PluginProcessor.h"
+#include "StreamingSource.h"
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
+
+/**
+ * GranularPlunderphonicsBench - Microbenchmarks for the DSP hot paths
+ * Every benchmark reports the best of several timed trials in nanoseconds per output sample,
+ * and grain rendering also reports grains per second: grain-seconds of audio rendered per
+ * wall-clock second, i.e. how many simultaneous grains the engine could sustain in real time.
+ * Results are printed as JSON so that runs from different releases can be compared by script.
+ *
+ * Usage: GranularPlunderphonicsBench [--quick] [--filter <name>] [--output <file.json>]
+ */
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int numTrials = 5;
+    const int bufferSizes[] = { 16, 32, 64, 128, 256, 512, 1024, 2048 };
+    const int grainCounts[] = { 1, 4, 16, 64, 256, 1024, 4096 };
+
+    // Results are folded into this so the optimiser cannot drop the measured work
+    volatile float resultSink = 0.0f;
+
+    //==============================================================================
+    class BenchmarkRunner
+    {
+    public:
+        BenchmarkRunner(double secondsPerBenchmarkToUse, const juce::String& filterToUse)
+            : secondsPerBenchmark(secondsPerBenchmarkToUse), filter(filterToUse)
+        {
+        }
+
+        bool isEnabled(const juce::String& name) const
+        {
+            return filter.isEmpty() || name.containsIgnoreCase(filter);
+        }
+
+        /** Times function, which produces samplesPerCall output samples per call, and returns ns/sample. */
+        template <typename Function>
+        double measure(int samplesPerCall, Function&& function) const
+        {
+            for (int i = 0; i < 16; ++i)
+                function();
+
+            const auto ticksPerTrial = juce::Time::secondsToHighResolutionTicks(secondsPerBenchmark / numTrials);
+            auto best = std::numeric_limits<double>::max();
+
+            for (int trial = 0; trial < numTrials; ++trial)
+            {
+                const auto start = juce::Time::getHighResolutionTicks();
+                juce::int64 numCalls = 0;
+                juce::int64 elapsed = 0;
+
+                do
+                {
+                    function();
+                    ++numCalls;
+                    elapsed = juce::Time::getHighResolutionTicks() - start;
+                }
+                while (elapsed < ticksPerTrial);
+
+                const auto nanoseconds = juce::Time::highResolutionTicksToSeconds(elapsed) * 1.0e9;
+                best = std::min(best, nanoseconds / static_cast<double>(numCalls * samplesPerCall));
+            }
+
+            return best;
+        }
+
+        juce::DynamicObject::Ptr addResult(const juce::String& name, int bufferSize, double nsPerSample)
+        {
+            juce::DynamicObject::Ptr result = new juce::DynamicObject();
+            result->setProperty("name", name);
+            result->setProperty("buffer_size", bufferSize);
+            result->setProperty("ns_per_sample", nsPerSample);
+            results.add(juce::var(result.get()));
+
+            std::cerr << name << " @" << bufferSize << ": " << nsPerSample << " ns/sample" << std::endl;
+            return result;
+        }
+
+        juce::var getResults() const { return results; }
+
+    private:
+        const double secondsPerBenchmark;
+        const juce::String filter;
+        juce::Array<juce::var> results;
+    };
+
+    //==============================================================================
+    void benchmarkProcessBlock(BenchmarkRunner& runner)
+    {
+        const juce::String name("processBlock/passthrough");
+
+        if (! runner.isEnabled(name))
+            return;
+
+        // Default parameters: fully dry, with the default cloud still running underneath
+        for (auto bufferSize : bufferSizes)
+        {
+            GranularPlunderphonicsAudioProcessor processor;
+            processor.prepareToPlay(sampleRate, bufferSize);
+
+            juce::AudioBuffer<float> buffer(2, bufferSize);
+            juce::MidiBuffer midi;
+
+            const auto nsPerSample = runner.measure(bufferSize, [&]
+            {
+                buffer.clear();
+                buffer.setSample(0, 0, 0.5f);
+                processor.processBlock(buffer, midi);
+                resultSink = resultSink + buffer.getSample(1, 0);
+            });
+
+            runner.addResult(name, bufferSize, nsPerSample);
+            processor.releaseResources();
+        }
+    }
+
+    void benchmarkGrainRender(BenchmarkRunner& runner)
+    {
+        constexpr float grainSizeMs = 100.0f;
+
+        for (auto multiThreaded : { false, true })
+        {
+            const juce::String name(multiThreaded ? "grains/render_multicore" : "grains/render");
+
+            if (! runner.isEnabled(name))
+                continue;
+
+            for (auto bufferSize : bufferSizes)
+            {
+                for (auto numGrains : grainCounts)
+                {
+                    // With 100 ms grains, ten spawns per second per grain keep numGrains alive
+                    GrainScheduler::Settings settings;
+                    settings.density = static_cast<float>(numGrains) * 1000.0f / grainSizeMs;
+                    settings.grainSizeMs = grainSizeMs;
+                    settings.spray = 0.5f;
+                    settings.playbackRate = GrainScheduler::getPlaybackRate(3.0f, 1.0f);
+                    settings.multiThreaded = multiThreaded;
+
+                    InputCaptureBuffer capture;
+                    capture.prepare(static_cast<int>(sampleRate * 4.0));
+
+                    GrainScheduler scheduler;
+                    scheduler.prepare(sampleRate, bufferSize, settings.density,
+                                      multiThreaded ? GrainRenderPool::getDefaultNumWorkers() : 0);
+
+                    juce::AudioBuffer<float> input(1, bufferSize), output(2, bufferSize);
+                    juce::Random random(1);
+
+                    for (int i = 0; i < bufferSize; ++i)
+                        input.setSample(0, i, random.nextFloat() * 2.0f - 1.0f);
+
+                    const auto processBlock = [&]
+                    {
+                        capture.write(input.getReadPointer(0), bufferSize);
+                        output.clear();
+                        scheduler.process(settings, capture, output.getWritePointer(0), output.getWritePointer(1), bufferSize);
+                    };
+
+                    // Let the cloud reach its steady state first; grains live for a tenth of this
+                    for (int elapsed = 0; elapsed < static_cast<int>(sampleRate); elapsed += bufferSize)
+                        processBlock();
+
+                    juce::int64 activeGrainSum = 0;
+                    juce::int64 numBlocks = 0;
+
+                    const auto nsPerSample = runner.measure(bufferSize, [&]
+                    {
+                        processBlock();
+                        activeGrainSum += scheduler.getNumActiveGrains();
+                        ++numBlocks;
+                        resultSink = resultSink + output.getSample(0, 0);
+                    });
+
+                    const auto activeGrains = static_cast<double>(activeGrainSum) / static_cast<double>(std::max<juce::int64>(1, numBlocks));
+                    const auto audioSecondsPerWallSecond = 1.0e9 / (nsPerSample * sampleRate);
+
+                    auto result = runner.addResult(name, bufferSize, nsPerSample);
+                    result->setProperty("grains", numGrains);
+                    result->setProperty("active_grains", activeGrains);
+                    result->setProperty("grains_per_second", activeGrains * audioSecondsPerWallSecond);
+                    result->setProperty("render_workers", scheduler.getNumRenderWorkers());
+                }
+            }
+        }
+    }
+
+    void benchmarkEnvelopeLookup(BenchmarkRunner& runner)
+    {
+        GrainEnvelopeTables tables;
+        const std::pair<const char*, GrainEnvelopeShape> shapes[] = { { "hann", GrainEnvelopeShape::hann },
+                                                                      { "tukey", GrainEnvelopeShape::tukey },
+                                                                      { "gaussian", GrainEnvelopeShape::gaussian },
+                                                                      { "trapezoid", GrainEnvelopeShape::trapezoid } };
+
+        for (const auto& shape : shapes)
+        {
+            const auto name = juce::String("envelope/") + shape.first;
+
+            if (! runner.isEnabled(name))
+                continue;
+
+            for (auto bufferSize : bufferSizes)
+            {
+                std::vector<float> output(static_cast<size_t>(bufferSize));
+                const auto increment = 1.0f / static_cast<float>(bufferSize);
+
+                tables.visit(shape.second, [&](const auto& table)
+                {
+                    const auto nsPerSample = runner.measure(bufferSize, [&]
+                    {
+                        for (int i = 0; i < bufferSize; ++i)
+                            output[static_cast<size_t>(i)] = table.lookup(increment * static_cast<float>(i));
+
+                        resultSink = resultSink + output.back();
+                    });
+
+                    runner.addResult(name, bufferSize, nsPerSample);
+                });
+            }
+        }
+    }
+
+    void benchmarkResampler(BenchmarkRunner& runner)
+    {
+        using FloatVector = GrainInterpolators::FloatVector;
+        constexpr int vectorSize = GrainInterpolators::vectorSize;
+
+        GrainResampler resampler;
+        resampler.waitForTables();
+
+        const std::pair<const char*, ResamplerQuality> tiers[] = { { "linear", ResamplerQuality::linear },
+                                                                   { "hermite", ResamplerQuality::hermite },
+                                                                   { "sinc", ResamplerQuality::sinc } };
+
+        for (const auto& tier : tiers)
+        {
+            for (auto playbackRate : { 1.0f, 2.0f })
+            {
+                const auto name = juce::String("resampler/") + tier.first + (playbackRate > 1.0f ? "_2x" : "_1x");
+
+                if (! runner.isEnabled(name))
+                    continue;
+
+                for (auto bufferSize : bufferSizes)
+                {
+                    // Enough source for the fastest read, plus the widest interpolator's taps on either side
+                    const auto paddedSize = ((bufferSize + vectorSize - 1) / vectorSize) * vectorSize;
+                    std::vector<float> source(static_cast<size_t>(paddedSize * 2 + GrainInterpolators::maxTaps * 2));
+                    AlignedBuffer<float> output;
+                    output.allocate(paddedSize);
+
+                    juce::Random random(2);
+
+                    for (auto& sample : source)
+                        sample = random.nextFloat() * 2.0f - 1.0f;
+
+                    resampler.visit(tier.second, playbackRate, [&](const auto& interpolator)
+                    {
+                        const auto* start = source.data() + GrainInterpolators::maxTaps;
+
+                        const auto nsPerSample = runner.measure(bufferSize, [&]
+                        {
+                            alignas(FloatVector::SIMDRegisterSize) float positions[vectorSize];
+
+                            for (int i = 0; i < bufferSize; i += vectorSize)
+                            {
+                                for (int lane = 0; lane < vectorSize; ++lane)
+                                    positions[lane] = 0.37f + playbackRate * static_cast<float>(i + lane);
+
+                                interpolator.process(start, positions).copyToRawArray(output.get() + i);
+                            }
+
+                            resultSink = resultSink + output[0];
+                        });
+
+                        runner.addResult(name, bufferSize, nsPerSample);
+                    });
+                }
+            }
+        }
+    }
+
+    void benchmarkStreamingCache(BenchmarkRunner& runner)
+    {
+        const juce::String name("streaming/cache_hit");
+
+        if (! runner.isEnabled(name))
+            return;
+
+        // A short FLAC file whose first chunk fits the cache, so every read is a hit
+        juce::TemporaryFile tempFile(".flac");
+        {
+            juce::FlacAudioFormat flac;
+            std::unique_ptr<juce::AudioFormatWriter> writer(flac.createWriterFor(tempFile.getFile().createOutputStream().release(),
+                                                                                 sampleRate, 2, 24, {}, 0));
+
+            if (writer == nullptr)
+                return;
+
+            juce::AudioBuffer<float> buffer(2, StreamingSource::chunkSize);
+            juce::Random random(3);
+
+            for (int channel = 0; channel < 2; ++channel)
+                for (int i = 0; i < buffer.getNumSamples(); ++i)
+                    buffer.setSample(channel, i, random.nextFloat() - 0.5f);
+
+            writer->writeFromAudioSampleBuffer(buffer, 0, buffer.getNumSamples());
+        }
+
+        StreamingSource source;
+
+        if (! source.loadFile(tempFile.getFile()))
+            return;
+
+        for (int attempt = 0; attempt < 1000 && ! source.isCached(0); ++attempt)
+            juce::Thread::sleep(1);
+
+        for (auto bufferSize : bufferSizes)
+        {
+            std::vector<float> output(static_cast<size_t>(bufferSize));
+            juce::int64 position = 0;
+
+            const auto nsPerSample = runner.measure(bufferSize, [&]
+            {
+                source.readSamples(output.data(), position, bufferSize);
+                position = (position + 997) % (StreamingSource::chunkSize - bufferSize);
+                resultSink = resultSink + output[0];
+            });
+
+            auto result = runner.addResult(name, bufferSize, nsPerSample);
+            result->setProperty("cache_misses", static_cast<int>(source.getNumCacheMisses()));
+        }
+
+        source.unload();
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::StringArray arguments;
+
+    for (int i = 1; i < argc; ++i)
+        arguments.add(argv[i]);
+
+    const auto quick = arguments.contains("--quick");
+    const auto filterIndex = arguments.indexOf("--filter");
+    const auto outputIndex = arguments.indexOf("--output");
+
+    BenchmarkRunner runner(quick ? 0.01 : 0.1, filterIndex >= 0 ? arguments[filterIndex + 1] : juce::String());
+
+    benchmarkProcessBlock(runner);
+    benchmarkGrainRender(runner);
+    benchmarkEnvelopeLookup(runner);
+    benchmarkResampler(runner);
+    benchmarkStreamingCache(runner);
+
+    juce::DynamicObject::Ptr system = new juce::DynamicObject();
+    system->setProperty("cpu", juce::SystemStats::getCpuModel());
+    system->setProperty("cores", juce::SystemStats::getNumCpus());
+    system->setProperty("os", juce::SystemStats::getOperatingSystemName());
+    system->setProperty("simd_lanes", GrainScheduler::vectorSize);
+
+    juce::DynamicObject::Ptr report = new juce::DynamicObject();
+    report->setProperty("benchmark", "GranularPlunderphonicsBench");
+    report->setProperty("version", GRANULAR_VERSION_STRING);
+    report->setProperty("sample_rate", sampleRate);
+    report->setProperty("system", juce::var(system.get()));
+    report->setProperty("results", runner.getResults());
+
+    const auto json = juce::JSON::toString(juce::var(report.get()));
+
+    if (outputIndex >= 0 && arguments[outputIndex + 1].isNotEmpty())
+    {
+        if (! juce::File::getCurrentWorkingDirectory().getChildFile(arguments[outputIndex + 1]).replaceWithText(json))
+        {
+            std::cerr << "Could not write " << arguments[outputIndex + 1] << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        std::cout << json << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,300 @@
+#include "PluginProcessor.h"
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/**
+ * GranularPlunderphonicsCLI - Headless batch renderer built on the plugin's own processor
+ * Every job runs a processor of its own in offline (batch) mode, without an editor: it
+ * restores a saved state, loads a source file, feeds an optional input file through the
+ * plugin's mono input and streams the stereo result to a WAV or FLAC file block by block,
+ * as fast as the CPU allows. Several jobs render at once, one per core by default, each with
+ * its grains on its own thread; a single job spreads its grains over every core instead.
+ *
+ * Usage: GranularPlunderphonicsCLI [job options] --output <file.wav|file.flac>
+ *        GranularPlunderphonicsCLI --jobs <jobs.json> [--parallel <count>]
+ *
+ * Job options: --state <file>     Saved plugin state, as written by getStateInformation()
+ *              --source <file>    Source file, replacing the one the state refers to
+ *              --input <file>     Audio fed to the plugin's input; its left channel is used
+ *              --length <seconds> Length to render; defaults to the length of the input
+ *              --rate <hz>        Sample rate; defaults to the input's, or 48000
+ *              --block <samples>  Block size handed to the processor (8192)
+ *              --bits <count>     Bits per output sample (24)
+ *              --seed <number>    Random seed, replacing the state's; renders with the same seed match
+ *
+ * A jobs file is a JSON array of objects with the same keys, without the dashes, e.g.
+ * [ { "state": "a.state", "source": "loop.flac", "length": 60, "output": "out/a.flac" } ].
+ * Relative paths in it are resolved against the jobs file's directory.
+ */
+namespace
+{
+    constexpr double defaultSampleRate = 48000.0;
+    constexpr int defaultBlockSize = GranularPlunderphonicsAudioProcessor::batchBlockSize;
+    constexpr int defaultBitsPerSample = 24;
+
+    struct RenderJob
+    {
+        juce::File state, source, input, output;
+        double lengthSeconds = 0.0;   // 0 = the length of the input
+        double sampleRate = 0.0;      // 0 = the rate of the input, or defaultSampleRate
+        int blockSize = defaultBlockSize;
+        int bitsPerSample = defaultBitsPerSample;
+        juce::String seed;            // Empty = the state's seed, or a new one without a state
+    };
+
+    /** Builds a job from getOption(name), which returns an empty string for options not given. */
+    template <typename OptionGetter>
+    RenderJob parseJob(OptionGetter&& getOption, const juce::File& baseDirectory)
+    {
+        const auto getFile = [&](const char* name)
+        {
+            const auto path = getOption(name);
+            return path.isNotEmpty() ? baseDirectory.getChildFile(path) : juce::File();
+        };
+
+        RenderJob job;
+        job.state = getFile("state");
+        job.source = getFile("source");
+        job.input = getFile("input");
+        job.output = getFile("output");
+        job.lengthSeconds = getOption("length").getDoubleValue();
+        job.sampleRate = getOption("rate").getDoubleValue();
+
+        if (getOption("block").isNotEmpty())
+            job.blockSize = getOption("block").getIntValue();
+
+        if (getOption("bits").isNotEmpty())
+            job.bitsPerSample = getOption("bits").getIntValue();
+
+        job.seed = getOption("seed");
+
+        return job;
+    }
+
+    //==============================================================================
+    /** Creates a writer for file, truncating whatever was there, in the format its extension names. */
+    std::unique_ptr<juce::AudioFormatWriter> createWriter(juce::AudioFormatManager& formatManager, const juce::File& file,
+                                                          double sampleRate, int bitsPerSample)
+    {
+        auto* format = formatManager.findFormatForFileExtension(file.getFileExtension());
+
+        if (format == nullptr || ! file.getParentDirectory().createDirectory())
+            return nullptr;
+
+        auto stream = std::make_unique<juce::FileOutputStream>(file);
+
+        if (stream->failedToOpen() || ! stream->setPosition(0) || stream->truncate().failed())
+            return nullptr;
+
+        std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(), sampleRate, 2,
+                                                                                bitsPerSample, {}, 0));
+
+        // The writer owns the stream only once it has been created
+        if (writer != nullptr)
+            stream.release();
+
+        return writer;
+    }
+
+    /** Renders one job with the given number of render workers, -1 for one per spare core. */
+    juce::Result render(const RenderJob& job, int numRenderWorkers)
+    {
+        if (job.output == juce::File())
+            return juce::Result::fail("no output file given");
+
+        if (job.blockSize <= 0)
+            return juce::Result::fail("the block size must be positive");
+
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> input;
+
+        if (job.input != juce::File())
+        {
+            input.reset(formatManager.createReaderFor(job.input));
+
+            if (input == nullptr)
+                return juce::Result::fail("cannot read " + job.input.getFullPathName());
+        }
+
+        const auto sampleRate = job.sampleRate > 0.0 ? job.sampleRate
+                              : input != nullptr ? input->sampleRate : defaultSampleRate;
+
+        // The input is read as it is, so it has to be at the rate the plugin runs at
+        if (input != nullptr && input->sampleRate != sampleRate)
+            return juce::Result::fail(job.input.getFileName() + " is at " + juce::String(input->sampleRate)
+                                      + " Hz, not the render rate of " + juce::String(sampleRate) + " Hz");
+
+        const auto lengthInSamples = job.lengthSeconds > 0.0 ? static_cast<juce::int64>(std::ceil(job.lengthSeconds * sampleRate))
+                                   : input != nullptr ? input->lengthInSamples : 0;
+
+        if (lengthInSamples <= 0)
+            return juce::Result::fail("no length given, and no input to take it from");
+
+        GranularPlunderphonicsAudioProcessor processor;
+        processor.setNonRealtime(true);
+        processor.setBatchRenderWorkers(numRenderWorkers);
+
+        if (job.state != juce::File())
+        {
+            juce::MemoryBlock state;
+
+            if (! job.state.loadFileAsData(state))
+                return juce::Result::fail("cannot read " + job.state.getFullPathName());
+
+            processor.setStateInformation(state.getData(), static_cast<int>(state.getSize()));
+        }
+
+        if (job.seed.isNotEmpty())
+            processor.setRandomSeed(job.seed.getLargeIntValue());
+
+        if (job.source != juce::File() && ! processor.loadSource(job.source))
+            return juce::Result::fail("cannot open " + job.source.getFullPathName());
+
+        // Sources open, and their onsets are found, in the background; a render waits for both
+        while (processor.isLoadingSource() || processor.isAnalysingSource())
+            juce::Thread::sleep(5);
+
+        if (job.source != juce::File() && processor.getSourceFile() != job.source)
+            return juce::Result::fail("cannot open " + job.source.getFullPathName());
+
+        auto writer = createWriter(formatManager, job.output, sampleRate, job.bitsPerSample);
+
+        if (writer == nullptr)
+            return juce::Result::fail("cannot write " + juce::String(job.bitsPerSample) + "-bit audio to "
+                                      + job.output.getFullPathName());
+
+        processor.setRateAndBufferSizeDetails(sampleRate, job.blockSize);
+        processor.prepareToPlay(sampleRate, job.blockSize);
+
+        juce::AudioBuffer<float> buffer(2, job.blockSize);
+        juce::MidiBuffer midi;
+        auto result = juce::Result::ok();
+
+        // Blocks smaller than the processor's batch come out one batch late, so the render runs
+        // on past the end of the input by that much and the samples before it are dropped
+        const auto latency = static_cast<juce::int64>(processor.getLatencySamples());
+
+        for (juce::int64 position = 0; position < lengthInSamples + latency && result.wasOk(); position += job.blockSize)
+        {
+            const auto numSamples = static_cast<int>(std::min<juce::int64>(job.blockSize, lengthInSamples + latency - position));
+            buffer.setSize(2, numSamples, false, false, true);
+            buffer.clear();
+
+            if (input != nullptr && position < lengthInSamples)
+                input->read(&buffer, 0, numSamples, position, true, false);
+
+            processor.processBlock(buffer, midi);
+
+            const auto skip = static_cast<int>(juce::jlimit<juce::int64>(0, numSamples, latency - position));
+
+            if (skip < numSamples && ! writer->writeFromAudioSampleBuffer(buffer, skip, numSamples - skip))
+                result = juce::Result::fail("cannot write to " + job.output.getFullPathName());
+        }
+
+        processor.releaseResources();
+
+        // Streamed sources are decoded while the render runs, so one far faster than real time can outrun them
+        const auto cacheMisses = processor.getPerformanceStatistics().cacheMisses;
+
+        if (result.wasOk() && cacheMisses > 0)
+            std::cerr << job.output.getFileName() << ": " << cacheMisses << " source cache misses rendered as silence" << std::endl;
+
+        return result;
+    }
+
+    //==============================================================================
+    /** Reads the jobs file, or returns an empty list after reporting why it could not. */
+    std::vector<RenderJob> readJobs(const juce::File& file)
+    {
+        std::vector<RenderJob> jobs;
+        const auto parsed = juce::JSON::parse(file);
+
+        if (! parsed.isArray())
+        {
+            std::cerr << file.getFullPathName() << " is not a JSON array of jobs" << std::endl;
+            return jobs;
+        }
+
+        for (const auto& entry : *parsed.getArray())
+        {
+            jobs.push_back(parseJob([&entry](const char* name) { return entry.getProperty(name, {}).toString(); },
+                                    file.getParentDirectory()));
+        }
+
+        return jobs;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    // The processor's parameters and background threads expect JUCE to be initialised
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::StringArray arguments;
+
+    for (int i = 1; i < argc; ++i)
+        arguments.add(argv[i]);
+
+    const auto getOption = [&arguments](const char* name)
+    {
+        const auto index = arguments.indexOf(juce::String("--") + name);
+        return index >= 0 ? arguments[index + 1] : juce::String();
+    };
+
+    const auto jobsPath = getOption("jobs");
+    const auto workingDirectory = juce::File::getCurrentWorkingDirectory();
+    const auto jobs = jobsPath.isNotEmpty() ? readJobs(workingDirectory.getChildFile(jobsPath))
+                                            : std::vector<RenderJob> { parseJob(getOption, workingDirectory) };
+
+    if (jobs.empty())
+        return 1;
+
+    // Whole jobs in parallel scale better than the grains of one, so workers only help a lone job
+    const auto requestedParallel = getOption("parallel").getIntValue();
+    const auto numParallel = juce::jlimit(1, static_cast<int>(jobs.size()),
+                                          requestedParallel > 0 ? requestedParallel : juce::SystemStats::getNumCpus());
+    const auto numRenderWorkers = numParallel > 1 ? 0 : -1;
+
+    std::vector<juce::Result> results(jobs.size(), juce::Result::ok());
+    std::atomic<int> numRemaining { static_cast<int>(jobs.size()) };
+    juce::CriticalSection outputLock;
+
+    {
+        juce::ThreadPool pool(numParallel);
+
+        for (size_t i = 0; i < jobs.size(); ++i)
+        {
+            pool.addJob([&, i]
+            {
+                const auto startTicks = juce::Time::getHighResolutionTicks();
+                results[i] = render(jobs[i], numRenderWorkers);
+
+                const auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+                const juce::ScopedLock scope(outputLock);
+
+                if (results[i].wasOk())
+                    std::cerr << jobs[i].output.getFullPathName() << " (" << seconds << " s)" << std::endl;
+                else
+                    std::cerr << "Job " << (i + 1) << " failed: " << results[i].getErrorMessage() << std::endl;
+
+                --numRemaining;
+            });
+        }
+
+        while (numRemaining.load() > 0)
+            juce::Thread::sleep(20);
+    }
+
+    const auto failed = std::count_if(results.begin(), results.end(), [](const juce::Result& result) { return result.failed(); });
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * AlignedBuffer - Heap array of trivially copyable elements aligned for the widest SIMD register
+ * Allocation only happens in allocate() and ensureSize(); element access is a plain pointer so the buffer can
+ * be handed straight to juce::dsp::SIMDRegister::fromRawArray and FloatVectorOperations.
+ */
+template <typename Type>
+class AlignedBuffer
+{
+public:
+    static_assert(std::is_trivially_copyable<Type>::value, "AlignedBuffer only holds plain data");
+
+    /** Large enough for AVX-512 registers and a cache line. */
+    static constexpr size_t alignment = 64;
+
+    AlignedBuffer() = default;
+
+    //==============================================================================
+    /** Allocates room for numElements and zero-fills it. Must not be called from the audio thread. */
+    void allocate(int numElements)
+    {
+        jassert(numElements >= 0);
+
+        storage.allocate(sizeof(Type) * static_cast<size_t>(numElements) + alignment, true);
+
+        const auto address = reinterpret_cast<std::uintptr_t>(storage.get());
+        data = reinterpret_cast<Type*>((address + alignment - 1) & ~static_cast<std::uintptr_t>(alignment - 1));
+        numAllocated = numElements;
+    }
+
+    /**
+     * Allocates like allocate() if the buffer holds fewer than numElements, and otherwise keeps
+     * the existing allocation and its contents. Must not be called from the audio thread.
+     */
+    void ensureSize(int numElements)
+    {
+        if (data == nullptr || numAllocated < numElements)
+            allocate(numElements);
+    }
+
+    void free() noexcept
+    {
+        storage.free();
+        data = nullptr;
+        numAllocated = 0;
+    }
+
+    void clear() noexcept
+    {
+        if (data != nullptr)
+            std::memset(static_cast<void*>(data), 0, sizeof(Type) * static_cast<size_t>(numAllocated));
+    }
+
+    //==============================================================================
+    Type* get() noexcept { return data; }
+    const Type* get() const noexcept { return data; }
+
+    Type& operator[](int index) noexcept { return data[index]; }
+    const Type& operator[](int index) const noexcept { return data[index]; }
+
+    int size() const noexcept { return numAllocated; }
+
+private:
+    //==============================================================================
+    juce::HeapBlock<char> storage;
+    Type* data = nullptr;
+    int numAllocated = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(AlignedBuffer)
+};
@@ -0,0 +1,236 @@
+#include "AnalysisCache.h"
+
+#include <algorithm>
+
+//==============================================================================
+namespace
+{
+    constexpr juce::uint32 magic = 0x43415047;   // "GPAC"
+    constexpr size_t headerSize = 40;
+    constexpr size_t sectionEntrySize = 24;
+    constexpr size_t sectionAlignment = 8;
+    const char* const entryExtension = ".gpac";
+
+    /** 64-bit FNV-1a, enough to tell sources apart; this is not a security boundary. */
+    struct ContentHasher
+    {
+        void add(const void* data, size_t size) noexcept
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                hash ^= static_cast<const juce::uint8*>(data)[i];
+                hash *= 0x100000001b3ull;
+            }
+        }
+
+        juce::uint64 hash = 0xcbf29ce484222325ull;
+    };
+
+    size_t alignSection(size_t offset) noexcept
+    {
+        return (offset + sectionAlignment - 1) & ~(sectionAlignment - 1);
+    }
+
+    juce::uint32 readUInt32(const char* data) noexcept { return juce::ByteOrder::littleEndianInt(data); }
+    juce::uint64 readUInt64(const char* data) noexcept { return juce::ByteOrder::littleEndianInt64(data); }
+}
+
+//==============================================================================
+AnalysisCache::Key AnalysisCache::Key::of(const juce::File& file)
+{
+    Key key;
+    juce::FileInputStream stream(file);
+
+    if (! stream.openedOk() || stream.getTotalLength() <= 0)
+        return key;
+
+    const auto length = stream.getTotalLength();
+
+    ContentHasher hasher;
+    hasher.add(&length, sizeof(length));
+
+    juce::HeapBlock<char> block(static_cast<size_t>(hashBlockSize));
+    const juce::int64 blockStarts[] = { 0, length / 2 - hashBlockSize / 2, length - hashBlockSize };
+
+    for (auto start : blockStarts)
+    {
+        if (! stream.setPosition(juce::jlimit<juce::int64>(0, length, start)))
+            return key;
+
+        const auto numRead = stream.read(block.get(), hashBlockSize);
+
+        if (numRead < 0)
+            return key;
+
+        hasher.add(block.get(), static_cast<size_t>(numRead));
+    }
+
+    key.fileSize = length;
+    key.modificationTime = file.getLastModificationTime().toMilliseconds();
+    key.contentHash = hasher.hash;
+    return key;
+}
+
+juce::String AnalysisCache::Key::getEntryName() const
+{
+    return juce::String::toHexString(static_cast<juce::int64>(contentHash)).paddedLeft('0', 16)
+         + "-" + juce::String::toHexString(fileSize) + entryExtension;
+}
+
+//==============================================================================
+const void* AnalysisCache::Entry::getSection(SectionType type, size_t& size) const noexcept
+{
+    for (const auto& section : sections)
+    {
+        if (section.type == type)
+        {
+            size = section.size;
+            return section.data;
+        }
+    }
+
+    size = 0;
+    return nullptr;
+}
+
+//==============================================================================
+AnalysisCache::AnalysisCache(const juce::File& directoryToUse, juce::int64 maxBytesToUse)
+    : directory(directoryToUse), maxBytes(maxBytesToUse)
+{
+}
+
+juce::File AnalysisCache::getDefaultDirectory()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+               .getChildFile("GranularPlunderphonics")
+               .getChildFile("AnalysisCache");
+}
+
+juce::File AnalysisCache::getEntryFile(const Key& key) const
+{
+    return directory.getChildFile(key.getEntryName());
+}
+
+std::unique_ptr<AnalysisCache::Entry> AnalysisCache::open(const Key& key) const
+{
+    if (! key.isValid())
+        return nullptr;
+
+    const auto file = getEntryFile(key);
+
+    if (! file.existsAsFile())
+        return nullptr;
+
+    std::unique_ptr<Entry> entry(new Entry());
+    entry->mapping = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+
+    const auto* data = static_cast<const char*>(entry->mapping->getData());
+    const auto size = entry->mapping->getSize();
+
+    if (data == nullptr || size < headerSize)
+        return nullptr;
+
+    // The name encodes the hash and size; the header confirms them, the version and the
+    // modification time, which catches edits outside the hashed blocks
+    if (readUInt32(data) != magic
+        || static_cast<int>(readUInt32(data + 4)) != formatVersion
+        || static_cast<juce::int64>(readUInt64(data + 8)) != key.fileSize
+        || readUInt64(data + 16) != key.contentHash
+        || static_cast<juce::int64>(readUInt64(data + 24)) != key.modificationTime)
+        return nullptr;
+
+    const auto numSections = static_cast<size_t>(readUInt32(data + 32));
+
+    if (numSections > (size - headerSize) / sectionEntrySize)
+        return nullptr;
+
+    for (size_t i = 0; i < numSections; ++i)
+    {
+        const auto* sectionEntry = data + headerSize + i * sectionEntrySize;
+        const auto offset = readUInt64(sectionEntry + 8);
+        const auto length = readUInt64(sectionEntry + 16);
+
+        if (offset > size || length > size - offset)
+            return nullptr;
+
+        entry->sections.push_back({ static_cast<SectionType>(readUInt32(sectionEntry)),
+                                    data + offset, static_cast<size_t>(length) });
+    }
+
+    entry->key = key;
+
+    // Last access time drives trimming
+    file.setLastAccessTime(juce::Time::getCurrentTime());
+    return entry;
+}
+
+bool AnalysisCache::store(const Key& key, const std::vector<Section>& sections) const
+{
+    if (! key.isValid() || ! directory.createDirectory())
+        return false;
+
+    juce::MemoryOutputStream stream;
+    stream.writeInt(static_cast<int>(magic));
+    stream.writeInt(formatVersion);
+    stream.writeInt64(key.fileSize);
+    stream.writeInt64(static_cast<juce::int64>(key.contentHash));
+    stream.writeInt64(key.modificationTime);
+    stream.writeInt(static_cast<int>(sections.size()));
+    stream.writeInt(0);
+
+    auto offset = alignSection(headerSize + sections.size() * sectionEntrySize);
+
+    for (const auto& section : sections)
+    {
+        stream.writeInt(static_cast<int>(section.type));
+        stream.writeInt(0);
+        stream.writeInt64(static_cast<juce::int64>(offset));
+        stream.writeInt64(static_cast<juce::int64>(section.size));
+        offset = alignSection(offset + section.size);
+    }
+
+    for (const auto& section : sections)
+    {
+        stream.writeRepeatedByte(0, alignSection(stream.getDataSize()) - stream.getDataSize());
+        stream.write(section.data, section.size);
+    }
+
+    // Written beside the entry and renamed over it, so readers only ever map complete files
+    const auto file = getEntryFile(key);
+    juce::TemporaryFile temporary(file);
+
+    if (! temporary.getFile().replaceWithData(stream.getData(), stream.getDataSize())
+        || ! temporary.overwriteTargetFileWithTemporary())
+        return false;
+
+    trim();
+    return true;
+}
+
+void AnalysisCache::trim() const
+{
+    auto entries = directory.findChildFiles(juce::File::findFiles, false, juce::String("*") + entryExtension);
+    juce::int64 totalBytes = 0;
+
+    for (const auto& entry : entries)
+        totalBytes += entry.getSize();
+
+    if (totalBytes <= maxBytes)
+        return;
+
+    std::sort(entries.begin(), entries.end(), [](const juce::File& a, const juce::File& b)
+    {
+        return a.getLastAccessTime() < b.getLastAccessTime();
+    });
+
+    for (const auto& entry : entries)
+    {
+        if (totalBytes <= maxBytes)
+            break;
+
+        const auto entrySize = entry.getSize();
+
+        if (entry.deleteFile())
+            totalBytes -= entrySize;
+    }
+}
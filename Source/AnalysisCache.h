@@ -0,0 +1,110 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <memory>
+#include <vector>
+
+/**
+ * AnalysisCache - On-disk store of per-source analysis results, keyed by source content
+ * Each source file gets one entry file named after a hash of its size and of three 64 KB
+ * blocks sampled from its start, middle and end, so renamed or moved material still hits;
+ * the entry also records the modification time, and any mismatch counts as a miss.
+ * An entry is a small header plus a table of 8-byte aligned binary sections (onsets and the
+ * waveform overview today, any other analysis later), laid out to be read in place through a memory mapping.
+ * Validation is one stat() and at most 192 KB of reads. It, and every other call here,
+ * touches the disk, so it belongs on a background thread, never the message or audio thread.
+ * Entries are written to a temporary file and renamed, so concurrent instances never see a
+ * partial entry, and the least recently used entries are deleted beyond a size budget.
+ */
+class AnalysisCache
+{
+public:
+    //==============================================================================
+    static constexpr int formatVersion = 1;
+    static constexpr int hashBlockSize = 65536;
+    static constexpr juce::int64 defaultMaxBytes = 512 * 1024 * 1024;
+
+    /** Section identifiers, stored as four-character codes. */
+    enum class SectionType : juce::uint32
+    {
+        onsets = 0x54534e4f,    // "ONST"
+        waveform = 0x45564157   // "WAVE"
+    };
+
+    /** Identifies a source's content; cheap enough to compute on every load. */
+    struct Key
+    {
+        juce::int64 fileSize = 0;
+        juce::int64 modificationTime = 0;
+        juce::uint64 contentHash = 0;
+
+        /** Returns an invalid key (fileSize 0) if the file cannot be read. */
+        static Key of(const juce::File& file);
+
+        bool isValid() const noexcept { return fileSize > 0; }
+        juce::String getEntryName() const;
+    };
+
+    /** One section to store; data must stay valid for the store() call. */
+    struct Section
+    {
+        SectionType type;
+        const void* data = nullptr;
+        size_t size = 0;
+    };
+
+    //==============================================================================
+    /** A memory-mapped, validated cache entry. Sections point straight into the mapping. */
+    class Entry
+    {
+    public:
+        /** Returns the section's bytes, or nullptr if the entry has no such section. */
+        const void* getSection(SectionType type, size_t& size) const noexcept;
+
+        const Key& getKey() const noexcept { return key; }
+
+    private:
+        friend class AnalysisCache;
+        Entry() = default;
+
+        struct SectionInfo
+        {
+            SectionType type;
+            const char* data;
+            size_t size;
+        };
+
+        std::unique_ptr<juce::MemoryMappedFile> mapping;
+        std::vector<SectionInfo> sections;
+        Key key;
+
+        JUCE_DECLARE_NON_COPYABLE(Entry)
+    };
+
+    //==============================================================================
+    explicit AnalysisCache(const juce::File& directory, juce::int64 maxBytes = defaultMaxBytes);
+
+    /** The per-user cache shared by every instance of the plugin. */
+    static juce::File getDefaultDirectory();
+
+    const juce::File& getDirectory() const noexcept { return directory; }
+
+    /** Maps the entry for key, or returns nullptr if there is none or it is damaged. */
+    std::unique_ptr<Entry> open(const Key& key) const;
+
+    /** Replaces the entry for key with the given sections, then trims the cache to its budget. */
+    bool store(const Key& key, const std::vector<Section>& sections) const;
+
+    /** Deletes the least recently used entries until the cache fits in maxBytes. */
+    void trim() const;
+
+private:
+    //==============================================================================
+    juce::File getEntryFile(const Key& key) const;
+
+    const juce::File directory;
+    const juce::int64 maxBytes;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisCache)
+};
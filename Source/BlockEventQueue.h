@@ -0,0 +1,108 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <array>
+
+/**
+ * BlockEventQueue - One block's timed engine events, in sample order, in fixed storage
+ * The processor fills it from the host's MidiBuffer at the start of every block and then
+ * splits the block at each event's timestamp, so note triggers and controller moves land on
+ * their exact sample. The MIDI bytes are read in place and the events go into a fixed array,
+ * so filling the queue never allocates; events beyond its capacity are dropped and counted.
+ */
+class BlockEventQueue
+{
+public:
+    //==============================================================================
+    static constexpr int capacity = 1024;
+
+    struct Event
+    {
+        enum class Type : juce::uint8
+        {
+            noteOn,
+            noteOff,
+            controller
+        };
+
+        int sampleOffset = 0;   // Within the block
+        Type type = Type::noteOn;
+        int number = 0;         // Note or controller number
+        float value = 0.0f;     // Velocity or controller value, 0 to 1; 0 for note-offs
+    };
+
+    //==============================================================================
+    BlockEventQueue() = default;
+
+    void clear() noexcept { numEvents = 0; }
+
+    /**
+     * Replaces the queue with the notes and controller changes of midi, on every channel,
+     * with their timestamps clamped to the block. midi must be in time order, as hosts send it.
+     */
+    void setFromMidi(const juce::MidiBuffer& midi, int numSamples) noexcept
+    {
+        clear();
+        appendFromMidi(midi, 0, numSamples, 0, true, true);
+    }
+
+    /**
+     * Appends the events of midi from sample start to start + numSamples, moved to begin at
+     * blockOffset. With first or last set, events before or after that range are clamped into it,
+     * so splitting one block over several calls keeps every event exactly once.
+     */
+    void appendFromMidi(const juce::MidiBuffer& midi, int start, int numSamples, int blockOffset,
+                        bool first, bool last) noexcept
+    {
+        for (const auto metadata : midi)
+        {
+            if (metadata.numBytes < 3)
+                continue;
+
+            if ((! first && metadata.samplePosition < start) || (! last && metadata.samplePosition >= start + numSamples))
+                continue;
+
+            const auto status = metadata.data[0] & 0xf0;
+            const auto offset = juce::jlimit(0, juce::jmax(0, numSamples - 1), metadata.samplePosition - start) + blockOffset;
+
+            // A note-on with zero velocity is a note-off
+            if (status == 0x90 && metadata.data[2] > 0)
+                add({ offset, Event::Type::noteOn, metadata.data[1], metadata.data[2] / 127.0f });
+            else if (status == 0x80 || status == 0x90)
+                add({ offset, Event::Type::noteOff, metadata.data[1], 0.0f });
+            else if (status == 0xb0)
+                add({ offset, Event::Type::controller, metadata.data[1], metadata.data[2] / 127.0f });
+        }
+    }
+
+    /** Appends an event, which must not be earlier than the last one; returns false when full. */
+    bool add(const Event& event) noexcept
+    {
+        jassert(numEvents == 0 || events[static_cast<size_t>(numEvents - 1)].sampleOffset <= event.sampleOffset);
+
+        if (numEvents == capacity)
+        {
+            ++numDropped;
+            return false;
+        }
+
+        events[static_cast<size_t>(numEvents++)] = event;
+        return true;
+    }
+
+    //==============================================================================
+    int size() const noexcept { return numEvents; }
+    const Event& operator[](int index) const noexcept { return events[static_cast<size_t>(index)]; }
+
+    /** Events that did not fit, since construction. */
+    juce::uint32 getNumDropped() const noexcept { return numDropped; }
+
+private:
+    //==============================================================================
+    std::array<Event, capacity> events {};
+    int numEvents = 0;
+    juce::uint32 numDropped = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(BlockEventQueue)
+};
@@ -0,0 +1,236 @@
+#include "GrainCloudRenderer.h"
+
+#include <cstddef>
+
+using namespace juce::gl;
+
+namespace
+{
+    // Instances are positioned in component coordinates and flipped into clip space here
+    const char* const vertexShader = R"(
+        #version 150
+        in vec2 corner;
+        in vec4 bounds;
+        in vec4 colour;
+        in float disc;
+        uniform vec2 viewSize;
+        out vec4 fragmentColour;
+        out vec2 fragmentOffset;
+        out float fragmentDisc;
+
+        void main()
+        {
+            vec2 position = bounds.xy + corner * bounds.zw;
+            gl_Position = vec4(position.x / viewSize.x * 2.0 - 1.0, 1.0 - position.y / viewSize.y * 2.0, 0.0, 1.0);
+            fragmentColour = colour;
+            fragmentOffset = corner * 2.0 - 1.0;
+            fragmentDisc = disc;
+        })";
+
+    // Discs fade out over the outer quarter of their radius instead of needing multisampling
+    const char* const fragmentShader = R"(
+        #version 150
+        in vec4 fragmentColour;
+        in vec2 fragmentOffset;
+        in float fragmentDisc;
+        out vec4 outputColour;
+
+        void main()
+        {
+            float coverage = fragmentDisc > 0.5 ? clamp((1.0 - length(fragmentOffset)) * 4.0, 0.0, 1.0) : 1.0;
+            outputColour = vec4(fragmentColour.rgb, fragmentColour.a * coverage);
+        })";
+
+    enum AttributeLocation : juce::GLuint
+    {
+        cornerAttribute = 0,
+        boundsAttribute,
+        colourAttribute,
+        discAttribute
+    };
+
+    void setInstanceAttribute(AttributeLocation location, int numComponents, size_t offset)
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, numComponents, GL_FLOAT, GL_FALSE, sizeof(GrainCloudRenderer::Instance),
+                              reinterpret_cast<const void*>(offset));
+        glVertexAttribDivisor(location, 1);
+    }
+}
+
+//==============================================================================
+GrainCloudRenderer::Instance::Instance(juce::Rectangle<float> bounds, juce::Colour colour, bool isDisc) noexcept
+    : x(bounds.getX()), y(bounds.getY()), width(bounds.getWidth()), height(bounds.getHeight()),
+      red(colour.getFloatRed()), green(colour.getFloatGreen()), blue(colour.getFloatBlue()), alpha(colour.getFloatAlpha()),
+      disc(isDisc ? 1.0f : 0.0f)
+{
+}
+
+//==============================================================================
+GrainCloudRenderer::GrainCloudRenderer()
+{
+    context.setRenderer(this);
+    context.setOpenGLVersionRequired(juce::OpenGLContext::openGL3_2);
+    context.setContinuousRepainting(false);
+
+    // Everything the component shows is in the instances, so JUCE need not rasterise it as well
+    context.setComponentPaintingEnabled(false);
+}
+
+GrainCloudRenderer::~GrainCloudRenderer()
+{
+    detach();
+}
+
+//==============================================================================
+void GrainCloudRenderer::attachTo(juce::Component& component)
+{
+    failed.store(false, std::memory_order_release);
+    context.attachTo(component);
+}
+
+void GrainCloudRenderer::detach()
+{
+    // Blocks until the GL thread has closed the context and freed its objects
+    context.detach();
+}
+
+void GrainCloudRenderer::setInstances(std::vector<Instance>& instances, juce::Rectangle<int> viewBounds)
+{
+    {
+        const juce::ScopedLock lock(instanceLock);
+        std::swap(pendingInstances, instances);
+        pendingBounds = viewBounds;
+        instancesChanged = true;
+    }
+
+    context.triggerRepaint();
+}
+
+//==============================================================================
+void GrainCloudRenderer::newOpenGLContextCreated()
+{
+    // Instancing is core in OpenGL 3.3 and an extension on some 3.2 contexts
+    if (glDrawArraysInstanced == nullptr || glVertexAttribDivisor == nullptr || ! createShader())
+    {
+        failed.store(true, std::memory_order_release);
+        return;
+    }
+
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(1, &quadBuffer);
+    glGenBuffers(1, &instanceBuffer);
+
+    glBindVertexArray(vertexArray);
+
+    // The shared unit quad, as a triangle strip
+    const GLfloat corners[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+    glBindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(cornerAttribute);
+    glVertexAttribPointer(cornerAttribute, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    setInstanceAttribute(boundsAttribute, 4, offsetof(Instance, x));
+    setInstanceAttribute(colourAttribute, 4, offsetof(Instance, red));
+    setInstanceAttribute(discAttribute, 1, offsetof(Instance, disc));
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // A new context starts with an empty buffer, so the next frame uploads the current list again
+    instanceCapacity = 0;
+    numInstances = 0;
+    drawnInstancesUploaded = false;
+}
+
+bool GrainCloudRenderer::createShader()
+{
+    auto program = std::make_unique<juce::OpenGLShaderProgram>(context);
+
+    if (! program->addVertexShader(vertexShader) || ! program->addFragmentShader(fragmentShader))
+        return false;
+
+    // Fixed locations let the vertex array be set up once, before the program is bound
+    glBindAttribLocation(program->getProgramID(), cornerAttribute, "corner");
+    glBindAttribLocation(program->getProgramID(), boundsAttribute, "bounds");
+    glBindAttribLocation(program->getProgramID(), colourAttribute, "colour");
+    glBindAttribLocation(program->getProgramID(), discAttribute, "disc");
+
+    if (! program->link())
+        return false;
+
+    shader = std::move(program);
+    return true;
+}
+
+void GrainCloudRenderer::renderOpenGL()
+{
+    if (shader == nullptr)
+        return;
+
+    auto upload = ! drawnInstancesUploaded;
+
+    {
+        const juce::ScopedLock lock(instanceLock);
+
+        if (instancesChanged)
+        {
+            std::swap(drawnInstances, pendingInstances);
+            drawnBounds = pendingBounds;
+            instancesChanged = false;
+            upload = true;
+        }
+    }
+
+    // Only a changed list crosses the bus, and the buffer only grows
+    if (upload)
+    {
+        const auto bytes = static_cast<GLsizeiptr>(drawnInstances.size() * sizeof(Instance));
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+        if (drawnInstances.size() > instanceCapacity)
+        {
+            instanceCapacity = drawnInstances.capacity();
+            glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(instanceCapacity * sizeof(Instance)), nullptr, GL_DYNAMIC_DRAW);
+        }
+
+        if (bytes > 0)
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, drawnInstances.data());
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        numInstances = drawnInstances.size();
+        drawnInstancesUploaded = true;
+    }
+
+    const auto scale = static_cast<float>(context.getRenderingScale());
+    glViewport(0, 0, juce::roundToInt(scale * static_cast<float>(drawnBounds.getWidth())),
+               juce::roundToInt(scale * static_cast<float>(drawnBounds.getHeight())));
+    juce::OpenGLHelpers::clear(juce::Colours::black);
+
+    if (numInstances == 0 || drawnBounds.isEmpty())
+        return;
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    shader->use();
+    shader->setUniform("viewSize", static_cast<GLfloat>(drawnBounds.getWidth()), static_cast<GLfloat>(drawnBounds.getHeight()));
+
+    glBindVertexArray(vertexArray);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(numInstances));
+    glBindVertexArray(0);
+}
+
+void GrainCloudRenderer::openGLContextClosing()
+{
+    if (vertexArray != 0)
+    {
+        glDeleteBuffers(1, &instanceBuffer);
+        glDeleteBuffers(1, &quadBuffer);
+        glDeleteVertexArrays(1, &vertexArray);
+    }
+
+    vertexArray = quadBuffer = instanceBuffer = 0;
+    shader.reset();
+}
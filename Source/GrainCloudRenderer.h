@@ -0,0 +1,80 @@
+#pragma once
+
+#include <juce_opengl/juce_opengl.h>
+
+#include <atomic>
+#include <vector>
+
+/**
+ * GrainCloudRenderer - OpenGL renderer drawing a whole view as one batch of instanced quads
+ * The message thread hands over the complete list of instances for a frame, each a rectangle
+ * in component coordinates with a colour, either filled or drawn as a soft-edged disc. The
+ * GL thread uploads the list into one instance buffer only when it changed and draws every
+ * instance with a single glDrawArraysInstanced over a shared unit quad, so waveform columns,
+ * the read window and thousands of grains cost the CPU a memcpy and one draw call. Repaints
+ * are on demand, never continuous. If the context lacks OpenGL 3.2 or the shaders do not
+ * build, hasFailed() turns true and the owner goes back to painting with juce::Graphics.
+ */
+class GrainCloudRenderer : private juce::OpenGLRenderer
+{
+public:
+    //==============================================================================
+    struct Instance
+    {
+        float x = 0.0f, y = 0.0f, width = 0.0f, height = 0.0f;            // Component coordinates
+        float red = 0.0f, green = 0.0f, blue = 0.0f, alpha = 0.0f;        // Not premultiplied
+        float disc = 0.0f;                                                // 1 = disc inside the bounds
+
+        Instance() = default;
+        Instance(juce::Rectangle<float> bounds, juce::Colour colour, bool isDisc = false) noexcept;
+    };
+
+    GrainCloudRenderer();
+    ~GrainCloudRenderer() override;
+
+    //==============================================================================
+    /** Starts rendering over component, replacing its paint() output. Message thread only. */
+    void attachTo(juce::Component& component);
+    void detach();
+
+    bool isAttached() const noexcept { return context.isAttached(); }
+
+    /** True once the GL thread found it cannot draw; the owner should detach and paint itself. */
+    bool hasFailed() const noexcept { return failed.load(std::memory_order_acquire); }
+
+    /**
+     * Replaces what is drawn, for a view of the given size, and schedules a repaint.
+     * Swaps with the vector passed in, which gets the previous instances back for reuse.
+     */
+    void setInstances(std::vector<Instance>& instances, juce::Rectangle<int> viewBounds);
+
+private:
+    //==============================================================================
+    void newOpenGLContextCreated() override;
+    void renderOpenGL() override;
+    void openGLContextClosing() override;
+
+    bool createShader();
+
+    //==============================================================================
+    juce::OpenGLContext context;
+
+    // GL thread state
+    std::unique_ptr<juce::OpenGLShaderProgram> shader;
+    juce::GLuint vertexArray = 0, quadBuffer = 0, instanceBuffer = 0;
+    size_t instanceCapacity = 0;
+    size_t numInstances = 0;
+    std::vector<Instance> drawnInstances;
+    juce::Rectangle<int> drawnBounds;
+    bool drawnInstancesUploaded = false;
+
+    // Handed from the message thread to the GL thread
+    juce::CriticalSection instanceLock;
+    std::vector<Instance> pendingInstances;
+    juce::Rectangle<int> pendingBounds;
+    bool instancesChanged = false;
+
+    std::atomic<bool> failed { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GrainCloudRenderer)
+};
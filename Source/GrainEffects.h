@@ -0,0 +1,197 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <cmath>
+
+//==============================================================================
+/** The per-grain filter responses, in the order of the "filter" parameter choices. */
+enum class GrainFilterType : juce::uint8
+{
+    off,
+    lowPass,
+    bandPass,
+    highPass
+};
+
+/** One grain's effect state, kept in the GrainPool next to the grain's other attributes. */
+struct GrainEffectState
+{
+    GrainFilterType filterType = GrainFilterType::off;   // Chosen when the grain spawned
+    float s1 = 0.0f, s2 = 0.0f;                           // Filter integrators
+    float held = 0.0f;                                    // Sample the decimator is holding
+    float samplesUntilHold = 0.0f;                        // Until the decimator takes a new one
+};
+
+/**
+ * GrainEffects - One block's coefficients for the per-grain filter and bit crusher
+ * Every grain can pass through a state-variable filter, in the response it spawned with, and
+ * then a bit crusher with sample-and-hold decimation. The cutoff, resonance and crush settings
+ * are shared by all grains, so the filter coefficients are worked out once per block, when
+ * they change, and each grain only runs the recursion with its own integrators. The filter is
+ * the topology-preserving transform SVF of juce::dsp::StateVariableTPTFilter, with its state
+ * kept per grain in the pool instead of in one filter object per grain. A stage at identity
+ * (no filter or a fully open one, full bit depth and no decimation) is skipped altogether.
+ */
+class GrainEffects
+{
+public:
+    //==============================================================================
+    struct Settings
+    {
+        GrainFilterType filterType = GrainFilterType::off;   // Response of newly spawned grains
+        float cutoffHz = 1000.0f;
+        float resonance = defaultResonance;
+        float crushBits = maxCrushBits;       // maxCrushBits = no quantisation
+        float downsample = 1.0f;              // Samples each held value lasts; 1 = no decimation
+
+        bool operator==(const Settings& other) const noexcept
+        {
+            return filterType == other.filterType && cutoffHz == other.cutoffHz && resonance == other.resonance
+                && crushBits == other.crushBits && downsample == other.downsample;
+        }
+
+        bool operator!=(const Settings& other) const noexcept { return ! operator==(other); }
+    };
+
+    static constexpr float minCutoffHz = 20.0f;
+    static constexpr float maxCutoffHz = 20000.0f;
+    static constexpr float defaultResonance = 0.70710678f;   // Butterworth, no peak
+    static constexpr float maxCrushBits = 24.0f;
+    static constexpr float maxDownsample = 32.0f;
+
+    //==============================================================================
+    GrainEffects() = default;
+
+    void prepare(double sampleRate) noexcept
+    {
+        currentSampleRate = sampleRate;
+        settings.cutoffHz = -1.0f;   // Forces the next update() to recompute
+    }
+
+    /** Recomputes the shared coefficients if settings changed since the last call. */
+    void update(const Settings& newSettings) noexcept
+    {
+        if (newSettings == settings)
+            return;
+
+        settings = newSettings;
+
+        // The same coefficients as juce::dsp::StateVariableTPTFilter::update()
+        const auto nyquistLimit = static_cast<float>(currentSampleRate * 0.49);
+        const auto cutoff = juce::jlimit(minCutoffHz, juce::jmin(maxCutoffHz, nyquistLimit), settings.cutoffHz);
+        const auto resonance = juce::jmax(0.1f, settings.resonance);
+
+        g = static_cast<float>(std::tan(juce::MathConstants<double>::pi * cutoff / currentSampleRate));
+        R2 = 1.0f / resonance;
+        h = 1.0f / (1.0f + R2 * g + g * g);
+
+        // Without a resonant peak, a low-pass at the top or a high-pass at the bottom passes everything
+        const auto flat = resonance <= defaultResonance;
+        lowPassOpen = flat && settings.cutoffHz >= juce::jmin(maxCutoffHz, nyquistLimit);
+        highPassOpen = flat && settings.cutoffHz <= minCutoffHz;
+
+        const auto bits = juce::jlimit(1.0f, maxCrushBits, settings.crushBits);
+        quantiseScale = std::pow(2.0f, bits - 1.0f);
+        downsample = juce::jlimit(1.0f, maxDownsample, settings.downsample);
+        crushActive = bits < maxCrushBits || downsample > 1.0f;
+    }
+
+    const Settings& getSettings() const noexcept { return settings; }
+
+    //==============================================================================
+    bool isFilterActive(GrainFilterType type) const noexcept
+    {
+        switch (type)
+        {
+            case GrainFilterType::lowPass:   return ! lowPassOpen;
+            case GrainFilterType::bandPass:  return true;
+            case GrainFilterType::highPass:  return ! highPassOpen;
+            case GrainFilterType::off:       break;
+        }
+
+        return false;
+    }
+
+    bool isCrushActive() const noexcept { return crushActive; }
+
+    /** True if process() would leave a grain with this state untouched. */
+    bool isBypassed(const GrainEffectState& state) const noexcept
+    {
+        return ! crushActive && ! isFilterActive(state.filterType);
+    }
+
+    /** Runs count samples of one grain through its active stages, in place. */
+    void process(GrainEffectState& state, float* samples, int count) const noexcept
+    {
+        // The response is resolved once per grain, so each loop is compiled for one output
+        if (isFilterActive(state.filterType))
+        {
+            switch (state.filterType)
+            {
+                case GrainFilterType::lowPass:   filter<GrainFilterType::lowPass>(state, samples, count); break;
+                case GrainFilterType::bandPass:  filter<GrainFilterType::bandPass>(state, samples, count); break;
+                case GrainFilterType::highPass:  filter<GrainFilterType::highPass>(state, samples, count); break;
+                case GrainFilterType::off:       break;
+            }
+        }
+
+        if (crushActive)
+            crush(state, samples, count);
+    }
+
+private:
+    //==============================================================================
+    template <GrainFilterType type>
+    void filter(GrainEffectState& state, float* samples, int count) const noexcept
+    {
+        auto s1 = state.s1, s2 = state.s2;
+
+        for (int i = 0; i < count; ++i)
+        {
+            const auto highPass = h * (samples[i] - s1 * (R2 + g) - s2);
+            const auto bandPass = highPass * g + s1;
+            s1 = highPass * g + bandPass;
+            const auto lowPass = bandPass * g + s2;
+            s2 = bandPass * g + lowPass;
+
+            samples[i] = type == GrainFilterType::lowPass ? lowPass
+                       : type == GrainFilterType::bandPass ? bandPass
+                       : highPass;
+        }
+
+        state.s1 = s1;
+        state.s2 = s2;
+    }
+
+    void crush(GrainEffectState& state, float* samples, int count) const noexcept
+    {
+        auto held = state.held;
+        auto samplesUntilHold = state.samplesUntilHold;
+
+        for (int i = 0; i < count; ++i)
+        {
+            if (samplesUntilHold <= 0.0f)
+            {
+                held = std::floor(samples[i] * quantiseScale + 0.5f) / quantiseScale;
+                samplesUntilHold += downsample;
+            }
+
+            samplesUntilHold -= 1.0f;
+            samples[i] = held;
+        }
+
+        state.held = held;
+        state.samplesUntilHold = samplesUntilHold;
+    }
+
+    //==============================================================================
+    double currentSampleRate = 44100.0;
+    Settings settings;
+
+    float g = 0.0f, R2 = 0.0f, h = 0.0f;
+    bool lowPassOpen = true, highPassOpen = true;
+
+    float quantiseScale = 1.0f, downsample = 1.0f;
+    bool crushActive = false;
+};
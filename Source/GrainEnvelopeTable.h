@@ -0,0 +1,131 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+//==============================================================================
+/** The grain window shapes, in the order of the "envelope" parameter choices. */
+enum class GrainEnvelopeShape : juce::uint8
+{
+    hann,
+    tukey,
+    gaussian,
+    trapezoid
+};
+
+namespace GrainEnvelopes
+{
+    /** Raised cosine over the whole grain. */
+    struct Hann
+    {
+        static double evaluate(double phase) noexcept
+        {
+            return 0.5 - 0.5 * std::cos(juce::MathConstants<double>::twoPi * phase);
+        }
+    };
+
+    /** Cosine fades over the outer quarters with a flat top, keeping dense clouds louder. */
+    struct Tukey
+    {
+        static constexpr double taperFraction = 0.5;
+
+        static double evaluate(double phase) noexcept
+        {
+            const auto edge = std::min(phase, 1.0 - phase);
+
+            if (edge >= taperFraction * 0.5)
+                return 1.0;
+
+            return 0.5 - 0.5 * std::cos(juce::MathConstants<double>::twoPi * edge / taperFraction);
+        }
+    };
+
+    /** Bell curve, offset and rescaled so that it reaches exactly zero at both ends. */
+    struct Gaussian
+    {
+        static constexpr double width = 0.15;
+
+        static double evaluate(double phase) noexcept
+        {
+            const auto bell = [](double x) { return std::exp(-0.5 * juce::square((x - 0.5) / width)); };
+            const auto edgeValue = bell(0.0);
+            return std::max(0.0, (bell(phase) - edgeValue) / (1.0 - edgeValue));
+        }
+    };
+
+    /** Linear fades over the outer fifths with a flat top. */
+    struct Trapezoid
+    {
+        static constexpr double rampFraction = 0.2;
+
+        static double evaluate(double phase) noexcept
+        {
+            return juce::jlimit(0.0, 1.0, std::min(phase, 1.0 - phase) / rampFraction);
+        }
+    };
+}
+
+//==============================================================================
+/**
+ * GrainEnvelopeTable - A grain window shape sampled once into a lookup table
+ * The shape is a template parameter (one of the GrainEnvelopes structs), so code rendering a
+ * given table is compiled per shape and never branches on it per sample. The table is filled
+ * on construction, off the audio thread; lookups interpolate linearly between entries and clamp
+ * phases outside [0, 1], which the padded lanes of the last vector of a grain can reach.
+ */
+template <typename Shape>
+class GrainEnvelopeTable
+{
+public:
+    static constexpr int tableSize = 2048;
+
+    GrainEnvelopeTable() noexcept
+    {
+        // One guard entry past the end so interpolation at phase 1 stays inside the table
+        for (int i = 0; i <= tableSize; ++i)
+            table[static_cast<size_t>(i)] = static_cast<float>(Shape::evaluate(static_cast<double>(i) / tableSize));
+    }
+
+    float lookup(float phase) const noexcept
+    {
+        const auto position = juce::jlimit(0.0f, 1.0f, phase) * static_cast<float>(tableSize);
+        const auto index = std::min(static_cast<int>(position), tableSize - 1);
+        const auto fraction = position - static_cast<float>(index);
+
+        const auto a = table[static_cast<size_t>(index)];
+        const auto b = table[static_cast<size_t>(index + 1)];
+        return a + fraction * (b - a);
+    }
+
+private:
+    std::array<float, tableSize + 1> table;
+
+    JUCE_DECLARE_NON_COPYABLE(GrainEnvelopeTable)
+};
+
+//==============================================================================
+/** One table for every grain envelope shape; engines share one set through juce::SharedResourcePointer. */
+struct GrainEnvelopeTables
+{
+    GrainEnvelopeTable<GrainEnvelopes::Hann> hann;
+    GrainEnvelopeTable<GrainEnvelopes::Tukey> tukey;
+    GrainEnvelopeTable<GrainEnvelopes::Gaussian> gaussian;
+    GrainEnvelopeTable<GrainEnvelopes::Trapezoid> trapezoid;
+
+    /** Calls function with the table for shape; the only place a shape is switched on. */
+    template <typename Function>
+    void visit(GrainEnvelopeShape shape, Function&& function) const
+    {
+        switch (shape)
+        {
+            case GrainEnvelopeShape::tukey:     function(tukey); break;
+            case GrainEnvelopeShape::gaussian:  function(gaussian); break;
+            case GrainEnvelopeShape::trapezoid: function(trapezoid); break;
+            case GrainEnvelopeShape::hann:
+            default:                            function(hann); break;
+        }
+    }
+};
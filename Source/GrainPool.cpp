@@ -0,0 +1,69 @@
+#include "GrainPool.h"
+
+//==============================================================================
+template <typename Function>
+void GrainPool::forEachArray(Function&& function)
+{
+    function(readPositions);
+    function(playbackRates);
+    function(envelopePhases);
+    function(envelopeIncrements);
+    function(gains);
+    function(directions);
+    function(channelGains);
+    function(startOffsets);
+    function(envelopeShapes);
+    function(sources);
+    function(effectStates);
+}
+
+int GrainPool::getPaddedCapacity(int newCapacity, int vectorSize) noexcept
+{
+    // Round up so vector loops over the active range never run past the allocation
+    return ((newCapacity + vectorSize - 1) / vectorSize) * vectorSize;
+}
+
+void GrainPool::prepare(int newCapacity, int vectorSize)
+{
+    jassert(newCapacity > 0 && vectorSize > 0);
+
+    const auto padded = getPaddedCapacity(newCapacity, vectorSize);
+    forEachArray([padded](auto& array) { array.ensureSize(padded); });
+
+    capacity = newCapacity;
+    numActive = 0;
+}
+
+void GrainPool::release() noexcept
+{
+    forEachArray([](auto& array) { array.free(); });
+
+    capacity = 0;
+    numActive = 0;
+}
+
+bool GrainPool::needsToGrow(int newCapacity, int vectorSize) const noexcept
+{
+    // Every array is sized alike, so the first one stands for all of them
+    return readPositions.size() < getPaddedCapacity(newCapacity, vectorSize);
+}
+
+int GrainPool::spawn() noexcept
+{
+    if (numActive >= capacity)
+        return -1;
+
+    const auto index = numActive++;
+    forEachArray([index](auto& array) { array[index] = {}; });
+    return index;
+}
+
+void GrainPool::retire(int index) noexcept
+{
+    jassert(index >= 0 && index < numActive);
+
+    const auto last = --numActive;
+
+    if (index != last)
+        forEachArray([index, last](auto& array) { array[index] = array[last]; });
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "AlignedBuffer.h"
+#include "GrainEffects.h"
+#include "GrainEnvelopeTable.h"
+#include "GrainSource.h"
+#include "GrainSpatialiser.h"
+
+#include <juce_core/juce_core.h>
+
+/**
+ * GrainPool - Fixed-capacity structure-of-arrays storage for all grains of one engine instance
+ * Each grain attribute lives in its own SIMD-aligned array, indexed by grain slot, so the
+ * renderer can stream through one attribute of many grains at a time. Storage is allocated
+ * once in prepare(); spawning and retiring only move values within the preallocated arrays,
+ * so both are safe to call on the audio thread. Active grains are densely packed in
+ * [0, getNumActive()), and every array is padded to a whole number of SIMD vectors.
+ */
+class GrainPool
+{
+public:
+    GrainPool() = default;
+
+    //==============================================================================
+    /**
+     * Makes room for capacity slots and clears all grains, reallocating only if the arrays
+     * are too small. Must not be called from the audio thread.
+     */
+    void prepare(int capacity, int vectorSize);
+
+    /** Returns true if prepare() with these arguments would reallocate the arrays. */
+    bool needsToGrow(int capacity, int vectorSize) const noexcept;
+    void reset() noexcept { numActive = 0; }
+
+    /** Frees the arrays; the pool holds no grains until the next prepare(). Not for the audio thread. */
+    void release() noexcept;
+
+    //==============================================================================
+    /** Claims a free slot and returns its index, or -1 when the pool is exhausted. */
+    int spawn() noexcept;
+
+    /** Releases the grain at the given index, moving the last active grain into its slot. */
+    void retire(int index) noexcept;
+
+    int getNumActive() const noexcept { return numActive; }
+    int getCapacity() const noexcept { return capacity; }
+
+    //==============================================================================
+    // Parallel grain attributes, valid for indices [0, getNumActive())
+    double* getReadPositions() noexcept { return readPositions.get(); }             // Absolute source position in samples
+    float* getPlaybackRates() noexcept { return playbackRates.get(); }              // Source samples advanced per output sample
+    float* getEnvelopePhases() noexcept { return envelopePhases.get(); }            // 0 at grain start, 1 at grain end
+    float* getEnvelopeIncrements() noexcept { return envelopeIncrements.get(); }    // Envelope phase advanced per output sample
+    float* getGains() noexcept { return gains.get(); }                              // Overall level, e.g. from a note's velocity
+    float* getDirections() noexcept { return directions.get(); }                    // Position along the output's panning arc
+    GrainSpatialiser::Gains* getChannelGains() noexcept { return channelGains.get(); }  // Per output channel, from level and direction
+    float* getStartOffsets() noexcept { return startOffsets.get(); }                // Samples to wait inside the current block
+    GrainEnvelopeShape* getEnvelopeShapes() noexcept { return envelopeShapes.get(); }  // Window chosen when the grain spawned
+    const GrainSource** getSources() noexcept { return sources.get(); }             // Material the grain reads, fixed at spawn
+    GrainEffectState* getEffectStates() noexcept { return effectStates.get(); }     // Filter response and effect memory
+
+private:
+    //==============================================================================
+    template <typename Function>
+    void forEachArray(Function&& function);
+
+    static int getPaddedCapacity(int capacity, int vectorSize) noexcept;
+
+    //==============================================================================
+    AlignedBuffer<double> readPositions;
+    AlignedBuffer<float> playbackRates, envelopePhases, envelopeIncrements;
+    AlignedBuffer<float> gains, directions, startOffsets;
+    AlignedBuffer<GrainSpatialiser::Gains> channelGains;
+    AlignedBuffer<GrainEnvelopeShape> envelopeShapes;
+    AlignedBuffer<const GrainSource*> sources;
+    AlignedBuffer<GrainEffectState> effectStates;
+
+    int capacity = 0;
+    int numActive = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GrainPool)
+};
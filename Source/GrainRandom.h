@@ -0,0 +1,140 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+
+/**
+ * GrainRandom - Seeded xoshiro128+ generator handing out random numbers a block at a time
+ * numLanes independent xoshiro128+ streams, all derived from one 64-bit seed through
+ * splitmix64, are stepped together in a plain loop over the lanes, which compilers turn into
+ * SSE or NEON integer operations. A refill produces bufferSize values in one pass, and the
+ * inline next*() calls just read from that buffer, so a grain's spray, pan and snap draws
+ * cost a load each instead of a call into juce::Random. fillFloats() writes whole blocks.
+ *
+ * The values depend only on the seed and on how many were drawn before, never on the
+ * machine or the build, so two engines seeded alike and driven alike make the same grains.
+ * Nothing here allocates or locks.
+ */
+class GrainRandom
+{
+public:
+    //==============================================================================
+    static constexpr int numLanes = 8;
+    static constexpr int bufferSize = 32 * numLanes;
+
+    //==============================================================================
+    explicit GrainRandom(juce::uint64 seed = 0) noexcept { setSeed(seed); }
+
+    /** Restarts the sequence the seed selects. */
+    void setSeed(juce::uint64 seed) noexcept
+    {
+        // splitmix64 spreads even neighbouring seeds over unrelated, never all-zero, lane states
+        auto mix = seed;
+
+        const auto next = [&mix]
+        {
+            auto z = (mix += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        };
+
+        for (size_t lane = 0; lane < numLanes; ++lane)
+        {
+            const auto low = next(), high = next();
+            state[0][lane] = static_cast<juce::uint32>(low);
+            state[1][lane] = static_cast<juce::uint32>(low >> 32);
+            state[2][lane] = static_cast<juce::uint32>(high);
+            state[3][lane] = static_cast<juce::uint32>(high >> 32) | 1u;
+        }
+
+        position = bufferSize;
+    }
+
+    //==============================================================================
+    /** The next 32 random bits. */
+    juce::uint32 nextBits() noexcept
+    {
+        if (position == bufferSize)
+            refill();
+
+        return buffer[static_cast<size_t>(position++)];
+    }
+
+    /** Uniform in [0, 1), from the top 24 bits, which are the strong ones in xoshiro128+. */
+    float nextFloat() noexcept { return toFloat(nextBits()); }
+
+    /** Uniform in [0, 1) with 53 bits, taken from two draws. */
+    double nextDouble() noexcept
+    {
+        const auto high = static_cast<juce::uint64>(nextBits() >> 5);
+        const auto low = static_cast<juce::uint64>(nextBits() >> 6);
+        return static_cast<double>((high << 26) | low) * 0x1.0p-53;
+    }
+
+    /** Uniform in [0, maxValue), for maxValue > 0. */
+    int nextInt(int maxValue) noexcept
+    {
+        jassert(maxValue > 0);
+        return static_cast<int>((static_cast<juce::uint64>(nextBits()) * static_cast<juce::uint64>(maxValue)) >> 32);
+    }
+
+    /** Writes count values uniform in [0, 1), the same ones count nextFloat() calls would return. */
+    void fillFloats(float* dest, int count) noexcept
+    {
+        while (count > 0)
+        {
+            if (position == bufferSize)
+                refill();
+
+            const auto chunk = juce::jmin(count, bufferSize - position);
+
+            for (int i = 0; i < chunk; ++i)
+                dest[i] = toFloat(buffer[static_cast<size_t>(position + i)]);
+
+            position += chunk;
+            dest += chunk;
+            count -= chunk;
+        }
+    }
+
+private:
+    //==============================================================================
+    static float toFloat(juce::uint32 bits) noexcept
+    {
+        return static_cast<float>(bits >> 8) * 0x1.0p-24f;
+    }
+
+    /** Steps every lane bufferSize / numLanes times; the inner loop over the lanes is vectorised. */
+    void refill() noexcept
+    {
+        auto s0 = state[0], s1 = state[1], s2 = state[2], s3 = state[3];
+
+        for (int i = 0; i < bufferSize; i += numLanes)
+        {
+            for (size_t lane = 0; lane < numLanes; ++lane)
+            {
+                buffer[static_cast<size_t>(i) + lane] = s0[lane] + s3[lane];
+
+                const auto t = s1[lane] << 9;
+                s2[lane] ^= s0[lane];
+                s3[lane] ^= s1[lane];
+                s1[lane] ^= s2[lane];
+                s0[lane] ^= s3[lane];
+                s2[lane] ^= t;
+                s3[lane] = (s3[lane] << 11) | (s3[lane] >> 21);
+            }
+        }
+
+        state = { s0, s1, s2, s3 };
+        position = 0;
+    }
+
+    //==============================================================================
+    using Lanes = std::array<juce::uint32, numLanes>;
+
+    alignas(32) std::array<Lanes, 4> state {};
+    alignas(32) std::array<juce::uint32, bufferSize> buffer {};
+    int position = bufferSize;
+};
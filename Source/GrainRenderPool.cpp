@@ -0,0 +1,264 @@
+#include "GrainRenderPool.h"
+
+#include <thread>
+
+//==============================================================================
+namespace
+{
+    constexpr int maxChunks = 0xffff;
+
+    // Runs to stay single-threaded for after a worker missed the deadline
+    constexpr int timeoutBackoffRuns = 256;
+
+    constexpr juce::uint64 makeCursor(juce::uint32 generation, int next, int end) noexcept
+    {
+        return (static_cast<juce::uint64>(generation) << 32)
+             | (static_cast<juce::uint64>(next) << 16)
+             | static_cast<juce::uint64>(end);
+    }
+}
+
+//==============================================================================
+/**
+ * Worker - One real-time priority thread of the render pool
+ * Between runs the worker keeps polling, yielding its core, for a few run intervals so it is
+ * awake for the next block. When runs stop arriving it sleeps between polls, and polls less
+ * often once the pool has been idle for a while.
+ */
+class GrainRenderPool::Worker : public juce::Thread
+{
+public:
+    static constexpr int hotRunIntervals = 4;
+    static constexpr int idleWaitMs = 1;
+    static constexpr int dormantWaitMs = 10;
+    static constexpr double dormantAfterSeconds = 1.0;
+
+    Worker(GrainRenderPool& ownerToUse, int participantToUse)
+        : juce::Thread("Grain render worker " + juce::String(participantToUse)),
+          owner(ownerToUse), participant(participantToUse)
+    {
+    }
+
+    ~Worker() override
+    {
+        stopThread(1000);
+    }
+
+    void run() override
+    {
+        auto seenGeneration = owner.generation.load(std::memory_order_acquire);
+        auto lastRunTicks = juce::Time::getHighResolutionTicks();
+
+        while (! threadShouldExit())
+        {
+            const auto latest = owner.generation.load(std::memory_order_acquire);
+
+            if (latest != seenGeneration)
+            {
+                seenGeneration = latest;
+                owner.participate(participant, latest);
+                lastRunTicks = juce::Time::getHighResolutionTicks();
+                continue;
+            }
+
+            const auto idleTicks = juce::Time::getHighResolutionTicks() - lastRunTicks;
+
+            if (idleTicks < hotRunIntervals * owner.runIntervalTicks.load(std::memory_order_relaxed))
+                std::this_thread::yield();
+            else if (juce::Time::highResolutionTicksToSeconds(idleTicks) < dormantAfterSeconds)
+                wait(idleWaitMs);
+            else
+                wait(dormantWaitMs);
+        }
+    }
+
+private:
+    GrainRenderPool& owner;
+    const int participant;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Worker)
+};
+
+//==============================================================================
+GrainRenderPool::GrainRenderPool() = default;
+
+GrainRenderPool::~GrainRenderPool()
+{
+    stop();
+}
+
+int GrainRenderPool::getDefaultNumWorkers()
+{
+    return juce::jlimit(0, 3, juce::SystemStats::getNumCpus() - 1);
+}
+
+int GrainRenderPool::getBatchNumWorkers()
+{
+    return juce::jlimit(0, maxWorkers, juce::SystemStats::getNumCpus() - 1);
+}
+
+void GrainRenderPool::start(int newNumWorkers)
+{
+    stop();
+
+    numWorkers = juce::jlimit(0, maxWorkers, newNumWorkers);
+
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        workers[static_cast<size_t>(i)] = std::make_unique<Worker>(*this, i + 1);
+        workers[static_cast<size_t>(i)]->startThread(juce::Thread::realtimeAudioPriority);
+    }
+}
+
+void GrainRenderPool::stop()
+{
+    for (auto& worker : workers)
+        worker = nullptr;
+
+    numWorkers = 0;
+}
+
+//==============================================================================
+juce::uint32 GrainRenderPool::run(Job& job, int numChunks, double timeoutMs) noexcept
+{
+    jassert(numChunks <= maxChunks);
+    numChunks = juce::jlimit(0, maxChunks, numChunks);
+
+    const auto now = juce::Time::getHighResolutionTicks();
+
+    if (lastRunTicks != 0)
+        runIntervalTicks.store(now - lastRunTicks, std::memory_order_relaxed);
+
+    lastRunTicks = now;
+
+    if (numWorkers == 0 || numChunks < 2 || singleThreadedRuns > 0)
+    {
+        singleThreadedRuns = std::max(0, singleThreadedRuns - 1);
+        runOnCaller(job, numChunks);
+        return 1;
+    }
+
+    // Deal the chunks out as one contiguous range per participant, then publish the run
+    const auto numParticipants = numWorkers + 1;
+    auto runGeneration = generation.load(std::memory_order_relaxed) + 1;
+
+    // Generation 0 marks a closed run, so it is skipped when the counter wraps
+    if (runGeneration == 0)
+        ++runGeneration;
+
+    for (int p = 0; p < maxParticipants; ++p)
+    {
+        const auto begin = p < numParticipants ? p * numChunks / numParticipants : numChunks;
+        const auto end = p < numParticipants ? (p + 1) * numChunks / numParticipants : numChunks;
+        cursors[static_cast<size_t>(p)].store(makeCursor(runGeneration, begin, end), std::memory_order_relaxed);
+    }
+
+    currentJob.store(&job, std::memory_order_relaxed);
+    openGeneration.store(runGeneration);
+    generation.store(runGeneration, std::memory_order_release);
+
+    participate(0, runGeneration);
+
+    // Every chunk has been claimed by now; wait, within the deadline, for workers still rendering
+    const auto hasDeadline = timeoutMs >= 0.0;
+    const auto deadline = juce::Time::getHighResolutionTicks()
+                        + juce::Time::secondsToHighResolutionTicks(hasDeadline ? timeoutMs * 0.001 : 0.0);
+    juce::uint32 completed = 1;
+    auto timedOut = false;
+
+    // Workers that have not joined by now can only find an empty run, so they are not waited for
+    for (int p = 1; p < numParticipants; ++p)
+    {
+        if (joinedGeneration[static_cast<size_t>(p)].load() != runGeneration)
+            continue;
+
+        while (finishedGeneration[static_cast<size_t>(p)].load(std::memory_order_acquire) != runGeneration
+               && ! timedOut)
+        {
+            timedOut = hasDeadline && juce::Time::getHighResolutionTicks() > deadline;
+            std::this_thread::yield();
+        }
+    }
+
+    // Closing the run invalidates chunk copies that stragglers are still making
+    openGeneration.store(0);
+
+    for (int p = 1; p < numParticipants; ++p)
+        if (finishedGeneration[static_cast<size_t>(p)].load(std::memory_order_acquire) == runGeneration)
+            completed |= 1u << p;
+
+    // A straggler means the cores are oversubscribed, and waiting on workers only adds risk
+    if (timedOut)
+    {
+        numTimeouts.fetch_add(1, std::memory_order_relaxed);
+        singleThreadedRuns = timeoutBackoffRuns;
+    }
+
+    return completed;
+}
+
+bool GrainRenderPool::claimChunk(int participant, juce::uint32 runGeneration, int& chunk) noexcept
+{
+    // Own range first, then steal from the others in turn
+    for (int offset = 0; offset < maxParticipants; ++offset)
+    {
+        auto& cursor = cursors[static_cast<size_t>((participant + offset) % maxParticipants)];
+        auto value = cursor.load(std::memory_order_acquire);
+
+        for (;;)
+        {
+            const auto next = static_cast<int>((value >> 16) & 0xffff);
+            const auto end = static_cast<int>(value & 0xffff);
+
+            if (static_cast<juce::uint32>(value >> 32) != runGeneration || next >= end)
+                break;
+
+            if (cursor.compare_exchange_weak(value, makeCursor(runGeneration, next + 1, end), std::memory_order_acq_rel))
+            {
+                chunk = next;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void GrainRenderPool::participate(int participant, juce::uint32 runGeneration) noexcept
+{
+    auto* job = currentJob.load(std::memory_order_relaxed);
+
+    if (job == nullptr)
+        return;
+
+    joinedGeneration[static_cast<size_t>(participant)].store(runGeneration);
+    job->beginParticipant(participant);
+
+    int chunk = 0;
+
+    while (claimChunk(participant, runGeneration, chunk))
+    {
+        job->loadChunk(participant, chunk);
+
+        // Seqlock-style check: the copy is only good if the caller had not moved on while it was made
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (participant != 0 && openGeneration.load() != runGeneration)
+            break;
+
+        job->renderChunk(participant);
+    }
+
+    finishedGeneration[static_cast<size_t>(participant)].store(runGeneration, std::memory_order_release);
+}
+
+void GrainRenderPool::runOnCaller(Job& job, int numChunks) noexcept
+{
+    job.beginParticipant(0);
+
+    for (int chunk = 0; chunk < numChunks; ++chunk)
+    {
+        job.loadChunk(0, chunk);
+        job.renderChunk(0);
+    }
+}
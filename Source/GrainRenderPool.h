@@ -0,0 +1,102 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+/**
+ * GrainRenderPool - Real-time worker threads that help the audio thread render dense grain clouds
+ * A run splits a job into chunks and deals them out as contiguous ranges, one per participant:
+ * the calling audio thread and every worker. Participants claim chunks from their own range
+ * first and then steal from the others, all through compare-and-swap on generation-tagged
+ * cursors, so nothing ever locks. The caller always participates, which means chunks left
+ * unclaimed by workers that were not scheduled in time are simply rendered by the caller.
+ * When the host saturates the cores, workers are not scheduled and the caller ends up
+ * rendering everything itself. Waiting for chunks already claimed by workers is bounded; a
+ * worker that misses the deadline has its result dropped, and the pool then runs
+ * single-threaded for a while.
+ */
+class GrainRenderPool
+{
+public:
+    //==============================================================================
+    static constexpr int maxWorkers = 7;
+    static constexpr int maxParticipants = maxWorkers + 1;   // Participant 0 is the calling thread
+
+    /** The work a run distributes. Participants only ever touch their own storage. */
+    struct Job
+    {
+        virtual ~Job() = default;
+
+        /** Called once per run on each participant before it claims chunks, e.g. to clear its output. */
+        virtual void beginParticipant(int participant) noexcept = 0;
+
+        /**
+         * Copies what the chunk needs out of shared state into the participant's own storage.
+         * A worker can be preempted past the caller's deadline, after which the caller moves on
+         * and changes that state, so each copy is validated afterwards and discarded if stale.
+         */
+        virtual void loadChunk(int participant, int chunk) noexcept = 0;
+
+        /** Renders the chunk last loaded by this participant, from its private copy. */
+        virtual void renderChunk(int participant) noexcept = 0;
+    };
+
+    //==============================================================================
+    GrainRenderPool();
+    ~GrainRenderPool();
+
+    /** Starts numWorkers real-time priority threads, stopping any previous ones. Not for the audio thread. */
+    void start(int numWorkers);
+    void stop();
+
+    int getNumWorkers() const noexcept { return numWorkers; }
+
+    /** A small pool: one worker per spare core, keeping cores free for the host and other plugins. */
+    static int getDefaultNumWorkers();
+
+    /** One worker per spare core, up to maxWorkers, for offline renders that have no deadline to share. */
+    static int getBatchNumWorkers();
+
+    //==============================================================================
+    /**
+     * Renders all numChunks chunks of job on the calling thread and whichever workers join,
+     * waiting at most timeoutMs for chunks that workers have claimed, or for as long as they
+     * take if timeoutMs is negative. Returns one bit per participant whose output is complete
+     * and must be summed; bit 0, the caller, is always set.
+     */
+    juce::uint32 run(Job& job, int numChunks, double timeoutMs) noexcept;
+
+    /** Number of runs so far in which a worker missed the deadline. */
+    juce::uint32 getNumTimeouts() const noexcept { return numTimeouts.load(std::memory_order_relaxed); }
+
+private:
+    //==============================================================================
+    class Worker;
+
+    bool claimChunk(int participant, juce::uint32 generation, int& chunk) noexcept;
+    void participate(int participant, juce::uint32 generation) noexcept;
+    void runOnCaller(Job& job, int numChunks) noexcept;
+
+    //==============================================================================
+    // Cursor layout: generation in the high 32 bits, next chunk in the middle 16, end in the low 16
+    std::array<std::atomic<juce::uint64>, maxParticipants> cursors {};
+    std::array<std::atomic<juce::uint32>, maxParticipants> joinedGeneration {};
+    std::array<std::atomic<juce::uint32>, maxParticipants> finishedGeneration {};
+
+    std::atomic<juce::uint32> generation { 0 };
+    std::atomic<juce::uint32> openGeneration { 0 };
+    std::atomic<Job*> currentJob { nullptr };
+    std::atomic<juce::int64> runIntervalTicks { 0 };
+
+    std::array<std::unique_ptr<Worker>, maxWorkers> workers;
+    int numWorkers = 0;
+
+    juce::int64 lastRunTicks = 0;
+    int singleThreadedRuns = 0;
+    std::atomic<juce::uint32> numTimeouts { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GrainRenderPool)
+};
@@ -0,0 +1,302 @@
+#pragma once
+
+#include "AlignedBuffer.h"
+
+#include <juce_core/juce_core.h>
+#include <juce_dsp/juce_dsp.h>
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+//==============================================================================
+/** Interpolation tiers for reading grains at fractional rates, in "quality" parameter order. */
+enum class ResamplerQuality : juce::uint8
+{
+    linear,
+    hermite,
+    sinc
+};
+
+//==============================================================================
+/**
+ * GrainSincTable - Polyphase windowed-sinc coefficients for the highest resampling tier
+ * Each band holds numPhases + 1 rows of numTaps Blackman-windowed sinc coefficients, one row
+ * per fractional offset, each normalised to unity gain at DC. Band n is cut off one octave
+ * below band n - 1, so grains read faster than the engine rate pick a band that removes what
+ * would otherwise fold back as aliasing. The table is built on construction, off the audio thread.
+ */
+class GrainSincTable
+{
+public:
+    static constexpr int numTaps = 16;
+    static constexpr int numPhases = 256;
+    static constexpr int numBands = 3;   // Unity, one and two octaves down, up to the 4x maximum rate
+    static constexpr double baseCutoff = 0.45;
+
+    GrainSincTable()
+    {
+        coefficients.allocate(numBands * (numPhases + 1) * numTaps);
+
+        for (int band = 0; band < numBands; ++band)
+        {
+            const auto cutoff = baseCutoff / static_cast<double>(1 << band);
+
+            for (int phase = 0; phase <= numPhases; ++phase)
+            {
+                auto* row = coefficients.get() + getRowOffset(band, phase);
+                const auto fraction = static_cast<double>(phase) / numPhases;
+                double sum = 0.0;
+
+                for (int tap = 0; tap < numTaps; ++tap)
+                {
+                    // Distance from the interpolated point to this tap, in source samples
+                    const auto x = static_cast<double>(tap - (numTaps / 2 - 1)) - fraction;
+                    const auto sinc = x == 0.0 ? 1.0 : std::sin(juce::MathConstants<double>::pi * 2.0 * cutoff * x)
+                                                           / (juce::MathConstants<double>::pi * 2.0 * cutoff * x);
+
+                    const auto u = (x + numTaps / 2) / numTaps;
+                    const auto window = 0.42 - 0.5 * std::cos(juce::MathConstants<double>::twoPi * u)
+                                              + 0.08 * std::cos(2.0 * juce::MathConstants<double>::twoPi * u);
+
+                    const auto value = sinc * juce::jmax(0.0, window);
+                    row[tap] = static_cast<float>(value);
+                    sum += value;
+                }
+
+                for (int tap = 0; tap < numTaps; ++tap)
+                    row[tap] = static_cast<float>(row[tap] / sum);
+            }
+        }
+    }
+
+    /** Returns the band whose cutoff suits the given playback rate. */
+    static int getBandForRate(float playbackRate) noexcept
+    {
+        if (playbackRate <= 1.0f)
+            return 0;
+
+        return juce::jmin(numBands - 1, static_cast<int>(std::ceil(std::log2(playbackRate))));
+    }
+
+    const float* getRow(int band, int phase) const noexcept { return coefficients.get() + getRowOffset(band, phase); }
+
+private:
+    static int getRowOffset(int band, int phase) noexcept { return (band * (numPhases + 1) + phase) * numTaps; }
+
+    AlignedBuffer<float> coefficients;
+
+    JUCE_DECLARE_NON_COPYABLE(GrainSincTable)
+};
+
+//==============================================================================
+/**
+ * GrainInterpolators - Fractional-position readers, one per ResamplerQuality tier
+ * Each interpolator fills one SIMD vector from the lane positions given. A tap window spans
+ * [index - leadingTaps, index - leadingTaps + numTaps) around the integer part of each position,
+ * so callers must provide leadingTaps samples before and numTaps - leadingTaps after the span.
+ */
+namespace GrainInterpolators
+{
+    using FloatVector = juce::dsp::SIMDRegister<float>;
+    constexpr int vectorSize = static_cast<int>(FloatVector::SIMDNumElements);
+
+    /** Two-point linear interpolation. */
+    struct Linear
+    {
+        static constexpr int numTaps = 2;
+        static constexpr int leadingTaps = 0;
+
+        FloatVector process(const float* source, const float* lanePositions) const noexcept
+        {
+            alignas(FloatVector::SIMDRegisterSize) float current[vectorSize];
+            alignas(FloatVector::SIMDRegisterSize) float next[vectorSize];
+            alignas(FloatVector::SIMDRegisterSize) float fractions[vectorSize];
+
+            for (int lane = 0; lane < vectorSize; ++lane)
+            {
+                const auto index = static_cast<int>(lanePositions[lane]);
+                fractions[lane] = lanePositions[lane] - static_cast<float>(index);
+                current[lane] = source[index];
+                next[lane] = source[index + 1];
+            }
+
+            const auto a = FloatVector::fromRawArray(current);
+            const auto b = FloatVector::fromRawArray(next);
+            return a + FloatVector::fromRawArray(fractions) * (b - a);
+        }
+    };
+
+    /** Four-point, third-order Hermite (Catmull-Rom) interpolation. */
+    struct Hermite
+    {
+        static constexpr int numTaps = 4;
+        static constexpr int leadingTaps = 1;
+
+        FloatVector process(const float* source, const float* lanePositions) const noexcept
+        {
+            alignas(FloatVector::SIMDRegisterSize) float taps[numTaps][vectorSize];
+            alignas(FloatVector::SIMDRegisterSize) float fractions[vectorSize];
+
+            for (int lane = 0; lane < vectorSize; ++lane)
+            {
+                const auto index = static_cast<int>(lanePositions[lane]);
+                fractions[lane] = lanePositions[lane] - static_cast<float>(index);
+
+                for (int tap = 0; tap < numTaps; ++tap)
+                    taps[tap][lane] = source[index - leadingTaps + tap];
+            }
+
+            const auto xm1 = FloatVector::fromRawArray(taps[0]);
+            const auto x0 = FloatVector::fromRawArray(taps[1]);
+            const auto x1 = FloatVector::fromRawArray(taps[2]);
+            const auto x2 = FloatVector::fromRawArray(taps[3]);
+            const auto t = FloatVector::fromRawArray(fractions);
+
+            const auto c1 = (x1 - xm1) * 0.5f;
+            const auto c2 = xm1 - x0 * 2.5f + x1 * 2.0f - x2 * 0.5f;
+            const auto c3 = (x2 - xm1) * 0.5f + (x0 - x1) * 1.5f;
+
+            return ((c3 * t + c2) * t + c1) * t + x0;
+        }
+    };
+
+    /** Polyphase windowed sinc, band-limited for the grain's playback rate. */
+    class WindowedSinc
+    {
+    public:
+        static constexpr int numTaps = GrainSincTable::numTaps;
+        static constexpr int leadingTaps = numTaps / 2 - 1;
+
+        WindowedSinc(const GrainSincTable& tableToUse, float playbackRate) noexcept
+            : table(tableToUse), band(GrainSincTable::getBandForRate(playbackRate))
+        {
+        }
+
+        FloatVector process(const float* source, const float* lanePositions) const noexcept
+        {
+            alignas(FloatVector::SIMDRegisterSize) float samples[vectorSize];
+
+            for (int lane = 0; lane < vectorSize; ++lane)
+            {
+                const auto index = static_cast<int>(lanePositions[lane]);
+                const auto phasePosition = (lanePositions[lane] - static_cast<float>(index)) * GrainSincTable::numPhases;
+                const auto phase = juce::jmin(static_cast<int>(phasePosition), GrainSincTable::numPhases - 1);
+                const auto phaseFraction = phasePosition - static_cast<float>(phase);
+
+                // Blend the two nearest phases so the fractional offset is not quantised
+                const auto* lower = table.getRow(band, phase);
+                const auto* upper = table.getRow(band, phase + 1);
+                const auto* taps = source + index - leadingTaps;
+                auto sum = 0.0f;
+
+                for (int tap = 0; tap < numTaps; ++tap)
+                    sum += taps[tap] * (lower[tap] + phaseFraction * (upper[tap] - lower[tap]));
+
+                samples[lane] = sum;
+            }
+
+            return FloatVector::fromRawArray(samples);
+        }
+
+    private:
+        const GrainSincTable& table;
+        int band;
+    };
+
+    /** The widest tap window of any tier, for sizing source scratch buffers. */
+    constexpr int maxTaps = WindowedSinc::numTaps;
+}
+
+//==============================================================================
+/**
+ * GrainResampler - The resampling tables shared by all grains, and the per-grain tier dispatch
+ * The sinc table is read-only, so every engine in the process shares one, held through a
+ * juce::SharedResourcePointer and freed with the last engine. It takes far longer to build
+ * than anything else prepare() does, so the first prepare() builds it on a background
+ * thread; until it is ready, sinc grains are read through the Hermite tier instead, which
+ * needs no table. The switch happens between blocks, the first time visit() sees the table.
+ */
+class GrainResampler
+{
+public:
+    GrainResampler() = default;
+
+    /** Starts building the sinc table in the background, unless that has already begun. Not for the audio thread. */
+    void prepare() { sincTable->startBuilding(); }
+
+    /**
+     * Waits up to timeoutMs (forever if negative) for the sinc table, starting the build first if
+     * prepare() has not. Returns true once the table is ready. Not for the audio thread.
+     */
+    bool waitForTables(int timeoutMs = -1)
+    {
+        prepare();
+        return sincTable->built.wait(timeoutMs);
+    }
+
+    /** Returns the sinc table, or nullptr while it is still being built. Wait-free. */
+    const GrainSincTable* getSincTable() const noexcept
+    {
+        return sincTable->ready.load(std::memory_order_acquire) ? sincTable->table.get() : nullptr;
+    }
+
+    /** Calls function with the interpolator for quality, set up for a grain at playbackRate. */
+    template <typename Function>
+    void visit(ResamplerQuality quality, float playbackRate, Function&& function) const
+    {
+        const auto* table = quality == ResamplerQuality::sinc ? getSincTable() : nullptr;
+
+        switch (quality)
+        {
+            case ResamplerQuality::linear:  function(GrainInterpolators::Linear {}); break;
+            case ResamplerQuality::sinc:
+                if (table != nullptr)
+                {
+                    function(GrainInterpolators::WindowedSinc { *table, playbackRate });
+                    break;
+                }
+
+                JUCE_FALLTHROUGH
+            case ResamplerQuality::hermite:
+            default:                        function(GrainInterpolators::Hermite {}); break;
+        }
+    }
+
+private:
+    //==============================================================================
+    /** The process-wide table and its one-off background build. */
+    struct SharedSincTable
+    {
+        ~SharedSincTable()
+        {
+            // The build thread writes into this object, so it must be done before it goes
+            if (started.load())
+                built.wait();
+        }
+
+        void startBuilding()
+        {
+            if (started.exchange(true))
+                return;
+
+            const auto build = [this]
+            {
+                table = std::make_unique<GrainSincTable>();
+                ready.store(true, std::memory_order_release);
+                built.signal();
+            };
+
+            if (! juce::Thread::launch(build))
+                build();
+        }
+
+        std::unique_ptr<GrainSincTable> table;
+        std::atomic<bool> started { false }, ready { false };
+        juce::WaitableEvent built { true };
+    };
+
+    juce::SharedResourcePointer<SharedSincTable> sincTable;
+
+    JUCE_DECLARE_NON_COPYABLE(GrainResampler)
+};
@@ -0,0 +1,499 @@
+#include "GrainScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+//==============================================================================
+namespace
+{
+    int roundUpToVector(int numSamples) noexcept
+    {
+        return ((numSamples + GrainScheduler::vectorSize - 1) / GrainScheduler::vectorSize) * GrainScheduler::vectorSize;
+    }
+
+    /** 0, 1, 2 ... across the lanes of a vector. */
+    GrainScheduler::FloatVector getLaneOffsets() noexcept
+    {
+        alignas(GrainScheduler::FloatVector::SIMDRegisterSize) float lanes[GrainScheduler::vectorSize];
+
+        for (int lane = 0; lane < GrainScheduler::vectorSize; ++lane)
+            lanes[lane] = static_cast<float>(lane);
+
+        return GrainScheduler::FloatVector::fromRawArray(lanes);
+    }
+}
+
+//==============================================================================
+float GrainScheduler::getMaxPlaybackRate() noexcept
+{
+    return std::pow(2.0f, maxPitchSemitones / 12.0f);
+}
+
+float GrainScheduler::getPlaybackRate(float pitchSemitones, float sourceRateRatio) noexcept
+{
+    const auto transposition = std::pow(2.0f, juce::jlimit(-maxPitchSemitones, maxPitchSemitones, pitchSemitones) / 12.0f);
+    return juce::jlimit(1.0f / getMaxPlaybackRate(), getMaxPlaybackRate(), transposition * sourceRateRatio);
+}
+
+GrainScheduler::~GrainScheduler()
+{
+    stopRenderWorkers();
+}
+
+void GrainScheduler::prepare(double sampleRate, int newMaxBlockSize, float maxDensity, int numRenderWorkers,
+                             const juce::AudioChannelSet& outputLayout)
+{
+    jassert(sampleRate > 0.0 && newMaxBlockSize > 0 && maxDensity > 0.0f);
+
+    currentSampleRate = sampleRate;
+    maxBlockSize = newMaxBlockSize;
+    resampler.prepare();
+    effects.prepare(sampleRate);
+    spatialiser.prepare(outputLayout);
+
+    // Every grain alive at once, plus the grains that can be spawned inside one block
+    // before the oldest ones retire
+    const auto grainsPerSecond = static_cast<double>(maxDensity);
+    const auto overlapping = std::ceil(grainsPerSecond * maxGrainSizeMs * 0.001);
+    const auto perBlock = std::ceil(grainsPerSecond * newMaxBlockSize / sampleRate);
+    const auto capacity = static_cast<int>(overlapping + perBlock) + 1;
+
+    // Per participant: one block of source material at the fastest rate, rounded up to whole
+    // vectors, plus the taps of the widest interpolator
+    const auto paddedBlockSize = roundUpToVector(newMaxBlockSize);
+    const auto mixSize = paddedBlockSize * spatialiser.getNumChannels();
+    const auto sourceScratchSize = static_cast<int>(std::ceil(getMaxPlaybackRate() * static_cast<float>(paddedBlockSize)))
+                                 + GrainInterpolators::maxTaps + 2;
+    const auto numWorkers = juce::jlimit(0, GrainRenderPool::maxWorkers, numRenderWorkers);
+
+    // Buffers are only reallocated when they have to grow, so a host re-preparing with the same
+    // or a smaller block size keeps them all, and keeps the render workers running too
+    auto mustGrow = pool.needsToGrow(capacity, vectorSize);
+
+    for (int i = 0; i <= numWorkers; ++i)
+    {
+        const auto& context = contexts[static_cast<size_t>(i)];
+
+        mustGrow = mustGrow || context.sourceScratch.size() < sourceScratchSize || context.grainScratch.size() < paddedBlockSize
+                || context.mix.size() < mixSize || context.effectResults.size() < capacity;
+    }
+
+    // Workers are (re)started before the buffers they read change, so none of them is running a chunk
+    if (mustGrow || numWorkers != renderPool.getNumWorkers())
+        renderPool.start(numWorkers);
+
+    pool.prepare(capacity, vectorSize);
+    mixStride = paddedBlockSize;
+
+    for (int i = 0; i < GrainRenderPool::maxParticipants; ++i)
+    {
+        auto& context = contexts[static_cast<size_t>(i)];
+
+        if (i > renderPool.getNumWorkers())
+        {
+            context.sourceScratch.free();
+            context.grainScratch.free();
+            context.mix.free();
+            context.effectResults.free();
+            continue;
+        }
+
+        // Any participant may end up rendering every grain
+        context.sourceScratch.ensureSize(sourceScratchSize);
+        context.grainScratch.ensureSize(paddedBlockSize);
+        context.mix.ensureSize(mixSize);
+        context.effectResults.ensureSize(capacity);
+        context.numEffectResults = 0;
+    }
+
+    reset();
+}
+
+void GrainScheduler::stopRenderWorkers()
+{
+    renderPool.stop();
+}
+
+void GrainScheduler::releaseResources()
+{
+    // Workers go first, since they read the buffers freed below
+    renderPool.stop();
+    pool.release();
+
+    for (auto& context : contexts)
+    {
+        context.sourceScratch.free();
+        context.grainScratch.free();
+        context.mix.free();
+        context.effectResults.free();
+        context.numEffectResults = 0;
+    }
+
+    maxBlockSize = 0;
+    mixStride = 0;
+    samplesUntilNextGrain = 0.0;
+}
+
+void GrainScheduler::reset() noexcept
+{
+    pool.reset();
+    samplesUntilNextGrain = 0.0;
+}
+
+//==============================================================================
+void GrainScheduler::process(const Settings& settings, const GrainSource& source,
+                             float* const* outputs, int numSamples) noexcept
+{
+    jassert(numSamples <= maxBlockSize);
+
+    if (numSamples <= 0 || pool.getCapacity() == 0)
+        return;
+
+    // Spawn the grains that are due inside this block at their exact sample offsets
+    const auto interval = currentSampleRate / std::max(0.001, static_cast<double>(settings.density));
+    const auto playbackRate = juce::jlimit(1.0f / getMaxPlaybackRate(), getMaxPlaybackRate(), settings.playbackRate);
+    const auto fadingRate = juce::jlimit(1.0f / getMaxPlaybackRate(), getMaxPlaybackRate(), settings.fadingPlaybackRate);
+
+    samplesUntilNextGrain = std::min(samplesUntilNextGrain, interval);
+
+    while (samplesUntilNextGrain < numSamples)
+    {
+        const auto startOffset = static_cast<int>(samplesUntilNextGrain);
+
+        // The onsets describe the main source only
+        if (settings.fadingSource != nullptr && random.nextFloat() >= settings.crossfade)
+            spawnGrain(settings, *settings.fadingSource, nullptr, fadingRate, startOffset);
+        else
+            spawnGrain(settings, source, settings.onsets, playbackRate, startOffset);
+
+        samplesUntilNextGrain += interval;
+    }
+
+    samplesUntilNextGrain -= numSamples;
+
+    // Let slow sources warm up the region the next unsprayed grains will start from
+    const auto readable = source.getReadableRange();
+    const auto grainSpan = static_cast<juce::int64>(std::ceil(getGrainLengthInSamples(settings) * playbackRate));
+    const auto nextStart = readable.getStart() + static_cast<juce::int64>(juce::jlimit(0.0, 1.0, static_cast<double>(settings.position))
+                                                                          * static_cast<double>(readable.getLength()));
+    source.prefetch(nextStart - grainSpan, grainSpan * 2);
+
+    // One set of effect coefficients serves every grain of the block
+    effects.update(settings.effects);
+
+    // Render every active grain into the aligned mix buffers, then move the whole pool forward
+    auto& mainContext = contexts[0];
+    const auto numChannels = spatialiser.getNumChannels();
+    juce::uint32 completedParticipants = 1;
+
+    if (settings.multiThreaded && renderPool.getNumWorkers() > 0 && pool.getNumActive() >= minGrainsForWorkers)
+    {
+        blockQuality = settings.resamplerQuality;
+        blockNumSamples = numSamples;
+
+        const auto numChunks = (pool.getNumActive() + grainsPerChunk - 1) / grainsPerChunk;
+        // An offline render has no deadline, and dropping a late worker's grains would only lose them
+        const auto timeoutMs = settings.batch ? -1.0 : renderTimeoutFraction * 1000.0 * numSamples / currentSampleRate;
+        completedParticipants = renderPool.run(*this, numChunks, timeoutMs);
+    }
+    else
+    {
+        for (int channel = 0; channel < numChannels; ++channel)
+            juce::FloatVectorOperations::clear(getMix(mainContext, channel), numSamples);
+
+        mainContext.numEffectResults = 0;
+
+        for (int i = 0; i < pool.getNumActive(); ++i)
+        {
+            auto grain = getGrainState(i);
+            renderGrain(grain, settings.resamplerQuality, effects, numSamples, mainContext);
+        }
+    }
+
+    // Effect states go back into the pool before retiring moves grains between slots. A worker
+    // that missed the deadline loses its grains' audio and their effect progress alike
+    for (int p = 0; p < GrainRenderPool::maxParticipants; ++p)
+    {
+        if ((completedParticipants & (1u << p)) == 0)
+            continue;
+
+        const auto& context = contexts[static_cast<size_t>(p)];
+
+        for (int i = 0; i < context.numEffectResults; ++i)
+            pool.getEffectStates()[context.effectResults[i].index] = context.effectResults[i].state;
+    }
+
+    advanceGrains(numSamples);
+
+    for (int p = 1; p < GrainRenderPool::maxParticipants; ++p)
+    {
+        if ((completedParticipants & (1u << p)) == 0)
+            continue;
+
+        auto& context = contexts[static_cast<size_t>(p)];
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            juce::FloatVectorOperations::add(getMix(mainContext, channel), getMix(context, channel), numSamples);
+    }
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        juce::FloatVectorOperations::add(outputs[channel], getMix(mainContext, channel), numSamples);
+}
+
+//==============================================================================
+double GrainScheduler::getGrainLengthInSamples(const Settings& settings) const noexcept
+{
+    const auto grainSizeMs = juce::jlimit(1.0f, maxGrainSizeMs, settings.grainSizeMs);
+    return std::max(1.0, grainSizeMs * 0.001 * currentSampleRate);
+}
+
+void GrainScheduler::trigger(const Settings& settings, const GrainSource& source, float playbackRate,
+                             float gain, int startOffset) noexcept
+{
+    if (pool.getCapacity() == 0)
+        return;
+
+    const auto rate = juce::jlimit(1.0f / getMaxPlaybackRate(), getMaxPlaybackRate(), playbackRate);
+    spawnGrain(settings, source, settings.onsets, rate, std::max(0, startOffset), gain);
+}
+
+void GrainScheduler::spawnGrain(const Settings& settings, const GrainSource& source, const OnsetIndex* onsets,
+                                float playbackRate, int startOffset, float gain) noexcept
+{
+    const auto index = pool.spawn();
+
+    if (index < 0)
+        return;
+
+    const auto lengthInSamples = getGrainLengthInSamples(settings);
+
+    // Place the grain so that its whole span stays inside the readable range where possible
+    const auto readable = source.getReadableRange();
+    const auto earliest = static_cast<double>(readable.getStart());
+    const auto latest = std::max(earliest, static_cast<double>(readable.getEnd()) - lengthInSamples * playbackRate - 2.0);
+    const auto span = latest - earliest;
+
+    const auto jitter = settings.spray * (random.nextFloat() * 2.0f - 1.0f);
+    const auto centre = earliest + juce::jlimit(0.0f, 1.0f, settings.position) * span;
+
+    // A random direction anywhere across the output layout
+    const auto direction = random.nextFloat();
+
+    auto readPosition = juce::jlimit(earliest, latest, centre + jitter * span);
+
+    // Plunderphonic cutting: some or all grains start on the source transient nearest to their position
+    if (onsets != nullptr && settings.onsetSnap > 0.0f && random.nextFloat() < settings.onsetSnap)
+    {
+        const auto onset = onsets->findNearest(static_cast<juce::int64>(readPosition));
+
+        if (onset >= 0)
+            readPosition = juce::jlimit(earliest, latest, static_cast<double>(onset));
+    }
+
+    source.prefetch(static_cast<juce::int64>(readPosition), static_cast<juce::int64>(std::ceil(lengthInSamples * playbackRate)) + 2);
+
+    pool.getReadPositions()[index] = readPosition;
+    pool.getPlaybackRates()[index] = playbackRate;
+    pool.getEnvelopePhases()[index] = 0.0f;
+    pool.getEnvelopeIncrements()[index] = static_cast<float>(1.0 / lengthInSamples);
+    pool.getGains()[index] = gain;
+    pool.getDirections()[index] = direction;
+    spatialiser.computeGains(direction, gain, pool.getChannelGains()[index].data());
+    pool.getStartOffsets()[index] = static_cast<float>(startOffset);
+    pool.getEnvelopeShapes()[index] = settings.envelopeShape;
+    pool.getSources()[index] = &source;
+    pool.getEffectStates()[index].filterType = settings.effects.filterType;
+}
+
+void GrainScheduler::fillVisualFrame(GrainVisualFeed::Frame& frame) noexcept
+{
+    const auto numActive = pool.getNumActive();
+    const auto stride = std::max(1, (numActive + GrainVisualFeed::maxGrainsPerFrame - 1) / GrainVisualFeed::maxGrainsPerFrame);
+
+    frame.numActive = numActive;
+
+    for (int index = 0; index < numActive; index += stride)
+    {
+        const auto readable = pool.getSources()[index]->getReadableRange();
+        const auto gain = pool.getGains()[index];
+
+        GrainVisualFeed::Grain grain;
+        grain.position = readable.isEmpty() ? 0.0f
+                       : static_cast<float>((pool.getReadPositions()[index] - static_cast<double>(readable.getStart()))
+                                            / static_cast<double>(readable.getLength()));
+
+        // From the left to the right end of the output's panning arc
+        grain.pan = pool.getDirections()[index] * 2.0f - 1.0f;
+
+        envelopeTables->visit(pool.getEnvelopeShapes()[index], [&](const auto& envelope)
+        {
+            grain.level = gain * envelope.lookup(pool.getEnvelopePhases()[index]);
+        });
+
+        frame.add(grain);
+    }
+}
+
+GrainScheduler::GrainState GrainScheduler::getGrainState(int index) noexcept
+{
+    GrainState grain;
+    grain.readPosition = pool.getReadPositions()[index];
+    grain.playbackRate = pool.getPlaybackRates()[index];
+    grain.envelopePhase = pool.getEnvelopePhases()[index];
+    grain.envelopeIncrement = pool.getEnvelopeIncrements()[index];
+    grain.channelGains = pool.getChannelGains()[index];
+    grain.startOffset = static_cast<int>(pool.getStartOffsets()[index]);
+    grain.envelopeShape = pool.getEnvelopeShapes()[index];
+    grain.source = pool.getSources()[index];
+    grain.effectState = pool.getEffectStates()[index];
+    grain.index = index;
+    return grain;
+}
+
+void GrainScheduler::renderGrain(GrainState& grain, ResamplerQuality quality, const GrainEffects& blockEffects,
+                                 int numSamples, RenderContext& context) const noexcept
+{
+    const auto readPosition = grain.readPosition;
+    const auto playbackRate = grain.playbackRate;
+    const auto envelopePhase = grain.envelopePhase;
+    const auto envelopeIncrement = grain.envelopeIncrement;
+    const auto start = grain.startOffset;
+
+    const auto remaining = static_cast<int>(std::ceil((1.0f - envelopePhase) / envelopeIncrement));
+    const auto count = std::min(numSamples - start, remaining);
+
+    if (count <= 0 || grain.source == nullptr)
+        return;
+
+    // The tier and the shape are resolved once per grain; the sample loop is compiled for each pair
+    resampler.visit(quality, playbackRate, [&](const auto& interpolator)
+    {
+        using Interpolator = std::decay_t<decltype(interpolator)>;
+
+        // Fetch the span of source material this grain covers in the current block, with the
+        // interpolator's taps on either side of it
+        const auto firstSample = static_cast<juce::int64>(std::floor(readPosition));
+        const auto lastPosition = readPosition + static_cast<double>(playbackRate) * (count - 1);
+        const auto numToRead = static_cast<int>(static_cast<juce::int64>(std::floor(lastPosition)) - firstSample)
+                                 + Interpolator::numTaps;
+
+        jassert(numToRead <= context.sourceScratch.size());
+        grain.source->readSamples(context.sourceScratch.get(), firstSample - Interpolator::leadingTaps, numToRead);
+
+        envelopeTables->visit(grain.envelopeShape, [&](const auto& envelope)
+        {
+            renderGrainSamples(interpolator, envelope, context.sourceScratch.get() + Interpolator::leadingTaps,
+                               static_cast<float>(readPosition - static_cast<double>(firstSample)),
+                               playbackRate, envelopePhase, envelopeIncrement, context.grainScratch.get(), count);
+        });
+    });
+
+    // Stages at identity cost nothing; the others run on the participant's copy of the state
+    if (! blockEffects.isBypassed(grain.effectState))
+    {
+        blockEffects.process(grain.effectState, context.grainScratch.get(), count);
+        context.effectResults[context.numEffectResults++] = { grain.index, grain.effectState };
+    }
+
+    // Only the channels the grain reaches are touched; a VBAP grain reaches two of them
+    for (int channel = 0; channel < spatialiser.getNumChannels(); ++channel)
+    {
+        const auto channelGain = grain.channelGains[static_cast<size_t>(channel)];
+
+        if (channelGain != 0.0f)
+            juce::FloatVectorOperations::addWithMultiply(getMix(context, channel) + start, context.grainScratch.get(), channelGain, count);
+    }
+}
+
+//==============================================================================
+void GrainScheduler::beginParticipant(int participant) noexcept
+{
+    // Cleared to the prepared size, since a straggling worker may not see this block's length
+    auto& context = contexts[static_cast<size_t>(participant)];
+    juce::FloatVectorOperations::clear(context.mix.get(), mixStride * spatialiser.getNumChannels());
+    context.numEffectResults = 0;
+}
+
+void GrainScheduler::loadChunk(int participant, int chunk) noexcept
+{
+    auto& context = contexts[static_cast<size_t>(participant)];
+    const auto first = chunk * grainsPerChunk;
+    const auto numGrains = juce::jlimit(0, grainsPerChunk, pool.getNumActive() - first);
+
+    for (int i = 0; i < numGrains; ++i)
+        context.grains[static_cast<size_t>(i)] = getGrainState(first + i);
+
+    // The effect coefficients too, since a worker past the deadline may still be rendering when the
+    // next block updates them
+    context.numGrains = numGrains;
+    context.quality = blockQuality;
+    context.effects = effects;
+    context.numSamples = juce::jlimit(0, maxBlockSize, blockNumSamples);
+}
+
+void GrainScheduler::renderChunk(int participant) noexcept
+{
+    auto& context = contexts[static_cast<size_t>(participant)];
+
+    for (int i = 0; i < context.numGrains; ++i)
+        renderGrain(context.grains[static_cast<size_t>(i)], context.quality, context.effects, context.numSamples, context);
+}
+
+template <typename Interpolator, typename EnvelopeTable>
+void GrainScheduler::renderGrainSamples(const Interpolator& interpolator, const EnvelopeTable& envelopeTable,
+                                        const float* source, float basePosition, float playbackRate,
+                                        float envelopePhase, float envelopeIncrement,
+                                        float* dest, int count) noexcept
+{
+    alignas(FloatVector::SIMDRegisterSize) float lanePositions[vectorSize];
+    alignas(FloatVector::SIMDRegisterSize) float envelope[vectorSize];
+
+    const auto laneOffsets = getLaneOffsets();
+    const auto positionStep = FloatVector::expand(playbackRate * static_cast<float>(vectorSize));
+    auto positions = FloatVector::expand(basePosition) + laneOffsets * FloatVector::expand(playbackRate);
+
+    // The last vector may run past count; the scratch buffers are padded to whole vectors for that
+    for (int i = 0; i < count; i += vectorSize)
+    {
+        positions.copyToRawArray(lanePositions);
+
+        // Window over the grain's lifetime, read from the precomputed table
+        for (int lane = 0; lane < vectorSize; ++lane)
+            envelope[lane] = envelopeTable.lookup(envelopePhase + envelopeIncrement * static_cast<float>(i + lane));
+
+        (interpolator.process(source, lanePositions) * FloatVector::fromRawArray(envelope)).copyToRawArray(dest + i);
+        positions += positionStep;
+    }
+}
+
+void GrainScheduler::advanceGrains(int numSamples) noexcept
+{
+    const auto numActive = pool.getNumActive();
+    auto* positions = pool.getReadPositions();
+    auto* rates = pool.getPlaybackRates();
+    auto* phases = pool.getEnvelopePhases();
+    auto* increments = pool.getEnvelopeIncrements();
+    auto* offsets = pool.getStartOffsets();
+
+    // Envelope phases move forward by the samples each grain actually sounded in this block
+    const auto blockLength = FloatVector::expand(static_cast<float>(numSamples));
+
+    for (int i = 0; i < numActive; i += vectorSize)
+    {
+        const auto elapsed = blockLength - FloatVector::fromRawArray(offsets + i);
+        const auto advanced = FloatVector::fromRawArray(phases + i) + FloatVector::fromRawArray(increments + i) * elapsed;
+        advanced.copyToRawArray(phases + i);
+    }
+
+    for (int i = 0; i < numActive; ++i)
+    {
+        positions[i] += static_cast<double>(rates[i]) * (numSamples - offsets[i]);
+        offsets[i] = 0.0f;
+    }
+
+    // Retire from the back so that grains moved into a freed slot have already been checked
+    for (int i = numActive; --i >= 0;)
+        if (phases[i] >= 1.0f)
+            pool.retire(i);
+}
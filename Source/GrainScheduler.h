@@ -0,0 +1,234 @@
+#pragma once
+
+#include "AlignedBuffer.h"
+#include "GrainEffects.h"
+#include "GrainEnvelopeTable.h"
+#include "GrainPool.h"
+#include "GrainRandom.h"
+#include "GrainRenderPool.h"
+#include "GrainResampler.h"
+#include "GrainSource.h"
+#include "GrainSpatialiser.h"
+#include "GrainVisualFeed.h"
+#include "OnsetIndex.h"
+
+#include <juce_core/juce_core.h>
+#include <juce_dsp/juce_dsp.h>
+
+#include <array>
+
+/**
+ * GrainScheduler - Spawns, renders and retires grains for one engine instance
+ * All memory is sized in prepare() from the block size and the maximum density, so
+ * process() never allocates or locks and can run directly inside processBlock.
+ * Grains are rendered with juce::dsp::SIMDRegister, several output samples per
+ * instruction, which maps to SSE on x86_64 and NEON on arm64 (AVX when enabled).
+ * Dense clouds can optionally be split into chunks of grains rendered on a GrainRenderPool,
+ * each participant accumulating into its own mix buffers, which are summed afterwards.
+ * Every grain keeps reading the source it was spawned from, so replacing the source
+ * crossfades grain by grain instead of cutting the ones already sounding. A GrainEffects
+ * filter and bit crusher can follow each grain's window, with coefficients shared per block.
+ * Grains are placed in the output layout by a GrainSpatialiser when they spawn, and the whole
+ * grain is then added into each output channel it reaches with a single vector multiply-add.
+ */
+class GrainScheduler : private GrainRenderPool::Job
+{
+public:
+    //==============================================================================
+    /** Per-block grain settings, normally derived from the plugin parameters. */
+    struct Settings
+    {
+        float density = 20.0f;         // Grains spawned per second
+        float grainSizeMs = 100.0f;    // Grain duration in milliseconds
+        float position = 1.0f;         // 0 = oldest readable material, 1 = newest
+        float spray = 0.0f;            // Random position offset as a fraction of the readable range
+        float playbackRate = 1.0f;     // Source frames read per output sample, see getPlaybackRate()
+        GrainEnvelopeShape envelopeShape = GrainEnvelopeShape::hann;  // Window of newly spawned grains
+        ResamplerQuality resamplerQuality = ResamplerQuality::hermite;  // Interpolation tier for all grains
+        bool multiThreaded = false;    // Spread dense clouds over the render workers
+        bool batch = false;            // Offline render: wait for workers however long they take
+        const OnsetIndex* onsets = nullptr;  // Transients of the source, on its timeline; valid for one block
+        float onsetSnap = 0.0f;        // Probability that a new grain starts on the nearest onset
+        GrainEffects::Settings effects;  // New grains take the filter response; the rest applies to every grain
+
+        // While a new source fades in, some new grains still come from the one it replaces
+        const GrainSource* fadingSource = nullptr;  // Must stay valid until its last grain has ended
+        float fadingPlaybackRate = 1.0f;
+        float crossfade = 1.0f;        // Share of new grains spawned from the main source
+    };
+
+    static constexpr float maxGrainSizeMs = 1000.0f;
+    static constexpr float maxPitchSemitones = 24.0f;
+
+    using FloatVector = juce::dsp::SIMDRegister<float>;
+    static constexpr int vectorSize = static_cast<int>(FloatVector::SIMDNumElements);
+
+    static constexpr int grainsPerChunk = 16;          // Unit of work handed to render workers
+    static constexpr int minGrainsForWorkers = 64;     // Below this, waking workers costs more than it saves
+    static constexpr double renderTimeoutFraction = 0.5;  // Share of a block's duration spent waiting on workers
+
+    //==============================================================================
+    GrainScheduler() = default;
+    ~GrainScheduler() override;
+
+    /**
+     * Sizes the grain pool and scratch buffers for the worst case the given settings allow,
+     * and starts numRenderWorkers render threads for multi-threaded settings. Grains are
+     * spread over outputLayout, which GrainSpatialiser must support. Calling it again only
+     * reallocates what has to grow. Must not be called from the audio thread.
+     */
+    void prepare(double sampleRate, int maxBlockSize, float maxDensity, int numRenderWorkers = 0,
+                 const juce::AudioChannelSet& outputLayout = juce::AudioChannelSet::stereo());
+
+    /** Waits for the resampler's background tables; see GrainResampler::waitForTables(). */
+    bool waitForTables(int timeoutMs = -1) { return resampler.waitForTables(timeoutMs); }
+
+    /** Stops the render workers. Must not be called from the audio thread. */
+    void stopRenderWorkers();
+
+    /**
+     * Stops the render workers and frees the grain pool and scratch buffers; process() does
+     * nothing until the next prepare(). Must not be called from the audio thread.
+     */
+    void releaseResources();
+    void reset() noexcept;
+
+    /**
+     * Restarts the random sequence behind spray, pan, onset snap and crossfade choices, so the
+     * same seed followed by the same calls spawns the same grains. Not while process() runs.
+     */
+    void setRandomSeed(juce::uint64 seed) noexcept { random.setSeed(seed); }
+
+    /**
+     * Spawns the grains due in this block and adds every active grain into the outputs, one
+     * channel for each of getNumOutputChannels(). numSamples must not exceed the block size
+     * passed to prepare(). Grains spawned from any source, including settings.fadingSource,
+     * must be able to read it until they end.
+     */
+    void process(const Settings& settings, const GrainSource& source,
+                 float* const* outputs, int numSamples) noexcept;
+
+    /** process() for an engine prepared for stereo. */
+    void process(const Settings& settings, const GrainSource& source,
+                 float* left, float* right, int numSamples) noexcept
+    {
+        jassert(getNumOutputChannels() == 2);
+        float* const outputs[] = { left, right };
+        process(settings, source, outputs, numSamples);
+    }
+
+    /**
+     * Spawns one grain outside the density clock, starting startOffset samples into the next
+     * process() call, e.g. for a MIDI note. playbackRate is clamped like the cloud's, and gain
+     * scales the grain's level. The grain is dropped if the pool is full.
+     */
+    void trigger(const Settings& settings, const GrainSource& source, float playbackRate, float gain, int startOffset) noexcept;
+
+    /**
+     * Describes the active grains for the editor, from every grain down to an evenly spaced
+     * selection of GrainVisualFeed::maxGrainsPerFrame of them. Wait-free, for the audio thread.
+     */
+    void fillVisualFrame(GrainVisualFeed::Frame& frame) noexcept;
+
+    //==============================================================================
+    int getNumActiveGrains() const noexcept { return pool.getNumActive(); }
+    int getGrainCapacity() const noexcept { return pool.getCapacity(); }
+    int getMaxBlockSize() const noexcept { return maxBlockSize; }
+    int getNumRenderWorkers() const noexcept { return renderPool.getNumWorkers(); }
+    int getNumOutputChannels() const noexcept { return spatialiser.getNumChannels(); }
+    const GrainSpatialiser& getSpatialiser() const noexcept { return spatialiser; }
+    juce::uint32 getNumRenderTimeouts() const noexcept { return renderPool.getNumTimeouts(); }
+
+    /** Returns the highest playback rate the scratch buffers are sized for. */
+    static float getMaxPlaybackRate() noexcept;
+
+    /**
+     * Converts a transposition and the source/engine sample rate ratio into a clamped
+     * playback rate. This calls std::pow, so callers only recompute it when either input changes.
+     */
+    static float getPlaybackRate(float pitchSemitones, float sourceRateRatio) noexcept;
+
+private:
+    //==============================================================================
+    /** One grain's attributes, copied out of the pool for rendering. */
+    struct GrainState
+    {
+        double readPosition;
+        float playbackRate, envelopePhase, envelopeIncrement;
+        GrainSpatialiser::Gains channelGains;
+        int startOffset;
+        GrainEnvelopeShape envelopeShape;
+        const GrainSource* source;
+        GrainEffectState effectState;    // Advanced by rendering, then written back to the pool
+        int index;                       // Slot in the pool
+    };
+
+    /** A grain's effect state after rendering, for the audio thread to write back. */
+    struct EffectResult
+    {
+        int index;
+        GrainEffectState state;
+    };
+
+    /** The private buffers of one render participant; index 0 belongs to the audio thread. */
+    struct alignas(64) RenderContext
+    {
+        AlignedBuffer<float> sourceScratch, grainScratch;
+        AlignedBuffer<float> mix;   // One row of mixStride samples per output channel
+        AlignedBuffer<EffectResult> effectResults;   // Of every grain this participant ran effects on
+        int numEffectResults = 0;
+
+        // The chunk this participant last loaded
+        std::array<GrainState, grainsPerChunk> grains;
+        int numGrains = 0;
+        ResamplerQuality quality = ResamplerQuality::hermite;
+        GrainEffects effects;
+        int numSamples = 0;
+    };
+
+    //==============================================================================
+    double getGrainLengthInSamples(const Settings& settings) const noexcept;
+    void spawnGrain(const Settings& settings, const GrainSource& source, const OnsetIndex* onsets,
+                    float playbackRate, int startOffset, float gain = 1.0f) noexcept;
+    GrainState getGrainState(int index) noexcept;
+    void renderGrain(GrainState& grain, ResamplerQuality quality, const GrainEffects& blockEffects,
+                     int numSamples, RenderContext& context) const noexcept;
+    void advanceGrains(int numSamples) noexcept;
+    float* getMix(RenderContext& context, int channel) const noexcept { return context.mix.get() + channel * mixStride; }
+
+    // GrainRenderPool::Job
+    void beginParticipant(int participant) noexcept override;
+    void loadChunk(int participant, int chunk) noexcept override;
+    void renderChunk(int participant) noexcept override;
+
+    /**
+     * Renders count mono samples of one grain into the aligned dest buffer, reading the source
+     * through interpolator and windowing it with envelopeTable.
+     */
+    template <typename Interpolator, typename EnvelopeTable>
+    static void renderGrainSamples(const Interpolator& interpolator, const EnvelopeTable& envelopeTable,
+                                   const float* source, float basePosition, float playbackRate,
+                                   float envelopePhase, float envelopeIncrement,
+                                   float* dest, int count) noexcept;
+
+    //==============================================================================
+    GrainPool pool;
+    std::array<RenderContext, GrainRenderPool::maxParticipants> contexts;
+    juce::SharedResourcePointer<GrainEnvelopeTables> envelopeTables;   // Read-only, so one set serves every instance
+    GrainResampler resampler;
+    GrainEffects effects;   // This block's coefficients, copied by render workers like blockQuality
+    GrainSpatialiser spatialiser;
+    GrainRandom random;
+    GrainRenderPool renderPool;
+
+    // The block being rendered, read by render workers after GrainRenderPool::run() publishes it
+    ResamplerQuality blockQuality = ResamplerQuality::hermite;
+    int blockNumSamples = 0;
+
+    double currentSampleRate = 44100.0;
+    int maxBlockSize = 0;
+    int mixStride = 0;   // maxBlockSize rounded up to whole vectors
+    double samplesUntilNextGrain = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GrainScheduler)
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+/**
+ * GrainSource - Abstract read interface for material that grains play back from
+ * Positions are absolute sample indices on the source's own timeline. Implementations
+ * must make readSamples() real-time safe: no allocation, no locking, no blocking I/O.
+ * The grain engine may render on several threads, so reads and prefetch hints can arrive
+ * concurrently from the audio thread and its render workers.
+ */
+class GrainSource
+{
+public:
+    virtual ~GrainSource() = default;
+
+    /** Returns the range of sample positions that can currently be read. */
+    virtual juce::Range<juce::int64> getReadableRange() const noexcept = 0;
+
+    /**
+     * Copies numSamples mono samples starting at startSample into dest.
+     * Positions outside the readable range produce silence.
+     */
+    virtual void readSamples(float* dest, juce::int64 startSample, int numSamples) const noexcept = 0;
+
+    /**
+     * Hints that grains are about to read the given span, so slow backing storage can be
+     * warmed up ahead of time. Called from the audio thread and must never block.
+     */
+    virtual void prefetch(juce::int64 startSample, juce::int64 numSamples) const noexcept
+    {
+        juce::ignoreUnused(startSample, numSamples);
+    }
+};
@@ -0,0 +1,276 @@
+#include "GrainSpatialiser.h"
+
+#include <algorithm>
+#include <cmath>
+
+//==============================================================================
+namespace
+{
+    constexpr float pi = juce::MathConstants<float>::pi;
+    constexpr float twoPi = juce::MathConstants<float>::twoPi;
+
+    // Speakers closer than this are treated as one, and pairs this close to half a circle apart as opposite
+    constexpr float angleTolerance = 1.0e-3f;
+
+    /** Wraps an angle into [0, 2 pi). */
+    float wrapPositive(float angle) noexcept
+    {
+        angle = std::fmod(angle, twoPi);
+        return angle < 0.0f ? angle + twoPi : angle;
+    }
+
+    double factorial(int n) noexcept
+    {
+        auto result = 1.0;
+
+        for (int i = 2; i <= n; ++i)
+            result *= i;
+
+        return result;
+    }
+
+    /** The associated Legendre function P_l^m(0), without the Condon-Shortley phase, as AmbiX defines it. */
+    double legendreAtZero(int l, int m) noexcept
+    {
+        // P_m^m(0) = (2m - 1)!!, P_(m+1)^m(0) = 0, and from there P_l^m(0) = -(l + m - 1) / (l - m) * P_(l-2)^m(0)
+        if ((l - m) % 2 != 0)
+            return 0.0;
+
+        auto value = 1.0;
+
+        for (int k = 1; k <= m; ++k)
+            value *= 2.0 * k - 1.0;
+
+        for (int degree = m + 2; degree <= l; degree += 2)
+            value *= -static_cast<double>(degree + m - 1) / static_cast<double>(degree - m);
+
+        return value;
+    }
+}
+
+//==============================================================================
+bool GrainSpatialiser::isLayoutSupported(const juce::AudioChannelSet& layout)
+{
+    if (layout.size() < 2 || layout.size() > maxChannels)
+        return false;
+
+    const auto order = layout.getAmbisonicOrder();
+
+    if (order >= 0)
+        return order >= 1 && order <= maxAmbisonicOrder;
+
+    Ring unused;
+    return buildRing(layout, unused);
+}
+
+void GrainSpatialiser::prepare(const juce::AudioChannelSet& requestedLayout)
+{
+    // An unsupported layout gets stereo grains in its first two channels rather than none at all
+    jassert(isLayoutSupported(requestedLayout));
+    const auto layout = isLayoutSupported(requestedLayout) ? requestedLayout : juce::AudioChannelSet::stereo();
+
+    stereo = layout == juce::AudioChannelSet::stereo();
+    ambisonicOrder = layout.getAmbisonicOrder();
+    ring = {};
+
+    if (ambisonicOrder < 0)
+    {
+        buildRing(layout, ring);
+        numChannels = layout.size();
+        return;
+    }
+
+    numChannels = (ambisonicOrder + 1) * (ambisonicOrder + 1);
+    ring.fullCircle = true;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        // ACN numbers the harmonic of order l and index m as l * l + l + m
+        const auto l = static_cast<int>(std::sqrt(static_cast<double>(channel)) + 1.0e-9);
+        const auto m = channel - l * l - l;
+        const auto absM = std::abs(m);
+
+        const auto normalisation = std::sqrt((m == 0 ? 1.0 : 2.0) * factorial(l - absM) / factorial(l + absM));
+        ambisonicFactors[static_cast<size_t>(channel)] = static_cast<float>(normalisation * legendreAtZero(l, absM));
+        ambisonicIndices[static_cast<size_t>(channel)] = m;
+    }
+}
+
+//==============================================================================
+bool GrainSpatialiser::getSpeakerAzimuth(juce::AudioChannelSet::ChannelType type, int index, int numDiscrete, float& azimuth)
+{
+    using Type = juce::AudioChannelSet::ChannelType;
+
+    // A discrete layout is a ring of equally spaced speakers, clockwise from the front
+    if (numDiscrete > 0)
+    {
+        azimuth = -twoPi * static_cast<float>(index) / static_cast<float>(numDiscrete);
+        return true;
+    }
+
+    // The ear-level positions of ITU-R BS.2051, in degrees anticlockwise from the front
+    float degrees = 0.0f;
+
+    switch (type)
+    {
+        case Type::centre:             degrees = 0.0f; break;
+        case Type::leftCentre:         degrees = 15.0f; break;
+        case Type::rightCentre:        degrees = -15.0f; break;
+        case Type::left:               degrees = 30.0f; break;
+        case Type::right:              degrees = -30.0f; break;
+        case Type::wideLeft:           degrees = 60.0f; break;
+        case Type::wideRight:          degrees = -60.0f; break;
+        case Type::leftSurroundSide:   degrees = 90.0f; break;
+        case Type::rightSurroundSide:  degrees = -90.0f; break;
+        case Type::leftSurround:       degrees = 110.0f; break;
+        case Type::rightSurround:      degrees = -110.0f; break;
+        case Type::leftSurroundRear:   degrees = 150.0f; break;
+        case Type::rightSurroundRear:  degrees = -150.0f; break;
+        case Type::centreSurround:     degrees = 180.0f; break;
+        default:                       return false;   // LFE, height and unknown channels
+    }
+
+    azimuth = juce::degreesToRadians(degrees);
+    return true;
+}
+
+bool GrainSpatialiser::buildRing(const juce::AudioChannelSet& layout, Ring& newRing)
+{
+    struct Speaker
+    {
+        float azimuth;
+        int channel;
+    };
+
+    std::array<Speaker, maxChannels> speakers {};
+    int numSpeakers = 0;
+    const auto numDiscrete = layout.isDiscreteLayout() ? layout.size() : 0;
+
+    for (int channel = 0; channel < layout.size() && channel < maxChannels; ++channel)
+    {
+        float azimuth = 0.0f;
+
+        if (getSpeakerAzimuth(layout.getTypeOfChannel(channel), channel, numDiscrete, azimuth))
+            speakers[static_cast<size_t>(numSpeakers++)] = { wrapPositive(azimuth), channel };
+    }
+
+    if (numSpeakers < 2)
+        return false;
+
+    std::sort(speakers.begin(), speakers.begin() + numSpeakers,
+              [](const Speaker& a, const Speaker& b) { return a.azimuth < b.azimuth; });
+
+    // Every adjacent pair, anticlockwise, the last one closing the circle
+    newRing = {};
+    int widest = 0;
+
+    for (int i = 0; i < numSpeakers; ++i)
+    {
+        const auto& first = speakers[static_cast<size_t>(i)];
+        const auto& second = speakers[static_cast<size_t>((i + 1) % numSpeakers)];
+
+        auto& segment = newRing.segments[static_cast<size_t>(i)];
+        segment.startAzimuth = first.azimuth;
+        segment.width = i + 1 < numSpeakers ? second.azimuth - first.azimuth : second.azimuth + twoPi - first.azimuth;
+        segment.firstChannel = first.channel;
+        segment.secondChannel = second.channel;
+
+        if (segment.width > newRing.segments[static_cast<size_t>(widest)].width)
+            widest = i;
+    }
+
+    newRing.numSegments = numSpeakers;
+
+    // VBAP cannot pan across a gap of half a circle or more, so grains keep to the arc beside it
+    const auto gap = newRing.segments[static_cast<size_t>(widest)];
+    newRing.fullCircle = gap.width < pi - angleTolerance;
+
+    if (! newRing.fullCircle)
+    {
+        newRing.leftAzimuth = gap.startAzimuth;
+        newRing.arcWidth = twoPi - gap.width;
+        newRing.leftChannel = gap.firstChannel;
+        newRing.rightChannel = gap.secondChannel;
+        newRing.segments[static_cast<size_t>(widest)] = newRing.segments[static_cast<size_t>(--newRing.numSegments)];
+    }
+
+    // Each remaining pair must span less than half a circle, and coincident speakers have nothing to pan between
+    for (int i = 0; i < newRing.numSegments; ++i)
+    {
+        const auto width = newRing.segments[static_cast<size_t>(i)].width;
+
+        if (width < angleTolerance || width > pi - angleTolerance)
+            return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+float GrainSpatialiser::getAzimuth(float position) const noexcept
+{
+    return ring.fullCircle ? pi - twoPi * position
+                           : ring.leftAzimuth - position * ring.arcWidth;
+}
+
+float GrainSpatialiser::getPanAzimuth(float pan) const noexcept
+{
+    const auto clamped = juce::jlimit(-1.0f, 1.0f, pan);
+
+    return ring.fullCircle ? -clamped * pi * 0.5f
+                           : getAzimuth((clamped + 1.0f) * 0.5f);
+}
+
+void GrainSpatialiser::computeGainsForAzimuth(float azimuth, float gain, float* gains) const noexcept
+{
+    std::fill(gains, gains + numChannels, 0.0f);
+
+    if (ambisonicOrder >= 0)
+    {
+        computeAmbisonicGains(azimuth, gain, gains);
+        return;
+    }
+
+    for (int i = 0; i < ring.numSegments; ++i)
+    {
+        const auto& segment = ring.segments[static_cast<size_t>(i)];
+        const auto offset = wrapPositive(azimuth - segment.startAzimuth);
+
+        if (offset > segment.width)
+            continue;
+
+        // The 2-D VBAP solution up to its common factor 1 / sin(width), normalised to constant power
+        const auto first = std::sin(segment.width - offset);
+        const auto second = std::sin(offset);
+        const auto scale = gain / std::sqrt(first * first + second * second);
+
+        gains[segment.firstChannel] = first * scale;
+        gains[segment.secondChannel] = second * scale;
+        return;
+    }
+
+    // Past either end of an arc, the nearer end speaker takes the whole grain
+    const auto pastLeft = wrapPositive(azimuth - ring.leftAzimuth);
+    gains[pastLeft <= (twoPi - ring.arcWidth) * 0.5f ? ring.leftChannel : ring.rightChannel] = gain;
+}
+
+void GrainSpatialiser::computeAmbisonicGains(float azimuth, float gain, float* gains) const noexcept
+{
+    // cos(m a) and sin(m a) for every index, by repeated rotation rather than a call each
+    std::array<float, maxAmbisonicOrder + 1> cosines {}, sines {};
+    const auto cosine = std::cos(azimuth), sine = std::sin(azimuth);
+    cosines[0] = 1.0f;
+
+    for (size_t m = 1; m < cosines.size(); ++m)
+    {
+        cosines[m] = cosines[m - 1] * cosine - sines[m - 1] * sine;
+        sines[m] = sines[m - 1] * cosine + cosines[m - 1] * sine;
+    }
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const auto m = ambisonicIndices[static_cast<size_t>(channel)];
+        const auto harmonic = m >= 0 ? cosines[static_cast<size_t>(m)] : sines[static_cast<size_t>(-m)];
+        gains[channel] = gain * ambisonicFactors[static_cast<size_t>(channel)] * harmonic;
+    }
+}
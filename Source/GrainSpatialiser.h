@@ -0,0 +1,97 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <array>
+
+/**
+ * GrainSpatialiser - Per-grain output gain vectors for stereo, surround and ambisonic layouts
+ * Each grain is given a direction when it spawns, and this turns the direction into one gain
+ * per output channel, which the renderer then applies to the whole grain with a vector
+ * multiply-add per channel. Nothing is worked out per sample.
+ *
+ * Speaker layouts (stereo, quad, 5.1, 7.1 and other named layouts, or a discrete ring of
+ * equally spaced speakers with channel 0 at the front, running clockwise) are panned with
+ * two-dimensional VBAP between the adjacent pair of ear-level speakers around the direction,
+ * at constant power. Layouts whose speakers all sit in front spread grains across the front
+ * arc only; the others spread them all the way round. Height and LFE channels get no grains.
+ * Ambisonic layouts encode each grain in the horizontal plane, in ACN order with SN3D
+ * normalisation (AmbiX), up to maxAmbisonicOrder.
+ *
+ * Directions are given as a position along the layout's panning arc, 0 at its left end and
+ * rising clockwise, so the engine can draw them like any other random grain attribute.
+ * Preparing only fills fixed-size tables; nothing here allocates or locks.
+ */
+class GrainSpatialiser
+{
+public:
+    //==============================================================================
+    static constexpr int maxChannels = 32;
+    static constexpr int maxAmbisonicOrder = 4;   // 25 channels
+
+    using Gains = std::array<float, maxChannels>;
+
+    //==============================================================================
+    GrainSpatialiser() { prepare(juce::AudioChannelSet::stereo()); }
+
+    /** True for the output layouts prepare() can pan grains over. */
+    static bool isLayoutSupported(const juce::AudioChannelSet& layout);
+
+    /** Builds the panning tables for layout, which must be supported. */
+    void prepare(const juce::AudioChannelSet& layout);
+
+    int getNumChannels() const noexcept { return numChannels; }
+
+    /** True for plain left/right stereo, whose width and pan the OutputStage handles itself. */
+    bool isStereo() const noexcept { return stereo; }
+
+    //==============================================================================
+    /** Writes getNumChannels() gains, at the given overall gain, for a grain at position along the arc. */
+    void computeGains(float position, float gain, float* gains) const noexcept
+    {
+        computeGainsForAzimuth(getAzimuth(position), gain, gains);
+    }
+
+    /** Writes getNumChannels() gains for a source at the azimuth, in radians anticlockwise from the front. */
+    void computeGainsForAzimuth(float azimuth, float gain, float* gains) const noexcept;
+
+    /** The azimuth of a position along the panning arc, 0 = its left end and 1 = its right end. */
+    float getAzimuth(float position) const noexcept;
+
+    /** The azimuth a pan control points at: -1 to 1 spans the front arc, or the left to the right side. */
+    float getPanAzimuth(float pan) const noexcept;
+
+private:
+    //==============================================================================
+    /** One pair of adjacent speakers, from the first anticlockwise to the second. */
+    struct Segment
+    {
+        float startAzimuth = 0.0f, width = 0.0f;
+        int firstChannel = 0, secondChannel = 0;
+    };
+
+    struct Ring
+    {
+        std::array<Segment, maxChannels> segments {};
+        int numSegments = 0;
+        bool fullCircle = false;
+        float leftAzimuth = 0.0f, arcWidth = 0.0f;   // Of the arc, when it is not the full circle
+        int leftChannel = 0, rightChannel = 0;       // The speakers at either end of the arc
+    };
+
+    static bool buildRing(const juce::AudioChannelSet& layout, Ring& ring);
+    static bool getSpeakerAzimuth(juce::AudioChannelSet::ChannelType type, int index, int numDiscrete, float& azimuth);
+
+    void computeAmbisonicGains(float azimuth, float gain, float* gains) const noexcept;
+
+    //==============================================================================
+    int numChannels = 0;
+    bool stereo = false;
+    int ambisonicOrder = -1;   // -1 for speaker layouts
+
+    Ring ring;
+
+    // Per ACN channel: the SN3D-normalised Legendre factor at zero elevation, and the harmonic's index m
+    std::array<float, maxChannels> ambisonicFactors {};
+    std::array<int, maxChannels> ambisonicIndices {};
+};
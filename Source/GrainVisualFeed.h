@@ -0,0 +1,126 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+#include <atomic>
+#include <cmath>
+
+/**
+ * GrainVisualFeed - Wait-free audio-to-editor queue of decimated grain snapshots
+ * The audio thread publishes at most framesPerSecond snapshots, each holding no more than
+ * maxGrainsPerFrame grains, into a single-producer single-consumer juce::AbstractFifo of
+ * preallocated frames. The editor drains it from a timer and keeps the newest frame. When
+ * the queue is full, because the editor is lagging or stalled, new snapshots are dropped
+ * rather than waited for. Nothing is gathered at all until a consumer calls setActive(true),
+ * so without an open editor the feed costs the audio thread one relaxed atomic load a block.
+ */
+class GrainVisualFeed
+{
+public:
+    //==============================================================================
+    static constexpr int maxGrainsPerFrame = 512;
+    static constexpr int numFrames = 8;               // The queue holds one less than this
+    static constexpr double framesPerSecond = 30.0;   // Display rate; faster snapshots would go unseen
+
+    /** One grain as the editor draws it. */
+    struct Grain
+    {
+        float position = 0.0f;   // Read position across its source's readable range, 0 to 1
+        float level = 0.0f;      // Gain times the current envelope value
+        float pan = 0.0f;        // -1 = left, 1 = right
+    };
+
+    struct Frame
+    {
+        int numGrains = 0;       // Grains in grains[], after decimation
+        int numActive = 0;       // Grains sounding when the frame was taken
+        std::array<Grain, maxGrainsPerFrame> grains {};
+
+        /** Adds a grain unless the frame is full; the producer decimates before that happens. */
+        void add(const Grain& grain) noexcept
+        {
+            if (numGrains < maxGrainsPerFrame)
+                grains[static_cast<size_t>(numGrains++)] = grain;
+        }
+    };
+
+    //==============================================================================
+    GrainVisualFeed() = default;
+
+    /** Sets how many samples pass between snapshots. Not for the audio thread. */
+    void prepare(double sampleRate) noexcept
+    {
+        samplesPerFrame = juce::jmax(1, static_cast<int>(std::ceil(sampleRate / framesPerSecond)));
+        samplesUntilFrame = 0;
+    }
+
+    /** Starts or stops gathering snapshots; called by the consumer, e.g. when an editor opens or closes. */
+    void setActive(bool shouldBeActive) noexcept { active.store(shouldBeActive, std::memory_order_relaxed); }
+    bool isActive() const noexcept { return active.load(std::memory_order_relaxed); }
+
+    //==============================================================================
+    /**
+     * Producer side, once per audio block: when the feed is active and a snapshot is due,
+     * calls fill(Frame&) on a cleared frame and queues it, or drops it if the queue is full.
+     * Wait-free; fill must be as well.
+     */
+    template <typename FillFunction>
+    void publish(int numSamples, FillFunction&& fill) noexcept
+    {
+        if (! isActive())
+            return;
+
+        samplesUntilFrame -= numSamples;
+
+        if (samplesUntilFrame > 0)
+            return;
+
+        samplesUntilFrame = samplesPerFrame;
+
+        if (fifo.getFreeSpace() == 0)
+        {
+            ++numDropped;
+            return;
+        }
+
+        fifo.write(1).forEach([this, &fill](int index)
+        {
+            auto& frame = frames[static_cast<size_t>(index)];
+            frame.numGrains = 0;
+            frame.numActive = 0;
+            fill(frame);
+        });
+    }
+
+    /**
+     * Consumer side: drains every queued frame and copies the newest one into dest.
+     * Returns false, leaving dest alone, if nothing was queued since the last call.
+     */
+    bool readLatest(Frame& dest) noexcept
+    {
+        const auto numReady = fifo.getNumReady();
+
+        if (numReady == 0)
+            return false;
+
+        fifo.read(numReady).forEach([this, &dest](int index) { dest = frames[static_cast<size_t>(index)]; });
+        return true;
+    }
+
+    /** Snapshots dropped because the consumer did not keep up, since construction. */
+    juce::uint32 getNumDropped() const noexcept { return numDropped.load(std::memory_order_relaxed); }
+
+private:
+    //==============================================================================
+    juce::AbstractFifo fifo { numFrames };
+    std::array<Frame, numFrames> frames {};
+    std::atomic<bool> active { false };
+    std::atomic<juce::uint32> numDropped { 0 };
+
+    // Audio thread state
+    int samplesPerFrame = 1;
+    int samplesUntilFrame = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(GrainVisualFeed)
+};
@@ -0,0 +1,135 @@
+#include "GrainVoiceAllocator.h"
+
+#include <algorithm>
+
+//==============================================================================
+void GrainVoiceAllocator::prepare(double sampleRate) noexcept
+{
+    currentSampleRate = sampleRate;
+    reset();
+}
+
+void GrainVoiceAllocator::reset() noexcept
+{
+    voices.fill({});
+}
+
+//==============================================================================
+void GrainVoiceAllocator::noteOn(int note, float velocity, float playbackRate) noexcept
+{
+    auto& voice = findVoiceFor(note);
+
+    voice.note = note;
+    voice.velocity = velocity;
+    voice.playbackRate = playbackRate;
+    voice.level = 1.0f;
+    voice.held = true;
+    voice.startOrder = nextStartOrder++;
+
+    // The first grain starts on the note's own sample
+    voice.samplesUntilNextGrain = 0.0;
+}
+
+void GrainVoiceAllocator::noteOff(int note) noexcept
+{
+    for (auto& voice : voices)
+        if (voice.note == note && voice.held)
+            voice.held = false;
+}
+
+GrainVoiceAllocator::Voice& GrainVoiceAllocator::findVoiceFor(int note) noexcept
+{
+    Voice* free = nullptr;
+    Voice* quietestReleasing = nullptr;
+    Voice* oldestHeld = nullptr;
+
+    for (auto& voice : voices)
+    {
+        if (voice.note == note)
+            return voice;
+
+        if (! voice.isActive())
+        {
+            if (free == nullptr)
+                free = &voice;
+        }
+        else if (! voice.held)
+        {
+            if (quietestReleasing == nullptr || voice.getLoudness() < quietestReleasing->getLoudness())
+                quietestReleasing = &voice;
+        }
+        else if (oldestHeld == nullptr || voice.startOrder < oldestHeld->startOrder)
+        {
+            oldestHeld = &voice;
+        }
+    }
+
+    if (free != nullptr)
+        return *free;
+
+    // A fading voice is missed less than a held one
+    ++numStolen;
+    return quietestReleasing != nullptr ? *quietestReleasing : *oldestHeld;
+}
+
+//==============================================================================
+float GrainVoiceAllocator::process(const GrainScheduler::Settings& settings, const GrainSource& source, GrainScheduler& scheduler,
+                                   float grainsPerSecondBudget, int numSamples) noexcept
+{
+    const auto numActive = getNumActiveVoices();
+    const auto density = std::max(0.0f, settings.density);
+
+    // Every voice asks for the cloud's density, and the free-running cloud counts as one more
+    const auto demand = density * static_cast<float>(numActive + 1);
+    const auto scale = demand > grainsPerSecondBudget ? grainsPerSecondBudget / demand : 1.0f;
+
+    if (numActive == 0 || density * scale <= 0.0f)
+        return scale;
+
+    const auto interval = currentSampleRate / static_cast<double>(density * scale);
+    const auto releaseSamples = releaseSeconds * currentSampleRate;
+
+    for (auto& voice : voices)
+    {
+        if (! voice.isActive())
+            continue;
+
+        // A faster clock takes effect at once instead of after the slow interval runs out
+        voice.samplesUntilNextGrain = std::min(voice.samplesUntilNextGrain, interval);
+
+        for (; voice.samplesUntilNextGrain < numSamples; voice.samplesUntilNextGrain += interval)
+        {
+            const auto offset = static_cast<int>(voice.samplesUntilNextGrain);
+
+            // Released voices spawn ever quieter grains until they have faded out
+            const auto level = voice.held ? voice.level
+                                          : voice.level - static_cast<float>(offset / releaseSamples);
+
+            if (level > 0.0f)
+                scheduler.trigger(settings, source, voice.playbackRate, voice.velocity * level, offset);
+        }
+
+        voice.samplesUntilNextGrain -= numSamples;
+
+        if (! voice.held)
+        {
+            voice.level -= static_cast<float>(numSamples / releaseSamples);
+
+            if (voice.level <= 0.0f)
+                voice = {};
+        }
+    }
+
+    return scale;
+}
+
+//==============================================================================
+int GrainVoiceAllocator::getNumActiveVoices() const noexcept
+{
+    return static_cast<int>(std::count_if(voices.begin(), voices.end(), [](const Voice& voice) { return voice.isActive(); }));
+}
+
+int GrainVoiceAllocator::getNumHeldVoices() const noexcept
+{
+    return static_cast<int>(std::count_if(voices.begin(), voices.end(), [](const Voice& voice) { return voice.held; }));
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "GrainScheduler.h"
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+
+/**
+ * GrainVoiceAllocator - Fixed set of note voices, each driving its own grain cloud
+ * A note-on claims a voice that spawns grains at the density parameter and the note's
+ * transposition into the shared GrainScheduler, so every voice's grains live in the same
+ * pool and are rendered by the same SoA renderer as the free-running cloud. A note-off
+ * fades the voice out over releaseSeconds. With every voice busy, a new note steals the
+ * quietest releasing voice, or the oldest held one if none is releasing.
+ *
+ * The voices and the free-running cloud draw on one grain budget: when together they would
+ * spawn more grains per second than it allows, all of them are thinned by the same factor,
+ * so the pool, and with it the cost of a block, stays bounded however many notes are held.
+ * Nothing here allocates or locks; everything runs on the audio thread.
+ */
+class GrainVoiceAllocator
+{
+public:
+    //==============================================================================
+    static constexpr int maxVoices = 16;
+    static constexpr double releaseSeconds = 0.1;
+
+    //==============================================================================
+    GrainVoiceAllocator() = default;
+
+    void prepare(double sampleRate) noexcept;
+
+    /** Silences every voice at once; their grains already spawned keep sounding. */
+    void reset() noexcept;
+
+    /** Starts a voice for note, stealing one if all are busy. A note already sounding restarts its voice. */
+    void noteOn(int note, float velocity, float playbackRate) noexcept;
+
+    /** Releases the voice held by note, if there is one. */
+    void noteOff(int note) noexcept;
+
+    /** Sets every voice's playback rate from rateForNote(int note), e.g. after a pitch change. */
+    template <typename RateFunction>
+    void updatePlaybackRates(RateFunction&& rateForNote) noexcept
+    {
+        for (auto& voice : voices)
+            if (voice.isActive())
+                voice.playbackRate = rateForNote(voice.note);
+    }
+
+    /**
+     * Triggers the grains the voices spawn during the next numSamples into scheduler, ahead of its
+     * process() call for the same samples. Each voice spawns at settings.density, scaled so that
+     * the voices and a free-running cloud at that density stay within grainsPerSecondBudget.
+     * Returns the scale, which the caller applies to the free-running cloud as well.
+     */
+    float process(const GrainScheduler::Settings& settings, const GrainSource& source, GrainScheduler& scheduler,
+                  float grainsPerSecondBudget, int numSamples) noexcept;
+
+    //==============================================================================
+    int getNumActiveVoices() const noexcept;
+    int getNumHeldVoices() const noexcept;
+
+    /** Voices taken from a sounding note, since construction. */
+    juce::uint32 getNumStolen() const noexcept { return numStolen; }
+
+private:
+    //==============================================================================
+    struct Voice
+    {
+        int note = -1;
+        float velocity = 0.0f;
+        float playbackRate = 1.0f;
+        float level = 0.0f;             // 1 while held, falling to 0 after the note-off
+        bool held = false;
+        juce::uint32 startOrder = 0;    // Higher is newer
+        double samplesUntilNextGrain = 0.0;
+
+        bool isActive() const noexcept { return note >= 0; }
+        float getLoudness() const noexcept { return velocity * level; }
+    };
+
+    Voice& findVoiceFor(int note) noexcept;
+
+    //==============================================================================
+    std::array<Voice, maxVoices> voices {};
+    double currentSampleRate = 44100.0;
+    juce::uint32 nextStartOrder = 0;
+    juce::uint32 numStolen = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GrainVoiceAllocator)
+};
@@ -0,0 +1,82 @@
+#include "InputCaptureBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+//==============================================================================
+void InputCaptureBuffer::prepare(int capacityInSamples)
+{
+    jassert(capacityInSamples > 0);
+    // assign() keeps the allocation when the history shrinks
+    history.assign(static_cast<size_t>(capacityInSamples), 0.0f);
+    totalWritten = 0;
+}
+
+void InputCaptureBuffer::release()
+{
+    history.clear();
+    history.shrink_to_fit();
+    totalWritten = 0;
+}
+
+void InputCaptureBuffer::reset() noexcept
+{
+    std::fill(history.begin(), history.end(), 0.0f);
+    totalWritten = 0;
+}
+
+void InputCaptureBuffer::write(const float* source, int numSamples) noexcept
+{
+    const auto capacity = getCapacity();
+
+    if (capacity == 0 || numSamples <= 0)
+        return;
+
+    // Only the newest 'capacity' samples can survive a single oversized write
+    if (numSamples > capacity)
+    {
+        totalWritten += numSamples - capacity;
+        source += numSamples - capacity;
+        numSamples = capacity;
+    }
+
+    const auto writeIndex = static_cast<int>(totalWritten % capacity);
+    const auto firstPart = std::min(numSamples, capacity - writeIndex);
+
+    std::memcpy(history.data() + writeIndex, source, sizeof(float) * static_cast<size_t>(firstPart));
+    std::memcpy(history.data(), source + firstPart, sizeof(float) * static_cast<size_t>(numSamples - firstPart));
+
+    totalWritten += numSamples;
+}
+
+//==============================================================================
+juce::Range<juce::int64> InputCaptureBuffer::getReadableRange() const noexcept
+{
+    return { std::max<juce::int64>(0, totalWritten - getCapacity()), totalWritten };
+}
+
+void InputCaptureBuffer::readSamples(float* dest, juce::int64 startSample, int numSamples) const noexcept
+{
+    const auto readable = getReadableRange();
+    const auto capacity = getCapacity();
+
+    for (int i = 0; i < numSamples;)
+    {
+        const auto position = startSample + i;
+
+        if (! readable.contains(position))
+        {
+            dest[i++] = 0.0f;
+            continue;
+        }
+
+        // Copy the longest contiguous run that stays inside both the history and the readable range
+        const auto readIndex = static_cast<int>(position % capacity);
+        const auto run = static_cast<int>(std::min<juce::int64>({ static_cast<juce::int64>(numSamples - i),
+                                                                   static_cast<juce::int64>(capacity - readIndex),
+                                                                   readable.getEnd() - position }));
+
+        std::memcpy(dest + i, history.data() + readIndex, sizeof(float) * static_cast<size_t>(run));
+        i += run;
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "GrainSource.h"
+
+#include <vector>
+
+/**
+ * InputCaptureBuffer - Circular history of the live input that grains can read from
+ * The timeline starts at zero when the buffer is prepared and advances with every
+ * write(). Only the most recent getCapacity() samples are readable.
+ */
+class InputCaptureBuffer : public GrainSource
+{
+public:
+    InputCaptureBuffer() = default;
+
+    //==============================================================================
+    /** Allocates the history. Must not be called from the audio thread. */
+    void prepare(int capacityInSamples);
+    void reset() noexcept;
+
+    /** Frees the history until the next prepare(). Must not be called from the audio thread. */
+    void release();
+
+    /** Appends a block of input to the history. */
+    void write(const float* source, int numSamples) noexcept;
+
+    int getCapacity() const noexcept { return static_cast<int>(history.size()); }
+
+    //==============================================================================
+    juce::Range<juce::int64> getReadableRange() const noexcept override;
+    void readSamples(float* dest, juce::int64 startSample, int numSamples) const noexcept override;
+
+private:
+    //==============================================================================
+    std::vector<float> history;
+    juce::int64 totalWritten = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(InputCaptureBuffer)
+};
@@ -0,0 +1,218 @@
+#include "OnsetAnalyser.h"
+
+//==============================================================================
+OnsetAnalyser::OnsetAnalyser(std::unique_ptr<AnalysisCache> cacheToUse)
+    : juce::Thread("Onset analysis"), cache(std::move(cacheToUse))
+{
+}
+
+OnsetAnalyser::~OnsetAnalyser()
+{
+    requestGeneration.fetch_add(1);
+    signalThreadShouldExit();
+    notify();
+    stopThread(4000);
+}
+
+//==============================================================================
+void OnsetAnalyser::analyse(const juce::File& file, juce::uint32 sourceTag)
+{
+    {
+        const juce::ScopedLock scope(requestLock);
+        requestedFile = file;
+        requestedTag = sourceTag;
+        requestedOverviewOnly = false;
+        requestGeneration.fetch_add(1);
+        analysing.store(true, std::memory_order_relaxed);
+
+        // Cleared under requestLock, which the thread publishes under, so no stale result follows
+        publishOverview(nullptr);
+    }
+
+    // The previous source's onsets must not steer grains over the new one
+    publish(nullptr, 0);
+
+    if (! isThreadRunning())
+        startThread();
+
+    notify();
+}
+
+void OnsetAnalyser::setIndex(std::unique_ptr<OnsetIndex> newIndex, juce::uint32 sourceTag, const juce::File& overviewSource)
+{
+    {
+        const juce::ScopedLock scope(requestLock);
+        requestedFile = overviewSource;
+        requestedTag = sourceTag;
+        requestedOverviewOnly = true;
+        requestGeneration.fetch_add(1);
+        analysing.store(false, std::memory_order_relaxed);
+        publishOverview(nullptr);
+    }
+
+    const auto tag = newIndex != nullptr ? sourceTag : 0;
+    publish(std::move(newIndex), tag);
+
+    if (overviewSource == juce::File())
+        return;
+
+    if (! isThreadRunning())
+        startThread();
+
+    notify();
+}
+
+void OnsetAnalyser::clear()
+{
+    setIndex(nullptr);
+}
+
+juce::MemoryBlock OnsetAnalyser::getIndexData() const
+{
+    const juce::ScopedLock scope(publishLock);
+    return index != nullptr ? index->toStateData() : juce::MemoryBlock();
+}
+
+std::shared_ptr<const WaveformOverview> OnsetAnalyser::getOverview() const
+{
+    const juce::ScopedLock scope(overviewLock);
+    return overview;
+}
+
+//==============================================================================
+void OnsetAnalyser::publish(std::unique_ptr<OnsetIndex> newIndex, juce::uint32 newTag)
+{
+    const juce::ScopedLock scope(publishLock);
+
+    // New reads see the pending swap and get no index; wait for the ones in flight
+    swapPending.store(true);
+
+    while (activeReads.load() != 0)
+        juce::Thread::yield();
+
+    std::swap(index, newIndex);
+    indexTag = newTag;
+    swapPending.store(false);
+
+    // The previous index is freed here, after the audio thread has let go of it
+}
+
+void OnsetAnalyser::publishOverview(std::shared_ptr<const WaveformOverview> newOverview)
+{
+    const juce::ScopedLock scope(overviewLock);
+    std::swap(overview, newOverview);
+}
+
+void OnsetAnalyser::run()
+{
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    while (! threadShouldExit())
+    {
+        juce::File file;
+        juce::uint32 generation = 0, tag = 0;
+        auto overviewOnly = false;
+
+        {
+            const juce::ScopedLock scope(requestLock);
+            std::swap(file, requestedFile);
+            tag = requestedTag;
+            overviewOnly = requestedOverviewOnly;
+            generation = requestGeneration.load();
+        }
+
+        if (file == juce::File())
+        {
+            wait(-1);
+            continue;
+        }
+
+        const auto isStale = [this, generation] { return threadShouldExit() || requestGeneration.load() != generation; };
+
+        auto result = findOrAnalyse(file, formatManager, isStale);
+
+        // Publish under requestLock, so a request made meanwhile is never overwritten by this result
+        const juce::ScopedLock scope(requestLock);
+
+        if (isStale())
+            continue;
+
+        publishOverview(std::move(result.overview));
+
+        // Indices restored from saved state stay as they are
+        if (overviewOnly)
+            continue;
+
+        analysing.store(false, std::memory_order_relaxed);
+
+        if (result.index != nullptr)
+            publish(std::move(result.index), tag);
+    }
+}
+
+OnsetAnalyser::Analysis OnsetAnalyser::findOrAnalyse(const juce::File& file, juce::AudioFormatManager& formatManager,
+                                                     const std::function<bool()>& isStale) const
+{
+    Analysis result;
+    const auto identity = OnsetIndex::SourceIdentity::of(file);
+    const auto key = cache != nullptr ? AnalysisCache::Key::of(file) : AnalysisCache::Key();
+
+    if (auto entry = cache != nullptr ? cache->open(key) : nullptr)
+    {
+        size_t size = 0;
+        const auto* data = entry->getSection(AnalysisCache::SectionType::onsets, size);
+        result.index = OnsetIndex::fromCacheData(data, size, identity);
+
+        data = entry->getSection(AnalysisCache::SectionType::waveform, size);
+        result.overview = WaveformOverview::fromCacheData(data, size);
+
+        // Entries written before overviews existed are analysed again, which adds the overview
+        if (result.index != nullptr && result.overview != nullptr)
+            return result;
+    }
+
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+
+    if (reader == nullptr)
+        return result;
+
+    WaveformOverview::Builder overviewBuilder(reader->lengthInSamples);
+    auto index = OnsetIndex::analyse(*reader, identity, isStale, &overviewBuilder);
+
+    if (index == nullptr)
+        return {};
+
+    result.index = std::move(index);
+    result.overview = overviewBuilder.build();
+
+    if (cache != nullptr && key.isValid())
+    {
+        const auto onsetData = result.index->toCacheData();
+        const auto overviewData = result.overview->toCacheData();
+
+        cache->store(key, { { AnalysisCache::SectionType::onsets, onsetData.getData(), onsetData.getSize() },
+                            { AnalysisCache::SectionType::waveform, overviewData.getData(), overviewData.getSize() } });
+    }
+
+    return result;
+}
+
+//==============================================================================
+OnsetAnalyser::ScopedIndex::ScopedIndex(const OnsetAnalyser& ownerToUse) noexcept
+    : owner(ownerToUse)
+{
+    // Registering before checking for a swap pairs with the swap flagging before waiting
+    owner.activeReads.fetch_add(1);
+
+    if (! owner.swapPending.load())
+    {
+        index = owner.index.get();
+        sourceTag = owner.indexTag;
+    }
+}
+
+OnsetAnalyser::ScopedIndex::~ScopedIndex()
+{
+    owner.activeReads.fetch_sub(1);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "AnalysisCache.h"
+#include "OnsetIndex.h"
+
+#include <atomic>
+#include <memory>
+
+/**
+ * OnsetAnalyser - Builds the OnsetIndex and WaveformOverview of the current source on a background thread
+ * analyse() queues a file and returns at once. The thread first looks the file up in the
+ * AnalysisCache, if there is one, and otherwise decodes it with its own reader, so analysis
+ * never competes with the grain engine's cache or mapping, then stores the results. The
+ * overview is only for the editor and is handed out as a shared pointer under a lock. A newer request or
+ * clear() abandons an analysis in progress. The finished index is published the same way
+ * SampleLibrary swaps readers: the audio thread registers each access in activeReads and
+ * backs off while a swap is pending, so it never waits and never touches freed memory.
+ */
+class OnsetAnalyser : private juce::Thread
+{
+public:
+    //==============================================================================
+    /** Without a cache, every source is analysed from scratch. */
+    explicit OnsetAnalyser(std::unique_ptr<AnalysisCache> cacheToUse = nullptr);
+    ~OnsetAnalyser() override;
+
+    /**
+     * Starts analysing file in the background, replacing the current index when done.
+     * sourceTag is published with the index, so the engine can tell which source it describes.
+     */
+    void analyse(const juce::File& file, juce::uint32 sourceTag = 0);
+
+    /**
+     * Publishes an index restored from saved state straight away, cancelling any analysis.
+     * Sessions do not save overviews, so the one of overviewSource, if given, is then looked
+     * up or built in the background.
+     */
+    void setIndex(std::unique_ptr<OnsetIndex> newIndex, juce::uint32 sourceTag = 0,
+                  const juce::File& overviewSource = {});
+
+    /** Drops the current index and cancels any analysis. */
+    void clear();
+
+    bool isAnalysing() const noexcept { return analysing.load(std::memory_order_relaxed); }
+
+    /** Returns the current index's saved-state chunk, or an empty block. Not for the audio thread. */
+    juce::MemoryBlock getIndexData() const;
+
+    /** The current source's overview, or nullptr while it is being built. Not for the audio thread. */
+    std::shared_ptr<const WaveformOverview> getOverview() const;
+
+    //==============================================================================
+    /**
+     * Gives the audio thread the current index, or nullptr while none is ready or one is
+     * being swapped, for the lifetime of the scope. Wait-free.
+     */
+    class ScopedIndex
+    {
+    public:
+        explicit ScopedIndex(const OnsetAnalyser& ownerToUse) noexcept;
+        ~ScopedIndex();
+
+        const OnsetIndex* get() const noexcept { return index; }
+
+        /** The tag the index was published with; 0 while there is no index. */
+        juce::uint32 getSourceTag() const noexcept { return sourceTag; }
+
+    private:
+        const OnsetAnalyser& owner;
+        const OnsetIndex* index = nullptr;
+        juce::uint32 sourceTag = 0;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedIndex)
+    };
+
+private:
+    //==============================================================================
+    void run() override;
+
+    void publish(std::unique_ptr<OnsetIndex> newIndex, juce::uint32 newTag);
+    void publishOverview(std::shared_ptr<const WaveformOverview> newOverview);
+
+    struct Analysis
+    {
+        std::unique_ptr<OnsetIndex> index;
+        std::shared_ptr<const WaveformOverview> overview;
+    };
+
+    Analysis findOrAnalyse(const juce::File& file, juce::AudioFormatManager& formatManager,
+                           const std::function<bool()>& isStale) const;
+
+    //==============================================================================
+    const std::unique_ptr<AnalysisCache> cache;   // Only used by the analysis thread
+
+    std::unique_ptr<OnsetIndex> index;
+    juce::uint32 indexTag = 0;
+    mutable std::atomic<int> activeReads { 0 };
+    std::atomic<bool> swapPending { false };
+
+    // Requests are handed to the thread under requestLock; requestGeneration aborts stale work
+    juce::CriticalSection requestLock;
+    juce::File requestedFile;
+    juce::uint32 requestedTag = 0;
+    bool requestedOverviewOnly = false;   // The index came from saved state
+    std::atomic<juce::uint32> requestGeneration { 0 };
+    std::atomic<bool> analysing { false };
+
+    juce::CriticalSection publishLock;   // Serialises writers of index; readers never take it
+
+    std::shared_ptr<const WaveformOverview> overview;
+    juce::CriticalSection overviewLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OnsetAnalyser)
+};
@@ -0,0 +1,252 @@
+#include "OnsetIndex.h"
+
+#include <juce_dsp/juce_dsp.h>
+
+#include <algorithm>
+#include <cmath>
+
+//==============================================================================
+namespace
+{
+    /** Picks the frames whose flux peaks above the adaptive threshold. */
+    std::vector<juce::int64> pickOnsets(const std::vector<float>& flux, double sampleRate)
+    {
+        std::vector<juce::int64> onsets;
+
+        if (flux.empty())
+            return onsets;
+
+        const auto numFrames = static_cast<int>(flux.size());
+        double totalFlux = 0.0;
+
+        for (auto value : flux)
+            totalFlux += value;
+
+        const auto fluxFloor = static_cast<float>(totalFlux / numFrames) * OnsetIndex::minimumFluxFraction;
+        const auto minimumGap = static_cast<juce::int64>(OnsetIndex::minimumGapSeconds * sampleRate);
+
+        // Running sum over the threshold window, moved one frame at a time
+        double windowSum = 0.0;
+        int windowStart = 0, windowEnd = 0;
+
+        for (int frame = 0; frame < numFrames; ++frame)
+        {
+            const auto first = std::max(0, frame - OnsetIndex::thresholdRadius);
+            const auto last = std::min(numFrames, frame + OnsetIndex::thresholdRadius + 1);
+
+            for (; windowEnd < last; ++windowEnd)
+                windowSum += flux[static_cast<size_t>(windowEnd)];
+
+            for (; windowStart < first; ++windowStart)
+                windowSum -= flux[static_cast<size_t>(windowStart)];
+
+            const auto value = flux[static_cast<size_t>(frame)];
+            const auto localMean = static_cast<float>(windowSum / (last - first));
+
+            if (value <= fluxFloor || value <= localMean * OnsetIndex::thresholdRatio)
+                continue;
+
+            auto isPeak = true;
+
+            for (int other = std::max(0, frame - OnsetIndex::peakRadius);
+                 other <= std::min(numFrames - 1, frame + OnsetIndex::peakRadius) && isPeak; ++other)
+                isPeak = other == frame || flux[static_cast<size_t>(other)] < value
+                                        || (other > frame && flux[static_cast<size_t>(other)] == value);
+
+            if (! isPeak)
+                continue;
+
+            const auto position = static_cast<juce::int64>(frame) * OnsetIndex::hopSize;
+
+            if (onsets.empty() || position - onsets.back() >= minimumGap)
+                onsets.push_back(position);
+        }
+
+        return onsets;
+    }
+}
+
+//==============================================================================
+OnsetIndex::SourceIdentity OnsetIndex::SourceIdentity::of(const juce::File& file)
+{
+    SourceIdentity identity;
+    identity.path = file.getFullPathName();
+    identity.fileSize = file.getSize();
+    identity.modificationTime = file.getLastModificationTime().toMilliseconds();
+    return identity;
+}
+
+bool OnsetIndex::SourceIdentity::operator==(const SourceIdentity& other) const noexcept
+{
+    return path == other.path && fileSize == other.fileSize && modificationTime == other.modificationTime;
+}
+
+//==============================================================================
+OnsetIndex::OnsetIndex(std::vector<juce::int64> sortedOnsets, juce::int64 lengthInSamplesToUse, SourceIdentity identityToUse)
+    : onsets(std::move(sortedOnsets)), lengthInSamples(lengthInSamplesToUse), identity(std::move(identityToUse))
+{
+    jassert(std::is_sorted(onsets.begin(), onsets.end()));
+}
+
+std::unique_ptr<OnsetIndex> OnsetIndex::analyse(juce::AudioFormatReader& reader, SourceIdentity identity,
+                                                const std::function<bool()>& shouldAbort,
+                                                WaveformOverview::Builder* overview)
+{
+    if (reader.numChannels == 0 || reader.lengthInSamples <= 0)
+        return std::make_unique<OnsetIndex>(std::vector<juce::int64>(), 0, std::move(identity));
+
+    juce::dsp::FFT fft(fftOrder);
+    juce::dsp::WindowingFunction<float> window(static_cast<size_t>(fftSize), juce::dsp::WindowingFunction<float>::hann, false);
+
+    constexpr int numBins = fftSize / 2 + 1;
+    constexpr int readBlockSize = hopSize * 64;
+
+    const auto numChannels = std::min(2, static_cast<int>(reader.numChannels));
+    juce::AudioBuffer<float> readBuffer(numChannels, readBlockSize);
+
+    std::vector<float> spectrum(static_cast<size_t>(fftSize * 2), 0.0f);
+    std::vector<float> previousMagnitudes(static_cast<size_t>(numBins), 0.0f);
+    std::vector<float> flux;
+    flux.reserve(static_cast<size_t>(reader.lengthInSamples / hopSize + 1));
+
+    // The newest fftSize mono samples, as a ring; a frame is taken every hopSize of them
+    std::vector<float> history(static_cast<size_t>(fftSize), 0.0f);
+    int historyIndex = 0;
+    int samplesUntilFrame = hopSize;
+
+    for (juce::int64 position = 0; position < reader.lengthInSamples; position += readBlockSize)
+    {
+        if (shouldAbort && shouldAbort())
+            return nullptr;
+
+        const auto numToRead = static_cast<int>(std::min<juce::int64>(readBlockSize, reader.lengthInSamples - position));
+        reader.read(&readBuffer, 0, numToRead, position, true, numChannels > 1);
+
+        for (int i = 0; i < numToRead; ++i)
+        {
+            auto sample = readBuffer.getSample(0, i);
+
+            if (numChannels > 1)
+                sample = 0.5f * (sample + readBuffer.getSample(1, i));
+
+            if (overview != nullptr)
+                overview->addSample(sample);
+
+            history[static_cast<size_t>(historyIndex)] = sample;
+            historyIndex = (historyIndex + 1) % fftSize;
+
+            if (--samplesUntilFrame > 0)
+                continue;
+
+            samplesUntilFrame = hopSize;
+
+            // Unwrap the ring, oldest sample first
+            std::copy(history.begin() + historyIndex, history.end(), spectrum.begin());
+            std::copy(history.begin(), history.begin() + historyIndex, spectrum.begin() + (fftSize - historyIndex));
+            std::fill(spectrum.begin() + fftSize, spectrum.end(), 0.0f);
+
+            window.multiplyWithWindowingTable(spectrum.data(), static_cast<size_t>(fftSize));
+            fft.performFrequencyOnlyForwardTransform(spectrum.data(), true);
+
+            // Log-compressed magnitudes make the flux follow loudness changes, not absolute level
+            float frameFlux = 0.0f;
+
+            for (int bin = 0; bin < numBins; ++bin)
+            {
+                const auto magnitude = std::log1p(10.0f * spectrum[static_cast<size_t>(bin)]);
+                frameFlux += std::max(0.0f, magnitude - previousMagnitudes[static_cast<size_t>(bin)]);
+                previousMagnitudes[static_cast<size_t>(bin)] = magnitude;
+            }
+
+            flux.push_back(frameFlux);
+        }
+    }
+
+    // Frame n ends at sample (n + 1) * hopSize; its flux peaks as a transient reaches the
+    // middle of the window, so the onset is placed a hop ahead of that to keep the attack
+    auto onsets = pickOnsets(flux, reader.sampleRate > 0.0 ? reader.sampleRate : 44100.0);
+
+    for (auto& onset : onsets)
+        onset = std::max<juce::int64>(0, onset + hopSize - fftSize / 2 - hopSize);
+
+    return std::make_unique<OnsetIndex>(std::move(onsets), reader.lengthInSamples, std::move(identity));
+}
+
+//==============================================================================
+juce::int64 OnsetIndex::findNearest(juce::int64 position) const noexcept
+{
+    if (onsets.empty())
+        return -1;
+
+    const auto next = std::lower_bound(onsets.begin(), onsets.end(), position);
+
+    if (next == onsets.begin())
+        return *next;
+
+    if (next == onsets.end())
+        return onsets.back();
+
+    const auto previous = *(next - 1);
+    return position - previous <= *next - position ? previous : *next;
+}
+
+//==============================================================================
+juce::MemoryBlock OnsetIndex::toCacheData() const
+{
+    juce::MemoryOutputStream stream;
+    stream.writeInt64(lengthInSamples);
+
+    for (auto onset : onsets)
+        stream.writeInt64(onset);
+
+    return stream.getMemoryBlock();
+}
+
+std::unique_ptr<OnsetIndex> OnsetIndex::fromCacheData(const void* data, size_t size, SourceIdentity identity)
+{
+    if (data == nullptr || size < sizeof(juce::int64) || size % sizeof(juce::int64) != 0)
+        return nullptr;
+
+    const auto* values = static_cast<const char*>(data);
+    const auto length = static_cast<juce::int64>(juce::ByteOrder::littleEndianInt64(values));
+    std::vector<juce::int64> onsets(size / sizeof(juce::int64) - 1);
+
+    for (size_t i = 0; i < onsets.size(); ++i)
+    {
+        onsets[i] = static_cast<juce::int64>(juce::ByteOrder::littleEndianInt64(values + (i + 1) * sizeof(juce::int64)));
+
+        if (onsets[i] < 0 || onsets[i] > length || (i > 0 && onsets[i] < onsets[i - 1]))
+            return nullptr;
+    }
+
+    return std::make_unique<OnsetIndex>(std::move(onsets), length, std::move(identity));
+}
+
+juce::MemoryBlock OnsetIndex::toStateData() const
+{
+    juce::MemoryOutputStream stream;
+    stream.writeString(identity.path);
+    stream.writeInt64(identity.fileSize);
+    stream.writeInt64(identity.modificationTime);
+    stream << toCacheData();
+    return stream.getMemoryBlock();
+}
+
+std::unique_ptr<OnsetIndex> OnsetIndex::fromStateData(const void* data, size_t size, const SourceIdentity& expected)
+{
+    if (data == nullptr)
+        return nullptr;
+
+    juce::MemoryInputStream stream(data, size, false);
+
+    SourceIdentity identity;
+    identity.path = stream.readString();
+    identity.fileSize = stream.readInt64();
+    identity.modificationTime = stream.readInt64();
+
+    if (identity != expected || stream.isExhausted())
+        return nullptr;
+
+    const auto position = static_cast<size_t>(stream.getPosition());
+    return fromCacheData(static_cast<const char*>(data) + position, size - position, identity);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include "WaveformOverview.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * OnsetIndex - Sorted transient positions of one source file, for grains that cut on onsets
+ * analyse() makes one offline pass over the file: spectral flux between Hann-windowed FFT
+ * frames, picked where it peaks above an adaptive threshold, with a minimum gap between
+ * onsets. The result is a plain sorted array, so finding the onset nearest to a position is
+ * a binary search the audio thread can afford per grain. Indices are immutable once built and
+ * are saved with the session, so reopening it restores them instead of analysing again.
+ */
+class OnsetIndex
+{
+public:
+    //==============================================================================
+    static constexpr int fftOrder = 10;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int hopSize = fftSize / 2;
+    static constexpr int thresholdRadius = 16;        // Frames either side averaged for the adaptive threshold
+    static constexpr int peakRadius = 3;              // Frames either side a peak must exceed
+    static constexpr float thresholdRatio = 1.5f;     // Flux must exceed the local mean by this factor
+    static constexpr float minimumFluxFraction = 0.1f; // ... and this share of the mean flux of the whole file
+    static constexpr double minimumGapSeconds = 0.05;
+
+    /** What an index was built from, to tell whether it still describes a file. */
+    struct SourceIdentity
+    {
+        juce::String path;
+        juce::int64 fileSize = 0;
+        juce::int64 modificationTime = 0;
+
+        static SourceIdentity of(const juce::File& file);
+
+        bool operator==(const SourceIdentity& other) const noexcept;
+        bool operator!=(const SourceIdentity& other) const noexcept { return ! operator==(other); }
+    };
+
+    //==============================================================================
+    OnsetIndex(std::vector<juce::int64> sortedOnsets, juce::int64 lengthInSamples, SourceIdentity identity);
+
+    /**
+     * Analyses every sample the reader provides, mixing the first two channels to mono.
+     * Returns nullptr if shouldAbort returns true, which is polled between reads. If given,
+     * overview is fed the same mono samples, so the file is only decoded once for both.
+     */
+    static std::unique_ptr<OnsetIndex> analyse(juce::AudioFormatReader& reader, SourceIdentity identity,
+                                               const std::function<bool()>& shouldAbort = {},
+                                               WaveformOverview::Builder* overview = nullptr);
+
+    //==============================================================================
+    int getNumOnsets() const noexcept { return static_cast<int>(onsets.size()); }
+    juce::int64 getOnset(int index) const noexcept { return onsets[static_cast<size_t>(index)]; }
+    juce::int64 getLengthInSamples() const noexcept { return lengthInSamples; }
+    const SourceIdentity& getSourceIdentity() const noexcept { return identity; }
+
+    /** Returns the onset closest to position, or -1 if there are none. O(log n), real-time safe. */
+    juce::int64 findNearest(juce::int64 position) const noexcept;
+
+    //==============================================================================
+    /** The AnalysisCache section: the source length followed by the onsets, as little-endian int64s. */
+    juce::MemoryBlock toCacheData() const;
+
+    /** Returns nullptr if the data is not a valid section. */
+    static std::unique_ptr<OnsetIndex> fromCacheData(const void* data, size_t size, SourceIdentity identity);
+
+    /** The saved-state chunk: the source identity followed by the cache section. */
+    juce::MemoryBlock toStateData() const;
+
+    /**
+     * Returns nullptr if the data is not a valid chunk or was built from anything but
+     * expected; the onsets are only decoded once the identity matches.
+     */
+    static std::unique_ptr<OnsetIndex> fromStateData(const void* data, size_t size, const SourceIdentity& expected);
+
+private:
+    //==============================================================================
+    std::vector<juce::int64> onsets;
+    juce::int64 lengthInSamples = 0;
+    SourceIdentity identity;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OnsetIndex)
+};
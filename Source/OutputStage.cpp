@@ -0,0 +1,148 @@
+#include "OutputStage.h"
+
+#include <cmath>
+
+//==============================================================================
+std::pair<float, float> OutputStage::getPanGains(float pan) noexcept
+{
+    const auto angle = (juce::jlimit(-1.0f, 1.0f, pan) + 1.0f) * juce::MathConstants<float>::pi * 0.25f;
+    const auto normalise = juce::MathConstants<float>::sqrt2;
+
+    return { normalise * std::cos(angle), normalise * std::sin(angle) };
+}
+
+void OutputStage::prepare(double sampleRate, int maxBlockSize, const Targets& initialTargets, int newNumChannels)
+{
+    jassert(newNumChannels > 0 && newNumChannels <= GrainSpatialiser::maxChannels);
+    numChannels = juce::jlimit(1, GrainSpatialiser::maxChannels, newNumChannels);
+
+    for (auto* smoother : { &dryLeftGain, &dryRightGain, &wetLeftGain, &wetRightGain, &width, &wetGain })
+        smoother->reset(sampleRate, smoothingTimeSeconds);
+
+    for (auto& smoother : dryChannelGains)
+        smoother.reset(sampleRate, smoothingTimeSeconds);
+
+    // Kept when the block size shrinks, so re-preparing for a smaller buffer costs nothing
+    for (auto* buffer : { &mid, &side, &ramp, &wetMixed, &dryCopy, &wetRamp })
+        buffer->ensureSize(maxBlockSize);
+
+    applyTargets(initialTargets, true);
+}
+
+void OutputStage::release() noexcept
+{
+    for (auto* buffer : { &mid, &side, &ramp, &wetMixed, &dryCopy, &wetRamp })
+        buffer->free();
+}
+
+void OutputStage::setTargets(const Targets& newTargets) noexcept
+{
+    applyTargets(newTargets, false);
+}
+
+void OutputStage::applyTargets(const Targets& newTargets, bool snap) noexcept
+{
+    const auto panGains = getPanGains(newTargets.pan);
+    const auto mix = juce::jlimit(0.0f, 1.0f, newTargets.mix);
+
+    setSmoother(dryLeftGain, newTargets.gain * panGains.first * (1.0f - mix), snap);
+    setSmoother(dryRightGain, newTargets.gain * panGains.second * (1.0f - mix), snap);
+    setSmoother(wetLeftGain, newTargets.gain * panGains.first * mix, snap);
+    setSmoother(wetRightGain, newTargets.gain * panGains.second * mix, snap);
+    setSmoother(width, newTargets.width, snap);
+
+    setSmoother(wetGain, newTargets.gain * mix, snap);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        setSmoother(dryChannelGains[static_cast<size_t>(channel)],
+                    newTargets.gain * (1.0f - mix) * newTargets.dryPlacement[static_cast<size_t>(channel)], snap);
+}
+
+void OutputStage::setSmoother(Smoother& smoother, float value, bool snap) noexcept
+{
+    if (snap)
+        smoother.setCurrentAndTargetValue(value);
+    else
+        smoother.setTargetValue(value);
+}
+
+//==============================================================================
+void OutputStage::process(const float* dryLeft, const float* dryRight, const float* wetLeft, const float* wetRight,
+                          float* outLeft, float* outRight, int numSamples) noexcept
+{
+    jassert(numSamples <= ramp.size());
+    jassert(dryLeft != outRight);
+
+    using FVO = juce::FloatVectorOperations;
+
+    // Mid/side of the grain cloud, with the side scaled by the width
+    FVO::add(mid.get(), wetLeft, wetRight, numSamples);
+    FVO::multiply(mid.get(), 0.5f, numSamples);
+    FVO::subtract(side.get(), wetLeft, wetRight, numSamples);
+    FVO::multiply(side.get(), 0.5f, numSamples);
+    applySmoothed(width, side.get(), side.get(), numSamples, false);
+
+    // The right channel goes first so that a mono dry signal can still be read when it aliases the left output
+    FVO::subtract(wetMixed.get(), mid.get(), side.get(), numSamples);
+    applySmoothed(dryRightGain, outRight, dryRight, numSamples, false);
+    applySmoothed(wetRightGain, outRight, wetMixed.get(), numSamples, true);
+
+    FVO::add(wetMixed.get(), mid.get(), side.get(), numSamples);
+    applySmoothed(dryLeftGain, outLeft, dryLeft, numSamples, false);
+    applySmoothed(wetLeftGain, outLeft, wetMixed.get(), numSamples, true);
+}
+
+void OutputStage::process(const float* dry, const float* const* wet, float* const* outputs, int numSamples) noexcept
+{
+    jassert(numSamples <= ramp.size());
+
+    using FVO = juce::FloatVectorOperations;
+
+    // The first output written may be the dry signal itself
+    FVO::copy(dryCopy.get(), dry, numSamples);
+
+    // Every channel shares the wet gain, so its ramp is worked out once
+    const auto wetSmoothing = wetGain.isSmoothing();
+
+    if (wetSmoothing)
+        for (int i = 0; i < numSamples; ++i)
+            wetRamp[i] = wetGain.getNextValue();
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        applySmoothed(dryChannelGains[static_cast<size_t>(channel)], outputs[channel], dryCopy.get(), numSamples, false);
+
+        if (wetSmoothing)
+            FVO::addWithMultiply(outputs[channel], wet[channel], wetRamp.get(), numSamples);
+        else
+            FVO::addWithMultiply(outputs[channel], wet[channel], wetGain.getTargetValue(), numSamples);
+    }
+}
+
+void OutputStage::applySmoothed(Smoother& smoother, float* dest, const float* source,
+                                int numSamples, bool accumulate) noexcept
+{
+    using FVO = juce::FloatVectorOperations;
+
+    if (! smoother.isSmoothing())
+    {
+        const auto value = smoother.getTargetValue();
+
+        if (accumulate)
+            FVO::addWithMultiply(dest, source, value, numSamples);
+        else
+            FVO::copyWithMultiply(dest, source, value, numSamples);
+
+        return;
+    }
+
+    auto* gains = ramp.get();
+
+    for (int i = 0; i < numSamples; ++i)
+        gains[i] = smoother.getNextValue();
+
+    if (accumulate)
+        FVO::addWithMultiply(dest, source, gains, numSamples);
+    else
+        FVO::multiply(dest, source, gains, numSamples);
+}
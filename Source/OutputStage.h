@@ -0,0 +1,92 @@
+#pragma once
+
+#include "AlignedBuffer.h"
+#include "GrainSpatialiser.h"
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <utility>
+
+/**
+ * OutputStage - Mixes the dry input with the grain cloud into the output channels
+ * Gain, mix and pan are smoothed with juce::SmoothedValue so automation never zippers; the
+ * targets are set once per block and all mixing goes through juce::FloatVectorOperations.
+ * In stereo, pan uses an equal-power law normalised to unity at the centre, and width scales
+ * the side signal of the grain cloud. Other layouts take the cloud's channels as they are,
+ * at the wet gain, and the mono dry signal through a per-channel placement the pan chose.
+ */
+class OutputStage
+{
+public:
+    //==============================================================================
+    struct Targets
+    {
+        float gain = 0.5f;
+        float mix = 0.0f;      // 0 = dry only, 1 = grain cloud only
+        float pan = 0.0f;      // -1 = hard left, 1 = hard right
+        float width = 1.0f;    // 0 = mono cloud, 1 = unchanged, 2 = doubled side signal
+
+        // Layouts other than stereo: the share of the dry signal each output channel gets
+        GrainSpatialiser::Gains dryPlacement {};
+    };
+
+    static constexpr double smoothingTimeSeconds = 0.02;
+
+    //==============================================================================
+    OutputStage() = default;
+
+    /** Allocates the ramp buffers for numChannels outputs and jumps straight to the given targets. */
+    void prepare(double sampleRate, int maxBlockSize, const Targets& initialTargets, int numChannels = 2);
+
+    /** Frees the ramp buffers until the next prepare(). Must not be called from the audio thread. */
+    void release() noexcept;
+
+    /** Sets the values to ramp towards over the following blocks. */
+    void setTargets(const Targets& newTargets) noexcept;
+
+    /**
+     * Writes a stereo dry signal and the wet one into outLeft/outRight. dryLeft may alias
+     * outLeft, and dryRight either output. numSamples must not exceed the block size passed
+     * to prepare().
+     */
+    void process(const float* dryLeft, const float* dryRight, const float* wetLeft, const float* wetRight,
+                 float* outLeft, float* outRight, int numSamples) noexcept;
+
+    /** Writes a mono dry signal, which may alias outLeft or outRight, and the wet one into outLeft/outRight. */
+    void process(const float* dry, const float* wetLeft, const float* wetRight,
+                 float* outLeft, float* outRight, int numSamples) noexcept
+    {
+        process(dry, dry, wetLeft, wetRight, outLeft, outRight, numSamples);
+    }
+
+    /**
+     * Writes the mono dry signal and the wet channels into the outputs, one of each for the
+     * numChannels passed to prepare(), for layouts other than stereo. dry may alias any output.
+     */
+    void process(const float* dry, const float* const* wet, float* const* outputs, int numSamples) noexcept;
+
+    /** Returns the equal-power left and right pan gains, both 1 at the centre. */
+    static std::pair<float, float> getPanGains(float pan) noexcept;
+
+private:
+    //==============================================================================
+    using Smoother = juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear>;
+
+    /** Applies the smoother to dest, as a single scalar when it has settled. */
+    void applySmoothed(Smoother& smoother, float* dest, const float* source, int numSamples, bool accumulate) noexcept;
+
+    static void setSmoother(Smoother& smoother, float value, bool snap) noexcept;
+    void applyTargets(const Targets& newTargets, bool snap) noexcept;
+
+    //==============================================================================
+    Smoother dryLeftGain, dryRightGain, wetLeftGain, wetRightGain, width;
+    AlignedBuffer<float> mid, side, ramp, wetMixed;
+
+    // Layouts other than stereo
+    int numChannels = 2;
+    std::array<Smoother, GrainSpatialiser::maxChannels> dryChannelGains;
+    Smoother wetGain;
+    AlignedBuffer<float> dryCopy, wetRamp;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OutputStage)
+};
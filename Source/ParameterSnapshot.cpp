@@ -0,0 +1,80 @@
+#include "ParameterSnapshot.h"
+
+//==============================================================================
+const char* ParameterSnapshot::getParameterID(Parameter parameter) noexcept
+{
+    switch (parameter)
+    {
+        case gain:          return "gain";
+        case mix:           return "mix";
+        case pan:           return "pan";
+        case width:         return "width";
+        case density:       return "density";
+        case grainSize:     return "grainSize";
+        case position:      return "position";
+        case spray:         return "spray";
+        case pitch:         return "pitch";
+        case envelope:      return "envelope";
+        case quality:       return "quality";
+        case multiCore:     return "multiCore";
+        case onsetSnap:     return "onsetSnap";
+        case mode:          return "mode";
+        case freeze:        return "freeze";
+        case smear:         return "smear";
+        case shuffle:       return "shuffle";
+        case filter:        return "filter";
+        case cutoff:        return "cutoff";
+        case resonance:     return "resonance";
+        case crushBits:     return "crushBits";
+        case downsample:    return "downsample";
+        case numParameters: break;
+    }
+
+    jassertfalse;
+    return "";
+}
+
+void ParameterSnapshot::attach(juce::AudioProcessorValueTreeState& state)
+{
+    for (int i = 0; i < numParameters; ++i)
+    {
+        rawValues[static_cast<size_t>(i)] = state.getRawParameterValue(getParameterID(static_cast<Parameter>(i)));
+        ranges[static_cast<size_t>(i)] = state.getParameterRange(getParameterID(static_cast<Parameter>(i)));
+
+        // Every snapshot slot needs a matching parameter in the layout
+        jassert(rawValues[static_cast<size_t>(i)] != nullptr);
+    }
+
+    markAllDirty();
+    update();
+}
+
+void ParameterSnapshot::update() noexcept
+{
+    DirtyMask changed = 0;
+
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        const auto value = rawValues[i] != nullptr ? rawValues[i]->load(std::memory_order_relaxed) : lastRawValues[i];
+
+        // A value set by setNormalised() stays until the parameter itself moves
+        if (value == lastRawValues[i] && ! forceDirty)
+            continue;
+
+        if (value != values[i])
+            changed |= DirtyMask(1) << i;
+
+        values[i] = value;
+        lastRawValues[i] = value;
+    }
+
+    dirty = forceDirty ? ~DirtyMask(0) : changed;
+    forceDirty = false;
+}
+
+void ParameterSnapshot::setNormalised(Parameter parameter, float normalisedValue) noexcept
+{
+    const auto& range = ranges[static_cast<size_t>(parameter)];
+    values[static_cast<size_t>(parameter)] = range.snapToLegalValue(range.convertFrom0to1(juce::jlimit(0.0f, 1.0f, normalisedValue)));
+    dirty = maskOf(parameter);
+}
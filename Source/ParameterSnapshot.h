@@ -0,0 +1,94 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <array>
+#include <atomic>
+
+/**
+ * ParameterSnapshot - One block's copy of every plugin parameter, read from the APVTS raw values
+ * update() performs exactly one atomic load per parameter and records which values changed
+ * since the previous block, so the engine only recomputes coefficients whose inputs moved.
+ * Within a block, setNormalised() can move a value at an exact sample, e.g. from a MIDI
+ * controller; it holds until the host or editor next changes that parameter.
+ */
+class ParameterSnapshot
+{
+public:
+    //==============================================================================
+    enum Parameter
+    {
+        gain,
+        mix,
+        pan,
+        width,
+        density,
+        grainSize,
+        position,
+        spray,
+        pitch,
+        envelope,
+        quality,
+        multiCore,
+        onsetSnap,
+        mode,
+        freeze,
+        smear,
+        shuffle,
+        filter,
+        cutoff,
+        resonance,
+        crushBits,
+        downsample,
+        numParameters
+    };
+
+    using DirtyMask = juce::uint64;
+    static_assert(numParameters <= 64, "DirtyMask holds one bit per parameter");
+
+    /** Returns the APVTS parameter ID for a snapshot slot. */
+    static const char* getParameterID(Parameter parameter) noexcept;
+
+    static constexpr DirtyMask maskOf(Parameter parameter) noexcept { return DirtyMask(1) << parameter; }
+
+    template <typename... Others>
+    static constexpr DirtyMask maskOf(Parameter first, Others... others) noexcept
+    {
+        return maskOf(first) | maskOf(others...);
+    }
+
+    //==============================================================================
+    ParameterSnapshot() = default;
+
+    /** Resolves the raw value pointer of every parameter. Call once after the APVTS is built. */
+    void attach(juce::AudioProcessorValueTreeState& state);
+
+    /** Loads every raw value once and works out which ones changed since the last update. */
+    void update() noexcept;
+
+    /**
+     * Sets one value from 0 to 1 across the parameter's range, leaving only that parameter
+     * dirty. The APVTS is left alone, so nothing is sent to the host from the audio thread.
+     */
+    void setNormalised(Parameter parameter, float normalisedValue) noexcept;
+
+    /** Forces every parameter to report as changed on the next update, e.g. after prepareToPlay. */
+    void markAllDirty() noexcept { forceDirty = true; }
+
+    //==============================================================================
+    float operator[](Parameter parameter) const noexcept { return values[static_cast<size_t>(parameter)]; }
+
+    bool isDirty(Parameter parameter) const noexcept { return (dirty & maskOf(parameter)) != 0; }
+    bool isAnyDirty(DirtyMask mask) const noexcept { return (dirty & mask) != 0; }
+    DirtyMask getDirtyMask() const noexcept { return dirty; }
+
+private:
+    //==============================================================================
+    std::array<std::atomic<float>*, numParameters> rawValues {};
+    std::array<juce::NormalisableRange<float>, numParameters> ranges;
+    std::array<float, numParameters> values {}, lastRawValues {};
+    DirtyMask dirty = ~DirtyMask(0);
+    bool forceDirty = true;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParameterSnapshot)
+};
@@ -0,0 +1,106 @@
+#include "PerformanceMonitor.h"
+
+//==============================================================================
+void PerformanceMonitor::prepare(double newSampleRate) noexcept
+{
+    jassert(newSampleRate > 0.0);
+    sampleRate = newSampleRate;
+    clear();
+}
+
+void PerformanceMonitor::endBlock(juce::int64 startTicks, int numSamples, int numActiveGrains,
+                                  juce::uint32 totalCacheMisses, juce::uint32 totalRenderTimeouts) noexcept
+{
+    const auto elapsedTicks = juce::Time::getHighResolutionTicks() - startTicks;
+    recordBlock(juce::Time::highResolutionTicksToSeconds(elapsedTicks), numSamples, numActiveGrains,
+                totalCacheMisses, totalRenderTimeouts);
+}
+
+void PerformanceMonitor::recordBlock(double elapsedSeconds, int numSamples, int numActiveGrains,
+                                     juce::uint32 totalCacheMisses, juce::uint32 totalRenderTimeouts) noexcept
+{
+    if (resetRequested.exchange(false, std::memory_order_relaxed))
+        clear();
+
+    if (! baselinesValid)
+    {
+        cacheMissBaseline = totalCacheMisses;
+        renderTimeoutBaseline = totalRenderTimeouts;
+        baselinesValid = true;
+    }
+
+    if (numSamples <= 0)
+        return;
+
+    const auto budgetSeconds = static_cast<double>(numSamples) / sampleRate;
+    const auto load = static_cast<float>(elapsedSeconds / budgetSeconds);
+    const auto blockIndex = numBlocks.load(std::memory_order_relaxed);
+
+    // Only the audio thread writes, so plain loads and stores are enough to update each value
+    lastLoad.store(load, std::memory_order_relaxed);
+    peakLoad.store(juce::jmax(peakLoad.load(std::memory_order_relaxed), load), std::memory_order_relaxed);
+
+    const auto average = averageLoad.load(std::memory_order_relaxed);
+    averageLoad.store(blockIndex == 0 ? load : average + averagingCoefficient * (load - average), std::memory_order_relaxed);
+
+    if (load > 1.0f)
+        numOverruns.store(numOverruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    auto& bucket = histogram[static_cast<size_t>(getBucket(load))];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    activeGrains.store(numActiveGrains, std::memory_order_relaxed);
+    peakActiveGrains.store(juce::jmax(peakActiveGrains.load(std::memory_order_relaxed), numActiveGrains),
+                           std::memory_order_relaxed);
+
+    cacheMisses.store(totalCacheMisses - cacheMissBaseline, std::memory_order_relaxed);
+    renderTimeouts.store(totalRenderTimeouts - renderTimeoutBaseline, std::memory_order_relaxed);
+
+    // Published last, so a reader that sees the new count also sees the rest of the block
+    numBlocks.store(blockIndex + 1, std::memory_order_release);
+}
+
+//==============================================================================
+PerformanceMonitor::Statistics PerformanceMonitor::getStatistics() const noexcept
+{
+    // Values may straddle two blocks, which is harmless for a display
+    Statistics statistics;
+    statistics.numBlocks = numBlocks.load(std::memory_order_acquire);
+    statistics.numOverruns = numOverruns.load(std::memory_order_relaxed);
+    statistics.lastLoad = lastLoad.load(std::memory_order_relaxed);
+    statistics.averageLoad = averageLoad.load(std::memory_order_relaxed);
+    statistics.peakLoad = peakLoad.load(std::memory_order_relaxed);
+    statistics.activeGrains = activeGrains.load(std::memory_order_relaxed);
+    statistics.peakActiveGrains = peakActiveGrains.load(std::memory_order_relaxed);
+    statistics.cacheMisses = cacheMisses.load(std::memory_order_relaxed);
+    statistics.renderTimeouts = renderTimeouts.load(std::memory_order_relaxed);
+
+    for (int i = 0; i < numBuckets; ++i)
+        statistics.histogram[static_cast<size_t>(i)] = histogram[static_cast<size_t>(i)].load(std::memory_order_relaxed);
+
+    return statistics;
+}
+
+//==============================================================================
+void PerformanceMonitor::clear() noexcept
+{
+    baselinesValid = false;
+
+    numBlocks.store(0, std::memory_order_relaxed);
+    numOverruns.store(0, std::memory_order_relaxed);
+    lastLoad.store(0.0f, std::memory_order_relaxed);
+    averageLoad.store(0.0f, std::memory_order_relaxed);
+    peakLoad.store(0.0f, std::memory_order_relaxed);
+    activeGrains.store(0, std::memory_order_relaxed);
+    peakActiveGrains.store(0, std::memory_order_relaxed);
+    cacheMisses.store(0, std::memory_order_relaxed);
+    renderTimeouts.store(0, std::memory_order_relaxed);
+
+    for (auto& bucket : histogram)
+        bucket.store(0, std::memory_order_relaxed);
+}
+
+int PerformanceMonitor::getBucket(float load) noexcept
+{
+    return juce::jlimit(0, numBuckets - 1, static_cast<int>(load / bucketWidth));
+}
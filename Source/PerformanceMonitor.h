@@ -0,0 +1,87 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+#include <atomic>
+
+/**
+ * PerformanceMonitor - Deadline telemetry for the audio thread
+ * processBlock reads the high-resolution clock before and after its work and records how much
+ * of the block's real-time budget (numSamples / sampleRate) it used. Loads go into a fixed
+ * histogram alongside the grain count and the source cache misses, all in relaxed atomics
+ * written only by the audio thread, so any thread can read them without locking. A reader
+ * can request a reset, which the audio thread carries out at the end of its next block.
+ */
+class PerformanceMonitor
+{
+public:
+    //==============================================================================
+    static constexpr int numBuckets = 24;
+    static constexpr float bucketWidth = 0.05f;   // Share of the budget per bucket; the last one is open-ended
+    static constexpr float averagingCoefficient = 0.05f;
+
+    /** A copy of the telemetry as of the last recorded block. */
+    struct Statistics
+    {
+        juce::uint32 numBlocks = 0;
+        juce::uint32 numOverruns = 0;        // Blocks that took longer than their budget
+        float lastLoad = 0.0f;               // 1 = the whole budget
+        float averageLoad = 0.0f;
+        float peakLoad = 0.0f;
+        int activeGrains = 0;
+        int peakActiveGrains = 0;
+        juce::uint32 cacheMisses = 0;        // Source cache misses since the last reset
+        juce::uint32 renderTimeouts = 0;     // Render worker deadline misses since the last reset
+        std::array<juce::uint32, numBuckets> histogram {};
+
+        /** Returns the lower bound of the bucket's load range. */
+        static float getBucketLoad(int bucket) noexcept { return bucketWidth * static_cast<float>(bucket); }
+    };
+
+    //==============================================================================
+    PerformanceMonitor() = default;
+
+    /** Sets the rate that block budgets are derived from and clears the statistics. */
+    void prepare(double sampleRate) noexcept;
+
+    /** Returns the clock value to pass to endBlock(). */
+    static juce::int64 beginBlock() noexcept { return juce::Time::getHighResolutionTicks(); }
+
+    /** Records a block processed since startTicks. The counters are cumulative totals. */
+    void endBlock(juce::int64 startTicks, int numSamples, int activeGrains,
+                  juce::uint32 totalCacheMisses, juce::uint32 totalRenderTimeouts) noexcept;
+
+    /** Records a block that took elapsedSeconds; endBlock() measures and forwards here. */
+    void recordBlock(double elapsedSeconds, int numSamples, int activeGrains,
+                     juce::uint32 totalCacheMisses, juce::uint32 totalRenderTimeouts) noexcept;
+
+    //==============================================================================
+    /** Safe from any thread. */
+    Statistics getStatistics() const noexcept;
+
+    /** Asks the audio thread to clear the statistics after its next block. Safe from any thread. */
+    void requestReset() noexcept { resetRequested.store(true, std::memory_order_relaxed); }
+
+private:
+    //==============================================================================
+    void clear() noexcept;
+
+    static int getBucket(float load) noexcept;
+
+    //==============================================================================
+    double sampleRate = 44100.0;
+    std::atomic<bool> resetRequested { false };
+
+    // Baselines for the cumulative counters, so statistics count from the last reset
+    juce::uint32 cacheMissBaseline = 0, renderTimeoutBaseline = 0;
+    bool baselinesValid = false;
+
+    std::atomic<juce::uint32> numBlocks { 0 }, numOverruns { 0 };
+    std::atomic<float> lastLoad { 0.0f }, averageLoad { 0.0f }, peakLoad { 0.0f };
+    std::atomic<int> activeGrains { 0 }, peakActiveGrains { 0 };
+    std::atomic<juce::uint32> cacheMisses { 0 }, renderTimeouts { 0 };
+    std::array<std::atomic<juce::uint32>, numBuckets> histogram {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PerformanceMonitor)
+};
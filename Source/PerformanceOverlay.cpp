@@ -0,0 +1,100 @@
+#include "PerformanceOverlay.h"
+
+#include <algorithm>
+#include <cmath>
+
+//==============================================================================
+PerformanceOverlay::PerformanceOverlay(GranularPlunderphonicsAudioProcessor& processorToUse)
+    : audioProcessor(processorToUse)
+{
+    setInterceptsMouseClicks(true, false);
+}
+
+PerformanceOverlay::~PerformanceOverlay()
+{
+    stopTimer();
+}
+
+//==============================================================================
+void PerformanceOverlay::paint(juce::Graphics& g)
+{
+    auto area = getLocalBounds().toFloat();
+
+    g.setColour(juce::Colours::black.withAlpha(0.8f));
+    g.fillRoundedRectangle(area, 6.0f);
+
+    area.reduce(10.0f, 8.0f);
+
+    const auto percent = [](float load) { return juce::String(load * 100.0f, 1) + "%"; };
+
+    const juce::StringArray lines {
+        "Block load: " + percent(statistics.lastLoad) + "  avg " + percent(statistics.averageLoad)
+            + "  peak " + percent(statistics.peakLoad),
+        "Overruns: " + juce::String(statistics.numOverruns) + " of " + juce::String(statistics.numBlocks) + " blocks",
+        "Grains: " + juce::String(statistics.activeGrains) + "  peak " + juce::String(statistics.peakActiveGrains),
+        "Cache misses: " + juce::String(statistics.cacheMisses)
+            + "  Worker timeouts: " + juce::String(statistics.renderTimeouts)
+    };
+
+    g.setColour(juce::Colours::white);
+    g.setFont(12.0f);
+
+    for (const auto& line : lines)
+        g.drawText(line, area.removeFromTop(16.0f), juce::Justification::centredLeft, true);
+
+    paintHistogram(g, area.withTrimmedTop(6.0f));
+}
+
+void PerformanceOverlay::paintHistogram(juce::Graphics& g, juce::Rectangle<float> area) const
+{
+    const auto maxCount = std::max<juce::uint32>(1, *std::max_element(statistics.histogram.begin(),
+                                                                      statistics.histogram.end()));
+    const auto barWidth = area.getWidth() / static_cast<float>(PerformanceMonitor::numBuckets);
+
+    for (int i = 0; i < PerformanceMonitor::numBuckets; ++i)
+    {
+        const auto count = statistics.histogram[static_cast<size_t>(i)];
+
+        if (count == 0)
+            continue;
+
+        // Square-root scale so that rare overruns stay visible next to the common case
+        const auto height = area.getHeight() * std::sqrt(static_cast<float>(count) / static_cast<float>(maxCount));
+        const auto overrun = PerformanceMonitor::Statistics::getBucketLoad(i) >= 1.0f;
+
+        g.setColour(overrun ? juce::Colours::red : juce::Colours::limegreen);
+        g.fillRect(area.getX() + barWidth * static_cast<float>(i), area.getBottom() - height,
+                   juce::jmax(1.0f, barWidth - 1.0f), height);
+    }
+
+    // The deadline
+    const auto deadlineX = area.getX() + area.getWidth() / (PerformanceMonitor::bucketWidth * PerformanceMonitor::numBuckets);
+    g.setColour(juce::Colours::white.withAlpha(0.6f));
+    g.drawVerticalLine(juce::roundToInt(deadlineX), area.getY(), area.getBottom());
+}
+
+void PerformanceOverlay::mouseUp(const juce::MouseEvent&)
+{
+    audioProcessor.resetPerformanceStatistics();
+}
+
+void PerformanceOverlay::visibilityChanged()
+{
+    // Only poll while the overlay is shown
+    if (isVisible())
+    {
+        timerCallback();
+        startTimerHz(refreshRateHz);
+    }
+    else
+    {
+        stopTimer();
+    }
+}
+
+//==============================================================================
+void PerformanceOverlay::timerCallback()
+{
+    statistics = audioProcessor.getPerformanceStatistics();
+    repaint();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "PluginProcessor.h"
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+/**
+ * PerformanceOverlay - Optional editor overlay showing the audio thread telemetry
+ * Polls the processor's PerformanceMonitor statistics a few times a second and draws the
+ * current, average and peak block load together with the load histogram, buckets past the
+ * deadline in red, plus the grain count, cache misses and render worker timeouts.
+ * Clicking the overlay resets the statistics.
+ */
+class PerformanceOverlay : public juce::Component,
+                           private juce::Timer
+{
+public:
+    static constexpr int refreshRateHz = 10;
+
+    explicit PerformanceOverlay(GranularPlunderphonicsAudioProcessor& processorToUse);
+    ~PerformanceOverlay() override;
+
+    //==============================================================================
+    void paint(juce::Graphics&) override;
+    void mouseUp(const juce::MouseEvent&) override;
+
+    void visibilityChanged() override;
+
+private:
+    //==============================================================================
+    void timerCallback() override;
+
+    void paintHistogram(juce::Graphics&, juce::Rectangle<float> area) const;
+
+    //==============================================================================
+    GranularPlunderphonicsAudioProcessor& audioProcessor;
+    PerformanceMonitor::Statistics statistics;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PerformanceOverlay)
+};
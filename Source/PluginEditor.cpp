@@ -4,7 +4,7 @@
 //==============================================================================
 GranularPlunderphonicsAudioProcessorEditor::GranularPlunderphonicsAudioProcessorEditor(
     GranularPlunderphonicsAudioProcessor& p, juce::AudioProcessorValueTreeState& vts)
-    : AudioProcessorEditor(&p), audioProcessor(p)
+    : AudioProcessorEditor(&p), audioProcessor(p), waveformDisplay(p), performanceOverlay(p)
 {
     // Set up gain slider
     gainSlider.setSliderStyle(juce::Slider::RotaryVerticalDrag);
@@ -17,13 +17,24 @@ GranularPlunderphonicsAudioProcessorEditor::GranularPlunderphonicsAudioProcessor
     gainLabel.setJustificationType(juce::Justification::centred);
     addAndMakeVisible(gainLabel);
 
+    // Set up source loading
+    loadSourceButton.onClick = [this] { chooseSourceFile(); };
+    addAndMakeVisible(loadSourceButton);
+    addAndMakeVisible(waveformDisplay);
+
+    // Set up the performance overlay toggle
+    performanceButton.setClickingTogglesState(true);
+    performanceButton.onClick = [this] { performanceOverlay.setVisible(performanceButton.getToggleState()); };
+    addAndMakeVisible(performanceButton);
+    addChildComponent(performanceOverlay);
+
     // Create parameter attachment
     gainAttachment.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(
         vts, "gain", gainSlider));
 
     // Make sure that before the constructor returns, you've set the
     // editor's size to whatever you need it to be.
-    setSize(400, 300);
+    setSize(400, 480);
 }
 
 GranularPlunderphonicsAudioProcessorEditor::~GranularPlunderphonicsAudioProcessorEditor()
@@ -45,8 +56,14 @@ void GranularPlunderphonicsAudioProcessorEditor::paint(juce::Graphics& g)
     // Draw title
     g.drawFittedText("Granular Plunderphonics", getLocalBounds(), juce::Justification::centredTop, 1);
     
-    // Draw version info
+    // Draw the current grain source
+    auto sourceFile = audioProcessor.getSourceFile();
     g.setFont(12.0f);
+    g.drawFittedText(sourceFile == juce::File() ? "Source: live input" : "Source: " + sourceFile.getFileName(),
+                     getLocalBounds().removeFromBottom(44).removeFromTop(20),
+                     juce::Justification::centred, 1);
+
+    // Draw version info
     g.drawFittedText("v0.1.0 - Audio Pass-through", 
                      getLocalBounds().removeFromBottom(20),
                      juce::Justification::centredBottom, 1);
@@ -57,11 +74,39 @@ void GranularPlunderphonicsAudioProcessorEditor::resized()
     // Position the slider and label
     auto area = getLocalBounds();
     auto topSection = area.removeFromTop(40); // Space for title
+    performanceButton.setBounds(topSection.removeFromRight(50).reduced(8));
     
+    // Source button above the source name and version info
+    auto bottomSection = area.removeFromBottom(70);
+    loadSourceButton.setBounds(bottomSection.removeFromTop(26).withSizeKeepingCentre(140, 26));
+
+    // The source waveform and read window sit just above it
+    waveformDisplay.setBounds(area.removeFromBottom(80).reduced(20, 4));
+
     // Center the gain control
     auto sliderArea = area.reduced(50).removeFromTop(200);
     gainSlider.setBounds(sliderArea);
     
     // Position the label above the slider
     gainLabel.setBounds(sliderArea.removeFromTop(20));
+
+    // The overlay floats over the controls when shown
+    performanceOverlay.setBounds(area.reduced(20, 10));
+}
+
+void GranularPlunderphonicsAudioProcessorEditor::chooseSourceFile()
+{
+    sourceChooser = std::make_unique<juce::FileChooser>("Choose a source recording",
+                                                        audioProcessor.getSourceFile(),
+                                                        "*.wav;*.wave;*.aif;*.aiff;*.flac;*.mp3;*.ogg");
+
+    auto flags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles;
+
+    sourceChooser->launchAsync(flags, [this](const juce::FileChooser& chooser)
+    {
+        auto file = chooser.getResult();
+
+        if (file != juce::File() && audioProcessor.loadSource(file))
+            repaint();
+    });
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "PerformanceOverlay.h"
 #include "PluginProcessor.h"
+#include "WaveformDisplay.h"
 
 /**
  * GranularPlunderphonicsAudioProcessorEditor - GUI editor for the Granular Plunderphonics VST3 plugin
@@ -17,12 +19,22 @@ public:
     void resized() override;
 
 private:
+    //==============================================================================
+    void chooseSourceFile();
+
     //==============================================================================
     GranularPlunderphonicsAudioProcessor& audioProcessor;
     
     // UI Components
     juce::Slider gainSlider;
     juce::Label gainLabel;
+    juce::TextButton loadSourceButton { "Load Source..." };
+    std::unique_ptr<juce::FileChooser> sourceChooser;
+    WaveformDisplay waveformDisplay;
+
+    // Audio thread telemetry, hidden until toggled on
+    juce::TextButton performanceButton { "CPU" };
+    PerformanceOverlay performanceOverlay;
     
     // Parameter attachment
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> gainAttachment;
@@ -6,12 +6,17 @@ GranularPlunderphonicsAudioProcessor::GranularPlunderphonicsAudioProcessor()
     : AudioProcessor(BusesProperties()
                      .withInput("Input", juce::AudioChannelSet::mono(), true)
                      .withOutput("Output", juce::AudioChannelSet::stereo(), true)),
-      parameters(*this, nullptr, "Parameters", {
-          std::make_unique<juce::AudioParameterFloat>("gain", "Gain", 0.0f, 1.0f, 0.5f)
-      })
+      onsetAnalyser(std::make_unique<AnalysisCache>(AnalysisCache::getDefaultDirectory())),
+      parameters(*this, nullptr, "Parameters", createParameterLayout())
 {
     gainParameter = dynamic_cast<juce::AudioParameterFloat*>(parameters.getParameter("gain"));
     jassert(gainParameter != nullptr);
+
+    // The audio thread reads every parameter through one snapshot per block
+    parameterSnapshot.attach(parameters);
+
+    // A new instance gets a seed of its own, which its sessions then keep
+    setRandomSeed(juce::Random::getSystemRandom().nextInt64());
 }
 
 GranularPlunderphonicsAudioProcessor::~GranularPlunderphonicsAudioProcessor()
@@ -19,6 +24,315 @@ GranularPlunderphonicsAudioProcessor::~GranularPlunderphonicsAudioProcessor()
     // Resource cleanup happens automatically through JUCE smart pointers
 }
 
+juce::AudioProcessorValueTreeState::ParameterLayout GranularPlunderphonicsAudioProcessor::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>("gain", "Gain", 0.0f, 1.0f, 0.5f));
+
+    // Dry/wet balance - fully dry by default so the plugin starts as a pass-through
+    layout.add(std::make_unique<juce::AudioParameterFloat>("mix", "Mix", 0.0f, 1.0f, 0.0f));
+
+    // Equal-power output pan and stereo width of the grain cloud
+    layout.add(std::make_unique<juce::AudioParameterFloat>("pan", "Pan", -1.0f, 1.0f, 0.0f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("width", "Width", 0.0f, 2.0f, 1.0f));
+
+    // Grain cloud
+    layout.add(std::make_unique<juce::AudioParameterFloat>("density", "Density",
+        juce::NormalisableRange<float>(0.1f, maxGrainDensity, 0.0f, 0.3f), 20.0f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("grainSize", "Grain Size",
+        juce::NormalisableRange<float>(5.0f, GrainScheduler::maxGrainSizeMs, 0.0f, 0.4f), 100.0f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("position", "Position", 0.0f, 1.0f, 1.0f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("spray", "Spray", 0.0f, 1.0f, 0.1f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("pitch", "Pitch",
+        -GrainScheduler::maxPitchSemitones, GrainScheduler::maxPitchSemitones, 0.0f));
+
+    // Grain window, in GrainEnvelopeShape order
+    layout.add(std::make_unique<juce::AudioParameterChoice>("envelope", "Envelope",
+        juce::StringArray { "Hann", "Tukey", "Gaussian", "Trapezoid" }, 0));
+
+    // Resampling tier, in ResamplerQuality order; offline renders always use the highest one
+    layout.add(std::make_unique<juce::AudioParameterChoice>("quality", "Quality",
+        juce::StringArray { "Linear", "Hermite", "Sinc" }, 1));
+
+    // Render dense clouds on the worker threads as well as the audio thread
+    layout.add(std::make_unique<juce::AudioParameterBool>("multiCore", "Multi-Core", false));
+
+    // Share of grains that start on the nearest transient of a loaded source
+    layout.add(std::make_unique<juce::AudioParameterFloat>("onsetSnap", "Onset Snap", 0.0f, 1.0f, 0.0f));
+
+    // The grain cloud or the spectral engine, crossfaded when switched, and the spectral controls
+    layout.add(std::make_unique<juce::AudioParameterChoice>("mode", "Mode",
+        juce::StringArray { "Granular", "Spectral" }, 0));
+    layout.add(std::make_unique<juce::AudioParameterBool>("freeze", "Freeze", false));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("smear", "Smear", 0.0f, 1.0f, 0.0f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("shuffle", "Shuffle", 0.0f, 1.0f, 0.0f));
+
+    // Per-grain filter, in GrainFilterType order, and bit crusher; both start bypassed
+    layout.add(std::make_unique<juce::AudioParameterChoice>("filter", "Filter",
+        juce::StringArray { "Off", "Low-pass", "Band-pass", "High-pass" }, 0));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("cutoff", "Cutoff",
+        juce::NormalisableRange<float>(GrainEffects::minCutoffHz, GrainEffects::maxCutoffHz, 0.0f, 0.25f), 1000.0f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("resonance", "Resonance",
+        juce::NormalisableRange<float>(0.5f, 10.0f, 0.0f, 0.4f), GrainEffects::defaultResonance));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("crushBits", "Crush Bits",
+        juce::NormalisableRange<float>(1.0f, GrainEffects::maxCrushBits, 1.0f), GrainEffects::maxCrushBits));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("downsample", "Downsample",
+        juce::NormalisableRange<float>(1.0f, GrainEffects::maxDownsample, 0.0f, 0.4f), 1.0f));
+
+    return layout;
+}
+
+void GranularPlunderphonicsAudioProcessor::updateEngineSettings() noexcept
+{
+    using Parameter = ParameterSnapshot::Parameter;
+
+    grainSettings.density = parameterSnapshot[Parameter::density];
+    grainSettings.grainSizeMs = parameterSnapshot[Parameter::grainSize];
+    grainSettings.position = parameterSnapshot[Parameter::position];
+    grainSettings.spray = parameterSnapshot[Parameter::spray];
+
+    // Choice parameters store their index as the raw value
+    if (parameterSnapshot.isDirty(Parameter::envelope))
+        grainSettings.envelopeShape = static_cast<GrainEnvelopeShape>(juce::roundToInt(parameterSnapshot[Parameter::envelope]));
+
+    // Host bounces have no deadline, so they get the band-limited tier whatever the parameter says
+    grainSettings.resamplerQuality = isNonRealtime() ? ResamplerQuality::sinc
+                                                     : static_cast<ResamplerQuality>(juce::roundToInt(parameterSnapshot[Parameter::quality]));
+
+    grainSettings.multiThreaded = batchMode || parameterSnapshot[Parameter::multiCore] >= 0.5f;
+    grainSettings.batch = batchMode;
+    grainSettings.onsetSnap = parameterSnapshot[Parameter::onsetSnap];
+
+    if (parameterSnapshot.isDirty(Parameter::filter))
+        grainSettings.effects.filterType = static_cast<GrainFilterType>(juce::roundToInt(parameterSnapshot[Parameter::filter]));
+
+    grainSettings.effects.cutoffHz = parameterSnapshot[Parameter::cutoff];
+    grainSettings.effects.resonance = parameterSnapshot[Parameter::resonance];
+    grainSettings.effects.crushBits = parameterSnapshot[Parameter::crushBits];
+    grainSettings.effects.downsample = parameterSnapshot[Parameter::downsample];
+
+    spectralSettings.position = grainSettings.position;
+    spectralSettings.spray = grainSettings.spray;
+    spectralSettings.freeze = parameterSnapshot[Parameter::freeze] >= 0.5f;
+    spectralSettings.smear = parameterSnapshot[Parameter::smear];
+    spectralSettings.shuffle = parameterSnapshot[Parameter::shuffle];
+    spectralMix.setTargetValue(parameterSnapshot[Parameter::mode] >= 0.5f ? 1.0f : 0.0f);
+
+    // The playback rates need std::pow, so they only follow pitch and source changes
+    const auto sourceRateRatio = static_cast<float>(getSourceSampleRate(sourceLoader.getCurrent()) / currentSampleRate);
+    const auto fadingRateRatio = static_cast<float>(getSourceSampleRate(sourceLoader.getFading()) / currentSampleRate);
+
+    if (parameterSnapshot.isDirty(Parameter::pitch) || sourceRateRatio != grainSourceRateRatio)
+    {
+        grainSettings.playbackRate = GrainScheduler::getPlaybackRate(parameterSnapshot[Parameter::pitch], sourceRateRatio);
+        grainSourceRateRatio = sourceRateRatio;
+        voiceAllocator.updatePlaybackRates([this](int note) { return getNotePlaybackRate(note); });
+    }
+
+    if (parameterSnapshot.isDirty(Parameter::pitch) || fadingRateRatio != grainFadingRateRatio)
+    {
+        grainSettings.fadingPlaybackRate = GrainScheduler::getPlaybackRate(parameterSnapshot[Parameter::pitch], fadingRateRatio);
+        grainFadingRateRatio = fadingRateRatio;
+    }
+
+    // New targets recompute the pan law, so they are only pushed when an output parameter moved
+    if (parameterSnapshot.isAnyDirty(ParameterSnapshot::maskOf(Parameter::gain, Parameter::mix,
+                                                               Parameter::pan, Parameter::width)))
+        outputStage.setTargets(getOutputTargets());
+}
+
+void GranularPlunderphonicsAudioProcessor::handleEvent(const BlockEventQueue::Event& event) noexcept
+{
+    using Parameter = ParameterSnapshot::Parameter;
+
+    if (event.type == BlockEventQueue::Event::Type::noteOn)
+    {
+        // The spectral engine has no grains to play, and a muted grain engine must not start voices
+        if (isGranularAudible())
+            voiceAllocator.noteOn(event.number, event.value, getNotePlaybackRate(event.number));
+
+        return;
+    }
+
+    if (event.type == BlockEventQueue::Event::Type::noteOff)
+    {
+        voiceAllocator.noteOff(event.number);
+        return;
+    }
+
+    const auto parameter = getControllerParameter(event.number);
+
+    if (parameter >= 0)
+    {
+        parameterSnapshot.setNormalised(static_cast<Parameter>(parameter), event.value);
+        updateEngineSettings();
+    }
+}
+
+float GranularPlunderphonicsAudioProcessor::getNotePlaybackRate(int note) const noexcept
+{
+    // Notes transpose by their distance from untransposedNote, on top of the pitch parameter
+    const auto semitones = parameterSnapshot[ParameterSnapshot::pitch] + static_cast<float>(note - untransposedNote);
+    return GrainScheduler::getPlaybackRate(semitones, grainSourceRateRatio);
+}
+
+bool GranularPlunderphonicsAudioProcessor::isGranularAudible() const noexcept
+{
+    return spectralMix.getCurrentValue() < 1.0f || spectralMix.getTargetValue() < 1.0f;
+}
+
+bool GranularPlunderphonicsAudioProcessor::isSpectralAudible() const noexcept
+{
+    return spectralMix.getCurrentValue() > 0.0f || spectralMix.getTargetValue() > 0.0f;
+}
+
+void GranularPlunderphonicsAudioProcessor::renderWet(const GrainSource& source, int numSamples) noexcept
+{
+    auto* const* wet = wetBuffer.getArrayOfWritePointers();
+    const auto numChannels = wetBuffer.getNumChannels();
+    wetBuffer.clear(0, numSamples);
+
+    // Only an engine that is heard, or fading in, runs. One that has faded out is reset once,
+    // so it comes back clean and keeps no grains over a source that may be released meanwhile
+    const auto runGranular = isGranularAudible();
+    const auto runSpectral = isSpectralAudible();
+
+    if (runGranular)
+    {
+        // The note voices and the free-running cloud share one budget, thinned alike when it runs out
+        auto cloudSettings = grainSettings;
+        cloudSettings.density *= voiceAllocator.process(grainSettings, source, grainScheduler, maxGrainDensity, numSamples);
+        grainScheduler.process(cloudSettings, source, wet, numSamples);
+    }
+    else if (granularActive)
+    {
+        grainScheduler.reset();
+        voiceAllocator.reset();
+    }
+
+    if (! runSpectral && spectralActive)
+        spectralEngine.reset();
+
+    granularActive = runGranular;
+    spectralActive = runSpectral;
+
+    if (! runSpectral)
+        return;
+
+    // The spectral engine's output is mono, written to both channels, and spectralPlacement
+    // spreads it over the output layout
+    auto* spectral = spectralBuffer.getWritePointer(0);
+    auto* spectralRamp = spectralBuffer.getWritePointer(1);
+    spectralBuffer.clear(0, numSamples);
+    spectralEngine.process(spectralSettings, source, spectral, spectralRamp, numSamples);
+
+    // Outside a switch only one engine runs, and the spectral one replaces the silent grain output
+    if (! runGranular)
+    {
+        for (int channel = 0; channel < numChannels; ++channel)
+            juce::FloatVectorOperations::multiply(wet[channel], spectral, spectralPlacement[static_cast<size_t>(channel)], numSamples);
+
+        return;
+    }
+
+    // The second channel only repeats the first, so it holds the crossfade ramp every channel follows
+    for (int i = 0; i < numSamples; ++i)
+        spectralRamp[i] = spectralMix.getNextValue();
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const auto placement = spectralPlacement[static_cast<size_t>(channel)];
+        auto* wetChannel = wet[channel];
+
+        for (int i = 0; i < numSamples; ++i)
+            wetChannel[i] += spectralRamp[i] * (placement * spectral[i] - wetChannel[i]);
+    }
+}
+
+OutputStage::Targets GranularPlunderphonicsAudioProcessor::getOutputTargets() const noexcept
+{
+    using Parameter = ParameterSnapshot::Parameter;
+
+    OutputStage::Targets targets;
+    targets.gain = parameterSnapshot[Parameter::gain];
+    targets.mix = parameterSnapshot[Parameter::mix];
+    targets.pan = parameterSnapshot[Parameter::pan];
+    targets.width = parameterSnapshot[Parameter::width];
+
+    // Outside stereo the pan places the mono dry signal like a grain heading that way
+    const auto& spatialiser = grainScheduler.getSpatialiser();
+
+    if (! spatialiser.isStereo())
+        spatialiser.computeGainsForAzimuth(spatialiser.getPanAzimuth(targets.pan), 1.0f, targets.dryPlacement.data());
+
+    return targets;
+}
+
+//==============================================================================
+bool GranularPlunderphonicsAudioProcessor::loadSource(const juce::File& file)
+{
+    return openSource(file, nullptr);
+}
+
+bool GranularPlunderphonicsAudioProcessor::openSource(const juce::File& file, std::unique_ptr<OnsetIndex> savedOnsets)
+{
+    if (! sourceLoader.canLoad(file))
+        return false;
+
+    // Opening and analysis both run in the background; the tag ties the onsets to this source
+    const auto tag = sourceLoader.load(file);
+
+    if (savedOnsets != nullptr)
+        onsetAnalyser.setIndex(std::move(savedOnsets), tag, file);
+    else
+        onsetAnalyser.analyse(file, tag);
+
+    // Remember the source so it is restored with the session
+    parameters.state.setProperty("sourceFile", file.getFullPathName(), nullptr);
+    return true;
+}
+
+void GranularPlunderphonicsAudioProcessor::clearSource()
+{
+    sourceLoader.clear();
+    onsetAnalyser.clear();
+    parameters.state.removeProperty("sourceFile", nullptr);
+}
+
+juce::File GranularPlunderphonicsAudioProcessor::getSourceFile() const
+{
+    return sourceLoader.getRequestedFile();
+}
+
+//==============================================================================
+void GranularPlunderphonicsAudioProcessor::setRandomSeed(juce::int64 seed)
+{
+    parameters.state.setProperty("seed", seed, nullptr);
+}
+
+juce::int64 GranularPlunderphonicsAudioProcessor::getRandomSeed() const
+{
+    return static_cast<juce::int64>(parameters.state.getProperty("seed"));
+}
+
+const GrainSource& GranularPlunderphonicsAudioProcessor::getGrainSource(const SourceLoader::LoadedSource* loaded) const noexcept
+{
+    // A loaded source file replaces the live input as grain material
+    if (loaded != nullptr && loaded->source != nullptr)
+        return *loaded->source;
+
+    return inputCapture;
+}
+
+double GranularPlunderphonicsAudioProcessor::getSourceSampleRate(const SourceLoader::LoadedSource* loaded) const noexcept
+{
+    if (loaded != nullptr && loaded->source != nullptr)
+        return loaded->sampleRate;
+
+    return currentSampleRate;
+}
+
 //==============================================================================
 const juce::String GranularPlunderphonicsAudioProcessor::getName() const
 {
@@ -27,7 +341,8 @@ const juce::String GranularPlunderphonicsAudioProcessor::getName() const
 
 bool GranularPlunderphonicsAudioProcessor::acceptsMidi() const
 {
-    return false;
+    // Notes play grain cloud voices and controllers move parameters, both at their exact sample
+    return true;
 }
 
 bool GranularPlunderphonicsAudioProcessor::producesMidi() const
@@ -75,35 +390,163 @@ void GranularPlunderphonicsAudioProcessor::changeProgramName(int index, const ju
 //==============================================================================
 void GranularPlunderphonicsAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-    // Use this method as the place to do any pre-playback
-    // initialization that you need..
-    juce::ignoreUnused(sampleRate, samplesPerBlock);
+    currentSampleRate = sampleRate;
+
+    // Offline renders switch the engine to batch mode: it is sized for large blocks, so a host
+    // bouncing with them gets each one rendered in a single pass, and it spreads the grains
+    // over every spare core with no deadline to meet
+    batchMode = isNonRealtime();
+    const auto engineBlockSize = batchMode ? std::max(samplesPerBlock, batchBlockSize) : samplesPerBlock;
+
+    // Bounces in smaller blocks are gathered into batchBlockSize ones, which delays the output by
+    // one batch. The delay is reported as latency for the host to compensate, and only offline:
+    // live playback stays at the host's own block size and reports none
+    batchBuffering = batchMode && samplesPerBlock < batchBlockSize;
+    batchBuffer.setSize(batchBuffering ? std::max(getTotalNumInputChannels(), getTotalNumOutputChannels()) : 0,
+                        batchBuffering ? batchBlockSize : 0, false, true, true);
+    batchBuffer.clear();
+    batchEvents.clear();
+    batchFill = 0;
+    setLatencySamples(batchBuffering ? batchBlockSize : 0);
+    const auto numRenderWorkers = ! batchMode ? GrainRenderPool::getDefaultNumWorkers()
+                                : batchRenderWorkers >= 0 ? batchRenderWorkers
+                                : GrainRenderPool::getBatchNumWorkers();
+
+    // Size the whole grain engine for the worst case so processBlock never allocates. Each part
+    // keeps what it already has room for, so a host re-preparing for a smaller block costs little
+    const auto maxGrainSpan = GrainScheduler::maxGrainSizeMs * 0.001 * GrainScheduler::getMaxPlaybackRate();
+    inputCapture.prepare(static_cast<int>(std::ceil(sampleRate * (inputHistorySeconds + maxGrainSpan))));
+    grainScheduler.prepare(sampleRate, engineBlockSize, maxGrainDensity, numRenderWorkers,
+                           getBusesLayout().getMainOutputChannelSet());
+    voiceAllocator.prepare(sampleRate);
+    wetBuffer.setSize(grainScheduler.getNumOutputChannels(), engineBlockSize, false, false, true);
+    inputDownmix.setSize(1, engineBlockSize, false, false, true);
+    spectralEngine.prepare();
+    spectralBuffer.setSize(2, engineBlockSize, false, false, true);
+
+    // The mono spectral output goes to both stereo channels at full level, and elsewhere to the front
+    const auto& spatialiser = grainScheduler.getSpatialiser();
+    spectralPlacement = {};
+
+    if (spatialiser.isStereo())
+        spectralPlacement[0] = spectralPlacement[1] = 1.0f;
+    else
+        spatialiser.computeGainsForAzimuth(0.0f, 1.0f, spectralPlacement.data());
+
+    // Each engine draws from a stream of its own, so one's draws never shift the other's
+    const auto seed = static_cast<juce::uint64>(getRandomSeed());
+    grainScheduler.setRandomSeed(seed);
+    spectralEngine.setRandomSeed(~seed);
+
+    // Live playback starts on the Hermite fallback while the sinc table builds; a render waits
+    // for it instead, so every block of a bounce is resampled alike
+    if (batchMode)
+        grainScheduler.waitForTables();
+
+    // Preparing silenced every grain, so nothing reads a source that was fading out
+    sourceLoader.prepare(sampleRate, GrainScheduler::maxGrainSizeMs * 0.001);
+    sourceLoader.releaseFadingSource();
+
+    // Start from the current values, then let the first block recompute every derived setting
+    parameterSnapshot.update();
+    outputStage.prepare(sampleRate, engineBlockSize, getOutputTargets(), grainScheduler.getNumOutputChannels());
+    parameterSnapshot.markAllDirty();
+
+    // Both engines were just reset, and the one the mode selects starts at full level
+    spectralMix.reset(sampleRate, modeCrossfadeSeconds);
+    spectralMix.setCurrentAndTargetValue(parameterSnapshot[ParameterSnapshot::mode] >= 0.5f ? 1.0f : 0.0f);
+    granularActive = spectralActive = true;
+
+    performanceMonitor.prepare(sampleRate);
+    grainFeed.prepare(sampleRate);
 }
 
 void GranularPlunderphonicsAudioProcessor::releaseResources()
 {
-    // When playback stops, you can use this as an opportunity to free up any
-    // spare memory, etc.
+    // Give back everything prepareToPlay sized, so a stopped instance in a large session
+    // only keeps its parameters and its (possibly shared) source. The sinc and envelope
+    // tables are shared by every instance and stay with the ones still running.
+    grainScheduler.releaseResources();
+    sourceLoader.releaseFadingSource();
+    inputCapture.release();
+    outputStage.release();
+    spectralEngine.releaseResources();
+    wetBuffer.setSize(0, 0);
+    inputDownmix.setSize(0, 0);
+    batchBuffer.setSize(0, 0);
+    spectralBuffer.setSize(0, 0);
 }
 
 bool GranularPlunderphonicsAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
 {
-    // This plugin supports mono input to stereo output
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
-        return false;
+    // Any input is mixed down to mono for the grains, so only its channel count is limited
+    const auto& input = layouts.getMainInputChannelSet();
 
-    // Input must be mono
-    if (layouts.getMainInputChannelSet() != juce::AudioChannelSet::mono())
+    if (input.isDisabled() || input.size() > GrainSpatialiser::maxChannels)
         return false;
 
-    return true;
+    // Grains can be panned over stereo, surround and ambisonic outputs
+    return GrainSpatialiser::isLayoutSupported(layouts.getMainOutputChannelSet());
 }
 
 void GranularPlunderphonicsAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-    juce::ignoreUnused(midiMessages);
+    // Debug and test builds trap allocation, locking and file access from here on
+    const RealtimeGuard::ScopedRealtimeSection realtimeSection;
 
     juce::ScopedNoDenormals noDenormals;
+    const auto blockStartTicks = PerformanceMonitor::beginBlock();
+
+    if (batchBuffering)
+    {
+        processBatched(buffer, midiMessages);
+    }
+    else
+    {
+        blockEvents.setFromMidi(midiMessages, buffer.getNumSamples());
+        processEngine(buffer, blockEvents);
+    }
+
+    performanceMonitor.endBlock(blockStartTicks, buffer.getNumSamples(), grainScheduler.getNumActiveGrains(),
+                                sourceLoader.getNumCacheMisses(), grainScheduler.getNumRenderTimeouts());
+}
+
+void GranularPlunderphonicsAudioProcessor::processBatched(juce::AudioBuffer<float>& buffer, const juce::MidiBuffer& midiMessages) noexcept
+{
+    // batchBuffer holds the last batch the engine rendered. Each host sample is swapped with the
+    // rendered one at the same position, so the host gets the output one batch late, and once
+    // the batch is full of new input the engine renders it in place in a single pass
+    const auto numChannels = std::min(buffer.getNumChannels(), batchBuffer.getNumChannels());
+    const auto batchSize = batchBuffer.getNumSamples();
+
+    for (int start = 0, numSamples = 0; start < buffer.getNumSamples(); start += numSamples)
+    {
+        numSamples = std::min(buffer.getNumSamples() - start, batchSize - batchFill);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* host = buffer.getWritePointer(channel, start);
+            std::swap_ranges(host, host + numSamples, batchBuffer.getWritePointer(channel, batchFill));
+        }
+
+        batchEvents.appendFromMidi(midiMessages, start, numSamples, batchFill,
+                                   start == 0, start + numSamples == buffer.getNumSamples());
+        batchFill += numSamples;
+
+        if (batchFill == batchSize)
+        {
+            processEngine(batchBuffer, batchEvents);
+            batchEvents.clear();
+            batchFill = 0;
+        }
+    }
+}
+
+void GranularPlunderphonicsAudioProcessor::processEngine(juce::AudioBuffer<float>& buffer, const BlockEventQueue& events) noexcept
+{
+    // Take over a source the loader has finished opening, if there is one
+    sourceLoader.beginBlock(buffer.getNumSamples());
+
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -111,25 +554,95 @@ void GranularPlunderphonicsAudioProcessor::processBlock(juce::AudioBuffer<float>
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear(i, 0, buffer.getNumSamples());
 
-    // Get the gain value from the parameter
-    float gain = gainParameter->get();
-
-    // Simple pass-through implementation (mono->stereo)
-    // Copy the mono input to both stereo channels with gain applied
-    if (totalNumInputChannels == 1 && totalNumOutputChannels == 2) {
-        // Get mono input data
-        auto* monoData = buffer.getReadPointer(0);
-        
-        // Get stereo output channels
-        auto* leftChannel = buffer.getWritePointer(0);
-        auto* rightChannel = buffer.getWritePointer(1);
-        
-        // Copy mono to stereo with gain applied
-        for (int sample = 0; sample < buffer.getNumSamples(); ++sample) {
-            float sampleValue = monoData[sample] * gain;
-            leftChannel[sample] = sampleValue;
-            rightChannel[sample] = sampleValue;
+    // Read the parameters once per block; the output stage ramps towards them per sample
+    parameterSnapshot.update();
+    updateEngineSettings();
+
+    // Granular processing
+    // The input, mixed down to mono, feeds the grain history, and the grain cloud is mixed with the
+    // dry signal. Stereo in to stereo out keeps its dry channels apart; otherwise the dry signal is mono.
+    const auto numOutputs = grainScheduler.getNumOutputChannels();
+
+    if (totalNumInputChannels >= 1 && totalNumOutputChannels == numOutputs && grainScheduler.getMaxBlockSize() > 0) {
+        // Only the first input channel is kept as it is; the others are in the downmix
+        auto* inputData = buffer.getReadPointer(0);
+        auto* downmix = inputDownmix.getWritePointer(0);
+        const auto stereoInOut = totalNumInputChannels == 2 && grainScheduler.getSpatialiser().isStereo();
+
+        auto* const* outputChannels = buffer.getArrayOfWritePointers();
+        std::array<float*, GrainSpatialiser::maxChannels> outputs {};
+
+        const auto* current = sourceLoader.getCurrent();
+        const auto& source = getGrainSource(current);
+
+        grainSettings.fadingSource = sourceLoader.isFading() ? &getGrainSource(sourceLoader.getFading()) : nullptr;
+        grainSettings.crossfade = sourceLoader.getCrossfade();
+
+        // Onsets only steer grains over the source they were found in, never the live input
+        const OnsetAnalyser::ScopedIndex onsets(onsetAnalyser);
+        grainSettings.onsets = current != nullptr && current->source != nullptr && onsets.getSourceTag() == current->tag
+                                 ? onsets.get() : nullptr;
+
+        // The block is split at every MIDI event, and hosts may exceed the prepared block size,
+        // so the engine runs in chunks that end at the next event or at the size it was prepared for
+        const auto chunkSize = grainScheduler.getMaxBlockSize();
+        int nextEvent = 0;
+
+        for (int offset = 0, numSamples = 0; offset < buffer.getNumSamples(); offset += numSamples) {
+            for (; nextEvent < events.size() && events[nextEvent].sampleOffset <= offset; ++nextEvent)
+                handleEvent(events[nextEvent]);
+
+            auto end = std::min(offset + chunkSize, buffer.getNumSamples());
+
+            if (nextEvent < events.size())
+                end = std::min(end, events[nextEvent].sampleOffset);
+
+            numSamples = end - offset;
+
+            // The downmix is taken before any output channel, which may share the input's, is written
+            const auto* mono = inputData + offset;
+
+            if (totalNumInputChannels > 1)
+            {
+                const auto channelGain = 1.0f / static_cast<float>(totalNumInputChannels);
+                juce::FloatVectorOperations::multiply(downmix, inputData + offset, channelGain, numSamples);
+
+                for (int channel = 1; channel < totalNumInputChannels; ++channel)
+                    juce::FloatVectorOperations::addWithMultiply(downmix, buffer.getReadPointer(channel, offset), channelGain, numSamples);
+
+                mono = downmix;
+            }
+
+            inputCapture.write(mono, numSamples);
+
+            renderWet(source, numSamples);
+
+            // Mix dry and wet with gain and pan applied
+            if (stereoInOut)
+            {
+                outputStage.process(inputData + offset, buffer.getReadPointer(1, offset),
+                                    wetBuffer.getReadPointer(0), wetBuffer.getReadPointer(1),
+                                    outputChannels[0] + offset, outputChannels[1] + offset, numSamples);
+            }
+            else if (grainScheduler.getSpatialiser().isStereo())
+            {
+                outputStage.process(mono, wetBuffer.getReadPointer(0), wetBuffer.getReadPointer(1),
+                                    outputChannels[0] + offset, outputChannels[1] + offset, numSamples);
+            }
+            else
+            {
+                for (int channel = 0; channel < numOutputs; ++channel)
+                    outputs[static_cast<size_t>(channel)] = outputChannels[channel] + offset;
+
+                outputStage.process(mono, wetBuffer.getArrayOfReadPointers(), outputs.data(), numSamples);
+            }
         }
+
+        // A snapshot for the editor, at display rate and only while one is reading them
+        grainFeed.publish(buffer.getNumSamples(), [this](GrainVisualFeed::Frame& frame) { grainScheduler.fillVisualFrame(frame); });
+
+        grainSettings.onsets = nullptr;
+        grainSettings.fadingSource = nullptr;
     }
 }
 
@@ -147,21 +660,64 @@ juce::AudioProcessorEditor* GranularPlunderphonicsAudioProcessor::createEditor()
 //==============================================================================
 void GranularPlunderphonicsAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
-    // Save parameters
-    auto state = parameters.copyState();
-    std::unique_ptr<juce::XmlElement> xml(state.createXml());
-    copyXmlToBinary(*xml, destData);
+    // Hosts save often (autosave, undo, duplicating tracks), so this skips XML altogether
+    juce::MemoryOutputStream parameterData;
+    parameters.copyState().writeToStream(parameterData);
+
+    std::vector<PluginState::Chunk> chunks { { PluginState::ChunkType::parameters,
+                                               parameterData.getData(), parameterData.getDataSize() } };
+
+    // The onsets travel with the session, so reopening it does not analyse the source again
+    const auto onsets = onsetAnalyser.getIndexData();
+
+    if (onsets.getSize() > 0)
+        chunks.push_back({ PluginState::ChunkType::onsets, onsets.getData(), onsets.getSize() });
+
+    PluginState::write(chunks, destData);
 }
 
 void GranularPlunderphonicsAudioProcessor::setStateInformation(const void* data, int sizeInBytes)
 {
-    // Restore parameters
-    std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
-    
-    if (xmlState.get() != nullptr && xmlState->hasTagName(parameters.state.getType()))
+    const PluginState saved(data, sizeInBytes > 0 ? static_cast<size_t>(sizeInBytes) : 0);
+    juce::ValueTree state;
+    const PluginState::Chunk* onsetChunk = nullptr;
+
+    if (saved.isValid())
+    {
+        state = saved.readTree(PluginState::ChunkType::parameters);
+        onsetChunk = saved.findChunk(PluginState::ChunkType::onsets);
+    }
+    else if (auto xmlState = getXmlFromBinary(data, sizeInBytes))
     {
-        parameters.replaceState(juce::ValueTree::fromXml(*xmlState));
+        // States saved before the binary format hold only the parameters, as XML
+        state = juce::ValueTree::fromXml(*xmlState);
     }
+
+    if (! state.hasType(parameters.state.getType()))
+        return;
+
+    // Sessions saved before seeds were stored keep this instance's seed from now on
+    if (! state.hasProperty("seed"))
+        state.setProperty("seed", getRandomSeed(), nullptr);
+
+    parameters.replaceState(state);
+
+    // Reopen the source file the session was saved with; this only queues it, so recalling
+    // a session never waits for the disk
+    const auto sourcePath = parameters.state.getProperty("sourceFile").toString();
+    const auto sourceFile = juce::File::isAbsolutePath(sourcePath) ? juce::File(sourcePath) : juce::File();
+
+    // Saved onsets are only reused while the file is unchanged, and only decoded then
+    const auto identity = OnsetIndex::SourceIdentity::of(sourceFile);
+
+    auto savedOnsets = onsetChunk != nullptr ? OnsetIndex::fromStateData(onsetChunk->data, onsetChunk->size, identity)
+                                             : nullptr;
+
+    if (savedOnsets != nullptr && savedOnsets->getSourceIdentity() != identity)
+        savedOnsets = nullptr;
+
+    if (! openSource(sourceFile, std::move(savedOnsets)))
+        clearSource();
 }
 
 //==============================================================================
@@ -3,13 +3,71 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_dsp/juce_dsp.h>
 
+#include "BlockEventQueue.h"
+#include "GrainScheduler.h"
+#include "GrainVoiceAllocator.h"
+#include "InputCaptureBuffer.h"
+#include "OnsetAnalyser.h"
+#include "OutputStage.h"
+#include "ParameterSnapshot.h"
+#include "PerformanceMonitor.h"
+#include "PluginState.h"
+#include "RealtimeGuard.h"
+#include "SourceLoader.h"
+#include "SpectralGrainEngine.h"
+
+#include <array>
+
 /**
  * GranularPlunderphonicsAudioProcessor - Main audio processor class for the Granular Plunderphonics VST3 plugin
- * Currently implements a simple pass-through processor with mono->stereo capability
+ * Granulates either the live input, mixed down to mono, or a loaded source file and mixes the
+ * grain cloud, panned over a stereo, surround or ambisonic output, or the spectral engine's frames,
+ * with the dry signal. Each held MIDI note plays its own grain cloud voice on top of the
+ * free-running one, and MIDI controllers move parameters, both at the exact sample of the event.
  */
 class GranularPlunderphonicsAudioProcessor : public juce::AudioProcessor
 {
 public:
+    //==============================================================================
+    /** Highest density the grain pool is sized for in prepareToPlay, shared by the cloud and every note voice. */
+    static constexpr float maxGrainDensity = 1000.0f;
+
+    /** Seconds of live input history that grains can be scattered over. */
+    static constexpr double inputHistorySeconds = 10.0;
+
+    /**
+     * Samples the engine is sized to render in one pass during offline renders. Smaller offline
+     * host blocks are gathered into blocks of this size, with this much latency reported.
+     */
+    static constexpr int batchBlockSize = 8192;
+
+    /**
+     * The MIDI controller that sets each parameter, in ParameterSnapshot order. CCs 102-119 set
+     * the first 18 and stop where the channel mode messages begin, so the last four carry on at
+     * the undefined CCs 85-88.
+     */
+    static constexpr std::array<int, ParameterSnapshot::numParameters> parameterControllers
+    {
+        102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112,
+        113, 114, 115, 116, 117, 118, 119, 85, 86, 87, 88
+    };
+
+    /** Returns the parameter a MIDI controller sets, or -1 if it sets none. */
+    static constexpr int getControllerParameter(int controller) noexcept
+    {
+        for (size_t parameter = 0; parameter < parameterControllers.size(); ++parameter)
+            if (parameterControllers[parameter] == controller)
+                return static_cast<int>(parameter);
+
+        return -1;
+    }
+
+    /** The MIDI note whose voice plays grains at the pitch parameter's transposition. */
+    static constexpr int untransposedNote = 60;
+
+    /** Seconds the output crossfades over when the mode switches between the two engines. */
+    static constexpr double modeCrossfadeSeconds = 0.02;
+
     //==============================================================================
     GranularPlunderphonicsAudioProcessor();
     ~GranularPlunderphonicsAudioProcessor() override;
@@ -50,13 +108,112 @@ public:
     // Parameter management - just a gain parameter for demonstration
     float getGain() const { return *gainParameter; }
 
+    int getNumActiveGrains() const noexcept { return grainScheduler.getNumActiveGrains(); }
+    int getNumActiveVoices() const noexcept { return voiceAllocator.getNumActiveVoices(); }
+
+    /** The parameter values the last processed block ran with. */
+    const ParameterSnapshot& getParameterSnapshot() const noexcept { return parameterSnapshot; }
+
+    juce::AudioProcessorValueTreeState& getValueTreeState() noexcept { return parameters; }
+
+    /**
+     * The seed behind every random choice the engines make, saved with the session. Each
+     * prepareToPlay restarts the engines' random sequences from it, so a session played from
+     * there with the same input, events and resampling tier renders the same samples again.
+     */
+    void setRandomSeed(juce::int64 seed);
+    juce::int64 getRandomSeed() const;
+
+    /**
+     * Sets how many render workers the next offline prepareToPlay starts, or -1 for one per
+     * spare core. Callers running several offline renders at once pass 0, since each of them
+     * already has a core to itself.
+     */
+    void setBatchRenderWorkers(int numWorkers) noexcept { batchRenderWorkers = numWorkers; }
+
+    //==============================================================================
+    // Audio thread telemetry - safe to read from any thread
+    PerformanceMonitor::Statistics getPerformanceStatistics() const noexcept { return performanceMonitor.getStatistics(); }
+    void resetPerformanceStatistics() noexcept { performanceMonitor.requestReset(); }
+
+    //==============================================================================
+    // Source material - grains read the live input until a source file is loaded.
+    // Loading happens in the background; the engine crossfades to the new source once it is open.
+    bool loadSource(const juce::File& file);
+    void clearSource();
+    juce::File getSourceFile() const;
+
+    /** True while a requested source is still being opened. */
+    bool isLoadingSource() const noexcept { return sourceLoader.isLoading(); }
+
+    /** True while the onsets of a newly loaded source are still being found. */
+    bool isAnalysingSource() const noexcept { return onsetAnalyser.isAnalysing(); }
+
+    /** Snapshots of the active grains for the editor; inactive, and free, until a consumer activates it. */
+    GrainVisualFeed& getGrainFeed() noexcept { return grainFeed; }
+
+    /** The loaded source's peak pyramid for drawing it, or nullptr while there is none. Not for the audio thread. */
+    std::shared_ptr<const WaveformOverview> getWaveformOverview() const { return onsetAnalyser.getOverview(); }
+
 private:
+    //==============================================================================
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+
+    void updateEngineSettings() noexcept;
+    void handleEvent(const BlockEventQueue::Event& event) noexcept;
+    void processEngine(juce::AudioBuffer<float>& buffer, const BlockEventQueue& events) noexcept;
+    void processBatched(juce::AudioBuffer<float>& buffer, const juce::MidiBuffer& midiMessages) noexcept;
+    void renderWet(const GrainSource& source, int numSamples) noexcept;
+    float getNotePlaybackRate(int note) const noexcept;
+    bool isGranularAudible() const noexcept;
+    bool isSpectralAudible() const noexcept;
+    OutputStage::Targets getOutputTargets() const noexcept;
+    bool openSource(const juce::File& file, std::unique_ptr<OnsetIndex> savedOnsets);
+    const GrainSource& getGrainSource(const SourceLoader::LoadedSource* loaded) const noexcept;
+    double getSourceSampleRate(const SourceLoader::LoadedSource* loaded) const noexcept;
+
     //==============================================================================
     // Parameters
     juce::AudioParameterFloat* gainParameter = nullptr;
+    ParameterSnapshot parameterSnapshot;
+
+    // Engine settings derived from the snapshot, recomputed only when their inputs change
+    GrainScheduler::Settings grainSettings;
+    float grainSourceRateRatio = 0.0f, grainFadingRateRatio = 0.0f;
+    bool batchMode = false;   // Prepared for an offline render
+    BlockEventQueue blockEvents;
+
+    // Offline renders in blocks smaller than batchBlockSize, gathered into whole batches
+    bool batchBuffering = false;
+    juce::AudioBuffer<float> batchBuffer;
+    BlockEventQueue batchEvents;
+    int batchFill = 0;
+    int batchRenderWorkers = -1;
+
+    // Granular engine
+    InputCaptureBuffer inputCapture;
+    SourceLoader sourceLoader;
+    OnsetAnalyser onsetAnalyser;
+    GrainScheduler grainScheduler;
+    GrainVoiceAllocator voiceAllocator;
+    juce::AudioBuffer<float> wetBuffer;        // One channel for each output
+    juce::AudioBuffer<float> inputDownmix;     // Multichannel input mixed down for the grains
+
+    // Spectral engine, crossfaded against the grain cloud by spectralMix
+    SpectralGrainEngine spectralEngine;
+    SpectralGrainEngine::Settings spectralSettings;
+    juce::AudioBuffer<float> spectralBuffer;
+    GrainSpatialiser::Gains spectralPlacement {};   // Spreads the mono spectral output over the outputs
+    juce::SmoothedValue<float> spectralMix;
+    bool granularActive = true, spectralActive = true;   // Engines that may hold state to reset
+
+    OutputStage outputStage;
+    PerformanceMonitor performanceMonitor;
+    GrainVisualFeed grainFeed;
 
     // Parameter handling
     juce::AudioProcessorValueTreeState parameters;
+    double currentSampleRate = 44100.0;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GranularPlunderphonicsAudioProcessor)
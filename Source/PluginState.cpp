@@ -0,0 +1,79 @@
+#include "PluginState.h"
+
+#include <limits>
+
+//==============================================================================
+namespace
+{
+    constexpr size_t headerSize = 8;
+    constexpr size_t chunkHeaderSize = 8;
+}
+
+//==============================================================================
+void PluginState::write(const std::vector<Chunk>& chunksToWrite, juce::MemoryBlock& dest)
+{
+    size_t totalSize = headerSize;
+
+    for (const auto& chunk : chunksToWrite)
+        totalSize += chunkHeaderSize + chunk.size;
+
+    // Sized up front, so saving a large state never reallocates on the way
+    juce::MemoryOutputStream stream(dest, false);
+    stream.preallocate(totalSize);
+    stream.writeInt(static_cast<int>(magic));
+    stream.writeInt(currentVersion);
+
+    for (const auto& chunk : chunksToWrite)
+    {
+        jassert(chunk.size <= static_cast<size_t>(std::numeric_limits<juce::uint32>::max()));
+
+        stream.writeInt(static_cast<int>(chunk.type));
+        stream.writeInt(static_cast<int>(chunk.size));
+        stream.write(chunk.data, chunk.size);
+    }
+
+    stream.flush();
+}
+
+PluginState::PluginState(const void* data, size_t size)
+{
+    const auto* bytes = static_cast<const char*>(data);
+
+    if (bytes == nullptr || size < headerSize || juce::ByteOrder::littleEndianInt(bytes) != magic)
+        return;
+
+    version = static_cast<int>(juce::ByteOrder::littleEndianInt(bytes + 4));
+
+    for (size_t offset = headerSize; offset < size;)
+    {
+        if (size - offset < chunkHeaderSize)
+            return;
+
+        const auto type = static_cast<ChunkType>(juce::ByteOrder::littleEndianInt(bytes + offset));
+        const auto length = static_cast<size_t>(juce::ByteOrder::littleEndianInt(bytes + offset + 4));
+        offset += chunkHeaderSize;
+
+        if (length > size - offset)
+            return;
+
+        chunks.push_back({ type, bytes + offset, length });
+        offset += length;
+    }
+
+    valid = version >= 1;
+}
+
+const PluginState::Chunk* PluginState::findChunk(ChunkType type) const noexcept
+{
+    for (const auto& chunk : chunks)
+        if (chunk.type == type)
+            return &chunk;
+
+    return nullptr;
+}
+
+juce::ValueTree PluginState::readTree(ChunkType type) const
+{
+    const auto* chunk = findChunk(type);
+    return chunk != nullptr ? juce::ValueTree::readFromData(chunk->data, chunk->size) : juce::ValueTree();
+}
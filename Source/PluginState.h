@@ -0,0 +1,64 @@
+#pragma once
+
+#include <juce_data_structures/juce_data_structures.h>
+
+#include <vector>
+
+/**
+ * PluginState - Versioned binary container for the plugin's saved state
+ * A state is a short header followed by typed chunks, each a four-character code, a
+ * length and an opaque payload: the parameter tree in ValueTree's binary form, the onset
+ * index, and whatever later versions add. Reading only indexes the chunks in place, so a
+ * payload is neither copied nor decoded until somebody asks for it, and chunks a version
+ * does not know are skipped, so older builds still read what they understand of newer
+ * states. A chunk type's layout never changes; a new layout gets a new type.
+ * States saved before this format are XML; isValid() is false for them, and the
+ * processor falls back to reading them as before.
+ */
+class PluginState
+{
+public:
+    //==============================================================================
+    static constexpr juce::uint32 magic = 0x54535047;   // "GPST"
+    static constexpr int currentVersion = 1;
+
+    /** Chunk identifiers, stored as four-character codes. */
+    enum class ChunkType : juce::uint32
+    {
+        parameters = 0x4d524150,   // "PARM": the APVTS tree, via ValueTree::writeToStream
+        onsets = 0x54534e4f        // "ONST": OnsetIndex::toStateData
+    };
+
+    /** A chunk's payload; when read, it points into the data the state was parsed from. */
+    struct Chunk
+    {
+        ChunkType type;
+        const void* data = nullptr;
+        size_t size = 0;
+    };
+
+    //==============================================================================
+    /** Replaces dest with a header followed by chunks, in order. */
+    static void write(const std::vector<Chunk>& chunks, juce::MemoryBlock& dest);
+
+    /** Indexes the chunks of data, which must outlive this object. Nothing is copied or decoded. */
+    PluginState(const void* data, size_t size);
+
+    /** False for anything but a well-formed binary state, such as the XML of earlier versions. */
+    bool isValid() const noexcept { return valid; }
+    int getVersion() const noexcept { return version; }
+
+    /** Returns the first chunk of the given type, or nullptr if there is none. */
+    const Chunk* findChunk(ChunkType type) const noexcept;
+
+    /** Decodes a chunk written from a ValueTree, or returns an invalid tree. */
+    juce::ValueTree readTree(ChunkType type) const;
+
+private:
+    //==============================================================================
+    std::vector<Chunk> chunks;
+    int version = 0;
+    bool valid = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginState)
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+
+/**
+ * ReadHintRing - Wait-free ring of "about to read this span" hints from the audio thread
+ * Any number of real-time threads may add hints; a single background thread drains them.
+ * When the ring is full the oldest hints are overwritten, since a stale hint is worthless.
+ */
+template <int NumHints>
+class ReadHintRing
+{
+public:
+    ReadHintRing() = default;
+
+    /** Records a hint. Never blocks or allocates. */
+    void add(juce::int64 startSample, juce::int64 numSamples) noexcept
+    {
+        auto& hint = hints[static_cast<size_t>(writeIndex.fetch_add(1, std::memory_order_relaxed) % NumHints)];
+        hint.length.store(numSamples, std::memory_order_relaxed);
+        hint.start.store(std::max<juce::int64>(0, startSample), std::memory_order_release);
+    }
+
+    /** Calls function(startSample, numSamples) for every pending hint and clears it. */
+    template <typename Function>
+    void drain(Function&& function)
+    {
+        for (auto& hint : hints)
+        {
+            const auto start = hint.start.exchange(-1, std::memory_order_acquire);
+
+            if (start >= 0)
+                function(start, hint.length.load(std::memory_order_relaxed));
+        }
+    }
+
+    /** Drops every pending hint. */
+    void clear() noexcept
+    {
+        for (auto& hint : hints)
+            hint.start.store(-1, std::memory_order_relaxed);
+    }
+
+private:
+    struct Hint
+    {
+        std::atomic<juce::int64> start { -1 };
+        std::atomic<juce::int64> length { 0 };
+    };
+
+    std::array<Hint, NumHints> hints;
+    std::atomic<juce::uint32> writeIndex { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE(ReadHintRing)
+};
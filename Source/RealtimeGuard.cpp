@@ -0,0 +1,72 @@
+#include "RealtimeGuard.h"
+
+//==============================================================================
+namespace
+{
+    constexpr auto numViolationKinds = static_cast<size_t>(RealtimeGuard::Violation::numViolations);
+
+    std::array<std::atomic<juce::uint32>, numViolationKinds> violationCounts {};
+    std::atomic<bool> trapOnViolation { true };
+
+   #if GRANULAR_REALTIME_GUARD
+    // Plain integers, so that touching them can never allocate or lock
+    thread_local int realtimeDepth = 0;
+    thread_local int permissionDepth = 0;
+    thread_local bool reportingViolation = false;
+   #endif
+}
+
+//==============================================================================
+#if GRANULAR_REALTIME_GUARD
+void RealtimeGuard::check(Violation violation) noexcept
+{
+    if (realtimeDepth == 0 || permissionDepth > 0 || reportingViolation)
+        return;
+
+    // Reporting may itself allocate (jassert logs a message), which must not report again
+    reportingViolation = true;
+
+    violationCounts[static_cast<size_t>(violation)].fetch_add(1, std::memory_order_relaxed);
+
+    if (trapOnViolation.load(std::memory_order_relaxed))
+        jassertfalse;   // Allocation, locking or file access on the audio thread
+
+    reportingViolation = false;
+}
+
+bool RealtimeGuard::isRealtimeThread() noexcept
+{
+    return realtimeDepth > 0;
+}
+
+void RealtimeGuard::enterSection() noexcept     { ++realtimeDepth; }
+void RealtimeGuard::exitSection() noexcept      { --realtimeDepth; }
+void RealtimeGuard::enterPermission() noexcept  { ++permissionDepth; }
+void RealtimeGuard::exitPermission() noexcept   { --permissionDepth; }
+#endif
+
+juce::uint32 RealtimeGuard::getNumViolations(Violation violation) noexcept
+{
+    return violationCounts[static_cast<size_t>(violation)].load(std::memory_order_relaxed);
+}
+
+juce::uint32 RealtimeGuard::getTotalViolations() noexcept
+{
+    juce::uint32 total = 0;
+
+    for (const auto& count : violationCounts)
+        total += count.load(std::memory_order_relaxed);
+
+    return total;
+}
+
+void RealtimeGuard::resetViolations() noexcept
+{
+    for (auto& count : violationCounts)
+        count.store(0, std::memory_order_relaxed);
+}
+
+void RealtimeGuard::setTrapOnViolation(bool shouldTrap) noexcept
+{
+    trapOnViolation.store(shouldTrap, std::memory_order_relaxed);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+#include <atomic>
+
+#ifndef GRANULAR_REALTIME_GUARD
+ #define GRANULAR_REALTIME_GUARD 0
+#endif
+
+/**
+ * RealtimeGuard - Detects calls that must never happen on the audio thread
+ * processBlock opens a ScopedRealtimeSection, which marks the calling thread as real-time
+ * for its duration. Binaries that want the calls trapped link RealtimeGuardHooks.cpp,
+ * which replaces the global allocation functions, and on glibc also malloc, mutex locking
+ * and file opening, reading and writing, with versions that report to check() first.
+ * Violations are counted per kind and, unless trapping is switched off, also hit a jassert.
+ *
+ * Everything compiles away unless GRANULAR_REALTIME_GUARD is set, which the build does
+ * for Debug configurations and whenever GRANULAR_ENABLE_REALTIME_GUARD is on, on the plugin's
+ * sources and the test binaries only, so a default Release plugin carries none of it.
+ */
+class RealtimeGuard
+{
+public:
+    //==============================================================================
+    enum class Violation
+    {
+        allocation,
+        deallocation,
+        lock,
+        fileAccess,
+        numViolations
+    };
+
+    static constexpr bool isEnabled = GRANULAR_REALTIME_GUARD != 0;
+
+    /** Marks the calling thread as real-time while in scope. Sections can nest. */
+    class ScopedRealtimeSection
+    {
+    public:
+       #if GRANULAR_REALTIME_GUARD
+        ScopedRealtimeSection() noexcept { enterSection(); }
+        ~ScopedRealtimeSection() { exitSection(); }
+       #else
+        ScopedRealtimeSection() noexcept {}
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedRealtimeSection)
+    };
+
+    /** Permits otherwise forbidden calls inside a real-time section, e.g. in a test's own checks. */
+    class ScopedPermission
+    {
+    public:
+       #if GRANULAR_REALTIME_GUARD
+        ScopedPermission() noexcept { enterPermission(); }
+        ~ScopedPermission() { exitPermission(); }
+       #else
+        ScopedPermission() noexcept {}
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedPermission)
+    };
+
+    //==============================================================================
+   #if GRANULAR_REALTIME_GUARD
+    /** Reports a call of the given kind, which is a violation on a thread in a real-time section. */
+    static void check(Violation violation) noexcept;
+
+    static bool isRealtimeThread() noexcept;
+   #else
+    static void check(Violation) noexcept {}
+    static bool isRealtimeThread() noexcept { return false; }
+   #endif
+
+    static juce::uint32 getNumViolations(Violation violation) noexcept;
+    static juce::uint32 getTotalViolations() noexcept;
+    static void resetViolations() noexcept;
+
+    /** With trapping off, violations are only counted; the tests switch it off to assert on the counts. */
+    static void setTrapOnViolation(bool shouldTrap) noexcept;
+
+private:
+    //==============================================================================
+   #if GRANULAR_REALTIME_GUARD
+    static void enterSection() noexcept;
+    static void exitSection() noexcept;
+    static void enterPermission() noexcept;
+    static void exitPermission() noexcept;
+   #endif
+
+    RealtimeGuard() = delete;
+};
@@ -0,0 +1,230 @@
+#include "SampleLibrary.h"
+#include "ReadHintRing.h"
+
+#include <algorithm>
+
+//==============================================================================
+namespace
+{
+    constexpr int readChunkSize = 256;
+    constexpr juce::int64 pageSizeBytes = 4096;
+}
+
+//==============================================================================
+/**
+ * Prefetcher - Touches the mapped pages that grains have announced they are about to read
+ * The audio thread drops hints into a wait-free ring; this thread drains them and reads
+ * one byte per page so the operating system pages the data in ahead of the grains.
+ */
+class SampleLibrary::Prefetcher : public juce::Thread
+{
+public:
+    static constexpr int pollIntervalMs = 2;
+    static constexpr juce::int64 maxFramesPerHint = 1 << 20;
+
+    explicit Prefetcher(const SampleLibrary& ownerToUse)
+        : juce::Thread("Sample page prefetch"), owner(ownerToUse)
+    {
+    }
+
+    ~Prefetcher() override
+    {
+        stopThread(1000);
+    }
+
+    void addHint(juce::int64 startSample, juce::int64 numSamples) noexcept
+    {
+        hints.add(startSample, numSamples);
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            if (auto mapped = owner.getReaderForPrefetch())
+                touchHintedPages(*mapped);
+
+            wait(pollIntervalMs);
+        }
+    }
+
+private:
+    void touchHintedPages(const juce::MemoryMappedAudioFormatReader& mapped)
+    {
+        const auto bytesPerFrame = std::max(1, static_cast<int>(mapped.numChannels) * static_cast<int>(mapped.bitsPerSample) / 8);
+        const auto framesPerPage = std::max<juce::int64>(1, pageSizeBytes / bytesPerFrame);
+
+        hints.drain([&](juce::int64 start, juce::int64 length)
+        {
+            const auto end = std::min(start + std::min(length, maxFramesPerHint), mapped.lengthInSamples);
+
+            for (auto position = start; position < end && ! threadShouldExit(); position += framesPerPage)
+                mapped.touchSample(position);
+
+            if (end > start)
+                mapped.touchSample(end - 1);
+        });
+    }
+
+    const SampleLibrary& owner;
+    ReadHintRing<64> hints;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Prefetcher)
+};
+
+//==============================================================================
+SampleLibrary::SampleLibrary()
+    : prefetcher(std::make_unique<Prefetcher>(*this))
+{
+}
+
+SampleLibrary::~SampleLibrary()
+{
+    // Stop touching pages before the reader goes away
+    prefetcher = nullptr;
+}
+
+bool SampleLibrary::canMapFile(const juce::File& file)
+{
+    return file.existsAsFile() && file.hasFileExtension("wav;wave;aif;aiff");
+}
+
+bool SampleLibrary::loadFile(const juce::File& file)
+{
+    if (! canMapFile(file))
+        return false;
+
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped;
+
+    if (file.hasFileExtension("wav;wave"))
+        mapped.reset(juce::WavAudioFormat().createMemoryMappedReader(file));
+    else
+        mapped.reset(juce::AiffAudioFormat().createMemoryMappedReader(file));
+
+    // Mapping only reserves address space; nothing is read until a page is touched
+    if (mapped == nullptr || mapped->numChannels == 0 || mapped->lengthInSamples <= 0 || ! mapped->mapEntireFile())
+        return false;
+
+    setReader(ReaderPtr(mapped.release()), file);
+
+    if (! prefetcher->isThreadRunning())
+        prefetcher->startThread();
+
+    return true;
+}
+
+void SampleLibrary::unload()
+{
+    prefetcher->stopThread(1000);
+    setReader(nullptr, {});
+}
+
+juce::File SampleLibrary::getLoadedFile() const
+{
+    const juce::ScopedLock scope(prefetchLock);
+    return loadedFile;
+}
+
+void SampleLibrary::setReader(ReaderPtr newReader, const juce::File& newFile)
+{
+    {
+        const juce::ScopedLock prefetchScope(prefetchLock);
+
+        // New reads see the pending swap and return silence; wait for the ones in flight
+        swapPending.store(true);
+
+        while (activeReads.load() != 0)
+            juce::Thread::yield();
+
+        std::swap(reader, newReader);
+        loadedFile = newFile;
+        lengthInSamples.store(reader != nullptr ? reader->lengthInSamples : 0, std::memory_order_release);
+        sourceSampleRate.store(reader != nullptr ? reader->sampleRate : 0.0, std::memory_order_relaxed);
+
+        swapPending.store(false);
+    }
+
+    // The previous reader is unmapped here, outside the lock
+}
+
+SampleLibrary::ReaderPtr SampleLibrary::getReaderForPrefetch() const
+{
+    const juce::ScopedLock scope(prefetchLock);
+    return reader;
+}
+
+//==============================================================================
+juce::Range<juce::int64> SampleLibrary::getReadableRange() const noexcept
+{
+    return { 0, lengthInSamples.load(std::memory_order_acquire) };
+}
+
+void SampleLibrary::readSamples(float* dest, juce::int64 startSample, int numSamples) const noexcept
+{
+    // Registering before checking for a swap pairs with the swap flagging before waiting,
+    // so either this read backs off or the swap waits for it to finish
+    activeReads.fetch_add(1);
+    const juce::ScopeGuard readCompleted { [this] { activeReads.fetch_sub(1); } };
+
+    // Only a source swap blocks reads, and a grain reading silence for one block is inaudible
+    if (swapPending.load() || reader == nullptr)
+    {
+        juce::FloatVectorOperations::clear(dest, numSamples);
+        return;
+    }
+
+    const auto length = reader->lengthInSamples;
+    const auto numChannelsToRead = std::min(2, static_cast<int>(reader->numChannels));
+    const auto isFloatingPoint = reader->usesFloatingPointData;
+
+    int channelData[2][readChunkSize];
+    int* channels[] = { channelData[0], channelData[1] };
+
+    for (int i = 0; i < numSamples;)
+    {
+        const auto position = startSample + i;
+
+        if (position < 0 || position >= length)
+        {
+            const auto gap = position < 0 ? static_cast<int>(std::min<juce::int64>(numSamples - i, -position))
+                                          : numSamples - i;
+            juce::FloatVectorOperations::clear(dest + i, gap);
+            i += gap;
+            continue;
+        }
+
+        const auto chunk = static_cast<int>(std::min<juce::int64>({ static_cast<juce::int64>(readChunkSize),
+                                                                   static_cast<juce::int64>(numSamples - i),
+                                                                   length - position }));
+
+        // Reading from a mapped reader is a conversion copy out of the mapped pages
+        reader->readSamples(channels, numChannelsToRead, 0, position, chunk);
+
+        for (int channel = 0; channel < numChannelsToRead; ++channel)
+        {
+            // Fixed-point data arrives left-aligned in 32 bits; float data arrives as raw bits
+            if (! isFloatingPoint)
+                juce::FloatVectorOperations::convertFixedToFloat(reinterpret_cast<float*>(channels[channel]), channels[channel],
+                                                                 1.0f / static_cast<float>(0x7fffffff), chunk);
+        }
+
+        const auto* first = reinterpret_cast<const float*>(channels[0]);
+
+        if (numChannelsToRead == 1)
+        {
+            juce::FloatVectorOperations::copy(dest + i, first, chunk);
+        }
+        else
+        {
+            juce::FloatVectorOperations::add(dest + i, first, reinterpret_cast<const float*>(channels[1]), chunk);
+            juce::FloatVectorOperations::multiply(dest + i, 0.5f, chunk);
+        }
+
+        i += chunk;
+    }
+}
+
+void SampleLibrary::prefetch(juce::int64 startSample, juce::int64 numSamples) const noexcept
+{
+    prefetcher->addHint(startSample, numSamples);
+}
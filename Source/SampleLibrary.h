@@ -0,0 +1,71 @@
+#pragma once
+
+#include "GrainSource.h"
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include <atomic>
+#include <memory>
+
+/**
+ * SampleLibrary - Memory-mapped WAV/AIFF source material for the grain engine
+ * Files are mapped through juce::MemoryMappedAudioFormatReader rather than decoded, so grains
+ * read their frames straight from the mapped pages and only the regions grains actually
+ * touch become resident. A background thread pages in the regions announced through
+ * prefetch(), keeping page faults off the audio thread. Multichannel files are read as the
+ * average of their first two channels.
+ */
+class SampleLibrary : public GrainSource
+{
+public:
+    //==============================================================================
+    SampleLibrary();
+    ~SampleLibrary() override;
+
+    /** Returns true if the file is a WAV or AIFF file that can be memory-mapped. */
+    static bool canMapFile(const juce::File& file);
+
+    /**
+     * Maps the file and makes it the current source. Returns false and keeps the
+     * previous source if the file cannot be mapped. Must not be called from the audio thread.
+     */
+    bool loadFile(const juce::File& file);
+
+    /** Releases the current source. Must not be called from the audio thread. */
+    void unload();
+
+    bool isLoaded() const noexcept { return lengthInSamples.load(std::memory_order_acquire) > 0; }
+    juce::File getLoadedFile() const;
+    double getSourceSampleRate() const noexcept { return sourceSampleRate.load(std::memory_order_relaxed); }
+
+    //==============================================================================
+    juce::Range<juce::int64> getReadableRange() const noexcept override;
+    void readSamples(float* dest, juce::int64 startSample, int numSamples) const noexcept override;
+    void prefetch(juce::int64 startSample, juce::int64 numSamples) const noexcept override;
+
+private:
+    //==============================================================================
+    class Prefetcher;
+
+    using ReaderPtr = std::shared_ptr<juce::MemoryMappedAudioFormatReader>;
+
+    void setReader(ReaderPtr newReader, const juce::File& newFile);
+    ReaderPtr getReaderForPrefetch() const;
+
+    //==============================================================================
+    // Render threads register in activeReads and back off while a swap is pending, so any
+    // number of them can read at once without locking. The prefetch thread takes its own
+    // copy of the reader under prefetchLock, so it never contends with them either.
+    ReaderPtr reader;
+    mutable std::atomic<int> activeReads { 0 };
+    std::atomic<bool> swapPending { false };
+    mutable juce::CriticalSection prefetchLock;
+
+    std::atomic<juce::int64> lengthInSamples { 0 };
+    std::atomic<double> sourceSampleRate { 0.0 };
+    juce::File loadedFile;
+
+    std::unique_ptr<Prefetcher> prefetcher;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleLibrary)
+};
@@ -0,0 +1,314 @@
+#include "SourceLoader.h"
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+//==============================================================================
+SourceLoader::SourceLoader()
+    : juce::Thread("Source loading")
+{
+    formatManager.registerBasicFormats();
+}
+
+SourceLoader::~SourceLoader()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread(4000);
+
+    // The audio thread has stopped, so everything left can be freed here
+    reclaim(std::numeric_limits<juce::int64>::max());
+    delete published.exchange(nullptr);
+    delete fading;
+    delete current;
+}
+
+bool SourceLoader::canLoad(const juce::File& file) const
+{
+    return file.existsAsFile()
+        && (SampleLibrary::canMapFile(file) || formatManager.findFormatForFileExtension(file.getFileExtension()) != nullptr);
+}
+
+juce::uint32 SourceLoader::load(const juce::File& file)
+{
+    jassert(file != juce::File());
+    return request(file);
+}
+
+juce::uint32 SourceLoader::clear()
+{
+    return request({});
+}
+
+juce::File SourceLoader::getRequestedFile() const
+{
+    const juce::ScopedLock scope(requestLock);
+    return requestedFile;
+}
+
+juce::uint32 SourceLoader::request(const juce::File& file)
+{
+    juce::uint32 tag = 0;
+
+    {
+        const juce::ScopedLock scope(requestLock);
+
+        // Tag 0 is reserved for "no source", so onsets analysed for nothing never match
+        if (++lastTag == 0)
+            ++lastTag;
+
+        tag = lastTag;
+        requestedFile = file;
+        requestedTag = tag;
+        requestPending = true;
+        loading.store(true, std::memory_order_relaxed);
+    }
+
+    if (! isThreadRunning())
+        startThread();
+
+    notify();
+    return tag;
+}
+
+//==============================================================================
+void SourceLoader::run()
+{
+    juce::File loadedFile;
+
+    while (! threadShouldExit())
+    {
+        reclaim(renderedPosition.load(std::memory_order_acquire));
+
+        juce::File file;
+        juce::uint32 tag = 0;
+
+        {
+            const juce::ScopedLock scope(requestLock);
+
+            if (requestPending)
+            {
+                file = requestedFile;
+                tag = requestedTag;
+            }
+
+            requestPending = false;
+        }
+
+        if (tag == 0)
+        {
+            wait(reclaimIntervalMs);
+            continue;
+        }
+
+        auto loaded = open(file, tag);
+        auto superseded = false;
+
+        {
+            const juce::ScopedLock scope(requestLock);
+
+            // A newer request makes this source obsolete before anything could hear it
+            superseded = requestPending;
+
+            if (! superseded)
+            {
+                loading.store(false, std::memory_order_relaxed);
+
+                if (loaded == nullptr)
+                    requestedFile = loadedFile;
+            }
+        }
+
+        // Dropped sources are freed outside the lock, since that stops their threads
+        if (superseded || loaded == nullptr)
+            continue;
+
+        loadedFile = file;
+        publish(std::move(loaded));
+    }
+}
+
+std::unique_ptr<SourceLoader::LoadedSource> SourceLoader::open(const juce::File& file, juce::uint32 tag) const
+{
+    auto loaded = std::make_unique<LoadedSource>();
+    loaded->file = file;
+    loaded->tag = tag;
+
+    if (file == juce::File())
+        return loaded;
+
+    // Another instance may have this very file open already
+    const auto identity = OnsetIndex::SourceIdentity::of(file);
+    auto entry = registry->find(identity);
+
+    if (entry.source == nullptr)
+    {
+        entry = openFile(file);
+
+        if (entry.source == nullptr)
+            return nullptr;
+
+        entry = registry->add(identity, std::move(entry));
+    }
+
+    loaded->source = std::move(entry.source);
+    loaded->streaming = entry.streaming;
+    loaded->sampleRate = entry.sampleRate;
+    return loaded;
+}
+
+SourceRegistry::Entry SourceLoader::openFile(const juce::File& file)
+{
+    SourceRegistry::Entry entry;
+
+    // Uncompressed files are memory-mapped; anything else is streamed through a decoder
+    if (SampleLibrary::canMapFile(file))
+    {
+        auto library = std::make_shared<SampleLibrary>();
+
+        if (library->loadFile(file))
+        {
+            entry.sampleRate = library->getSourceSampleRate();
+            entry.source = std::move(library);
+            return entry;
+        }
+    }
+
+    auto streaming = std::make_shared<StreamingSource>();
+
+    if (! streaming->loadFile(file))
+        return entry;
+
+    entry.sampleRate = streaming->getSourceSampleRate();
+    entry.streaming = streaming.get();
+    entry.source = std::move(streaming);
+    return entry;
+}
+
+void SourceLoader::publish(std::unique_ptr<LoadedSource> loaded)
+{
+    // A source replaced before beginBlock() took it was never seen by the audio thread
+    delete published.exchange(loaded.release(), std::memory_order_acq_rel);
+}
+
+void SourceLoader::reclaim(juce::int64 renderedUpTo)
+{
+    int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+    retiredFifo.prepareToRead(retiredFifo.getNumReady(), start1, size1, start2, size2);
+
+    // Sources are freed in the order they were retired, so one still held keeps the later ones too
+    int numReclaimed = 0;
+
+    for (; numReclaimed < size1 + size2; ++numReclaimed)
+    {
+        auto& entry = retired[static_cast<size_t>(numReclaimed < size1 ? start1 + numReclaimed : start2 + numReclaimed - size1)];
+
+        if (entry.releasePosition > renderedUpTo)
+            break;
+
+        delete std::exchange(entry.loaded, nullptr);
+    }
+
+    retiredFifo.finishedRead(numReclaimed);
+}
+
+//==============================================================================
+void SourceLoader::prepare(double sampleRate, double maxGrainSeconds)
+{
+    jassert(sampleRate > 0.0);
+
+    crossfadeLength = std::max<juce::int64>(1, static_cast<juce::int64>(std::ceil(crossfadeSeconds * sampleRate)));
+    holdLength = static_cast<juce::int64>(std::ceil(maxGrainSeconds * sampleRate));
+}
+
+void SourceLoader::beginBlock(int numSamples) noexcept
+{
+    // Every earlier block has been rendered, so grains that ended by now read no source any more
+    blockStart = blockEnd;
+    blockEnd += numSamples;
+    renderedPosition.store(blockStart, std::memory_order_release);
+
+    // Taking a new source retires the one still fading, which needs room in the queue;
+    // without it, the new source simply waits a block
+    if (retiredFifo.getFreeSpace() > 0)
+    {
+        if (auto* next = published.exchange(nullptr, std::memory_order_acq_rel))
+        {
+            // Cut off mid-fade, its last grains may sound for holdLength after the last block that spawned any
+            if (fadingActive)
+                retire(fading, fadeSpawnEnd + holdLength);
+
+            // The outgoing source spawned every grain up to this block
+            fading = current;
+            fadingActive = true;
+            fadeElapsed = 0;
+            fadeSpawnEnd = blockStart;
+            current = next;
+        }
+    }
+
+    crossfade = 1.0f;
+
+    if (! fadingActive)
+        return;
+
+    // The fade only moves on per block, so a grain spawned late in its last block sounds for up
+    // to holdLength after that block's end, not after the crossfade length
+    if (fadeElapsed >= crossfadeLength && blockStart >= fadeSpawnEnd + holdLength)
+    {
+        releaseFading(fadeSpawnEnd + holdLength);
+        return;
+    }
+
+    crossfade = static_cast<float>(std::min<juce::int64>(fadeElapsed, crossfadeLength)) / static_cast<float>(crossfadeLength);
+    fadeElapsed += numSamples;
+
+    if (crossfade < 1.0f)
+        fadeSpawnEnd = blockEnd;
+}
+
+void SourceLoader::releaseFadingSource() noexcept
+{
+    releaseFading(blockStart);
+}
+
+void SourceLoader::releaseFading(juce::int64 releasePosition) noexcept
+{
+    // With the queue full, the source is kept for another block
+    if (fadingActive && retire(fading, releasePosition))
+    {
+        fading = nullptr;
+        fadingActive = false;
+        crossfade = 1.0f;
+    }
+}
+
+bool SourceLoader::retire(LoadedSource* loaded, juce::int64 releasePosition) noexcept
+{
+    if (loaded == nullptr)
+        return true;
+
+    if (retiredFifo.getFreeSpace() == 0)
+        return false;
+
+    if (loaded->streaming != nullptr)
+        retiredCacheMisses += loaded->streaming->getNumCacheMisses();
+
+    retiredFifo.write(1).forEach([this, loaded, releasePosition](int index)
+    {
+        retired[static_cast<size_t>(index)] = { loaded, releasePosition };
+    });
+    return true;
+}
+
+juce::uint32 SourceLoader::getNumCacheMisses() const noexcept
+{
+    auto total = retiredCacheMisses;
+
+    for (const auto* loaded : { current, fading })
+        if (loaded != nullptr && loaded->streaming != nullptr)
+            total += loaded->streaming->getNumCacheMisses();
+
+    return total;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "SampleLibrary.h"
+#include "SourceRegistry.h"
+#include "StreamingSource.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+/**
+ * SourceLoader - Opens source files on a background thread and hands them to the audio thread
+ * load() only queues a file, so neither the message thread nor a session recall that
+ * replaces every source at once ever waits on the disk. The loading thread maps or opens
+ * the file into a source of its own, then publishes it with one atomic exchange; the audio
+ * thread takes it over at the start of a block and fades from the previous source to it.
+ * A source the audio thread is done with is never freed there: it is queued back (RCU
+ * style) with the sample position by which its last grain has ended, and deleted by the
+ * loading thread once the audio thread has rendered past it.
+ * Files another instance already has open are taken from the shared SourceRegistry rather
+ * than opened a second time.
+ */
+class SourceLoader : private juce::Thread
+{
+public:
+    //==============================================================================
+    static constexpr double crossfadeSeconds = 0.25;  // New grains move over to a new source across this time
+    static constexpr int maxRetiredSources = 8;
+    static constexpr int reclaimIntervalMs = 50;
+
+    /** One opened source, owned by the loader and published to the audio thread whole. */
+    struct LoadedSource
+    {
+        std::shared_ptr<GrainSource> source;          // nullptr for the live input; may be shared
+        const StreamingSource* streaming = nullptr;   // source, if it streams
+        juce::File file;
+        double sampleRate = 0.0;
+        juce::uint32 tag = 0;                         // Identifies the request that produced it
+    };
+
+    //==============================================================================
+    SourceLoader();
+    ~SourceLoader() override;
+
+    /** Returns true if file exists and is in a format the loader can map or stream. Cheap. */
+    bool canLoad(const juce::File& file) const;
+
+    /**
+     * Queues file to be opened in the background and returns the tag its source will carry.
+     * A request supersedes any earlier one that has not been opened yet; a file that turns
+     * out not to open leaves the current source in place. Not for the audio thread.
+     */
+    juce::uint32 load(const juce::File& file);
+
+    /** Queues a switch back to the live input, returning its tag. Not for the audio thread. */
+    juce::uint32 clear();
+
+    bool isLoading() const noexcept { return loading.load(std::memory_order_relaxed); }
+
+    /** The file of the latest request, opened or not; empty for the live input. */
+    juce::File getRequestedFile() const;
+
+    //==============================================================================
+    /** Sizes the crossfade, and how long a faded-out source is kept for its last grains. */
+    void prepare(double sampleRate, double maxGrainSeconds);
+
+    /**
+     * Called by the audio thread at the start of each block: takes over a newly published
+     * source and moves the crossfade on by numSamples. Wait-free.
+     */
+    void beginBlock(int numSamples) noexcept;
+
+    /** Retires the faded-out source at once, for when no grain can be reading it any more. */
+    void releaseFadingSource() noexcept;
+
+    /** The audio thread's current source, or nullptr before any source was published. */
+    const LoadedSource* getCurrent() const noexcept { return current; }
+
+    /** True while grains of the previous source may still be sounding. */
+    bool isFading() const noexcept { return fadingActive; }
+    const LoadedSource* getFading() const noexcept { return fading; }
+
+    /** Share of new grains to spawn from the current source during this block. */
+    float getCrossfade() const noexcept { return crossfade; }
+
+    /**
+     * Cache misses of every streamed source since construction, including those of other
+     * instances reading the same shared stream. Audio thread only.
+     */
+    juce::uint32 getNumCacheMisses() const noexcept;
+
+private:
+    //==============================================================================
+    void run() override;
+
+    juce::uint32 request(const juce::File& file);
+    void publish(std::unique_ptr<LoadedSource> loaded);
+    void releaseFading(juce::int64 releasePosition) noexcept;
+    bool retire(LoadedSource* loaded, juce::int64 releasePosition) noexcept;
+    void reclaim(juce::int64 renderedPosition);
+
+    std::unique_ptr<LoadedSource> open(const juce::File& file, juce::uint32 tag) const;
+    static SourceRegistry::Entry openFile(const juce::File& file);
+
+    //==============================================================================
+    // Requests are handed to the thread under requestLock
+    mutable juce::CriticalSection requestLock;
+    juce::File requestedFile;
+    juce::uint32 requestedTag = 0, lastTag = 0;
+    bool requestPending = false;
+    std::atomic<bool> loading { false };
+
+    // The newest opened source, until beginBlock() takes it
+    std::atomic<LoadedSource*> published { nullptr };
+
+    // Sources the audio thread has let go of, waiting to be deleted on the loading thread once
+    // every block up to releasePosition has been rendered
+    struct RetiredSource
+    {
+        LoadedSource* loaded = nullptr;
+        juce::int64 releasePosition = 0;
+    };
+
+    juce::AbstractFifo retiredFifo { maxRetiredSources };
+    std::array<RetiredSource, maxRetiredSources> retired {};
+    std::atomic<juce::int64> renderedPosition { 0 };   // Samples of the blocks before the current one
+
+    // Audio thread state
+    LoadedSource* current = nullptr;
+    LoadedSource* fading = nullptr;
+    bool fadingActive = false;
+    float crossfade = 1.0f;
+    juce::int64 fadeElapsed = 0, crossfadeLength = 1, holdLength = 0;
+    juce::int64 blockStart = 0, blockEnd = 0;
+    juce::int64 fadeSpawnEnd = 0;   // End of the last block that spawned grains from the fading source
+    juce::uint32 retiredCacheMisses = 0;
+
+    juce::AudioFormatManager formatManager;   // Only asked for formats, never for readers
+    juce::SharedResourcePointer<SourceRegistry> registry;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SourceLoader)
+};
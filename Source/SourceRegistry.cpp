@@ -0,0 +1,69 @@
+#include "SourceRegistry.h"
+
+#include <algorithm>
+
+//==============================================================================
+SourceRegistry::Entry SourceRegistry::lock(const Slot& slot)
+{
+    Entry entry;
+    entry.source = slot.source.lock();
+
+    // The stream pointer is only meaningful while the source it points into is alive
+    if (entry.source != nullptr)
+    {
+        entry.streaming = slot.streaming;
+        entry.sampleRate = slot.sampleRate;
+    }
+
+    return entry;
+}
+
+SourceRegistry::Entry SourceRegistry::find(const OnsetIndex::SourceIdentity& identity) const
+{
+    const juce::ScopedLock scope(registryLock);
+
+    for (const auto& slot : slots)
+    {
+        if (slot.identity != identity)
+            continue;
+
+        auto entry = lock(slot);
+
+        if (entry.source != nullptr)
+            return entry;
+    }
+
+    return {};
+}
+
+SourceRegistry::Entry SourceRegistry::add(const OnsetIndex::SourceIdentity& identity, Entry entry)
+{
+    jassert(entry.source != nullptr);
+
+    const juce::ScopedLock scope(registryLock);
+
+    slots.erase(std::remove_if(slots.begin(), slots.end(), [](const Slot& slot) { return slot.source.expired(); }),
+                slots.end());
+
+    // Two instances can open the same file at once; the first one registered wins
+    for (const auto& slot : slots)
+    {
+        if (slot.identity != identity)
+            continue;
+
+        auto existing = lock(slot);
+
+        if (existing.source != nullptr)
+            return existing;
+    }
+
+    slots.push_back({ identity, entry.source, entry.streaming, entry.sampleRate });
+    return entry;
+}
+
+int SourceRegistry::getNumSources() const
+{
+    const juce::ScopedLock scope(registryLock);
+
+    return static_cast<int>(std::count_if(slots.begin(), slots.end(), [](const Slot& slot) { return ! slot.source.expired(); }));
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "GrainSource.h"
+#include "OnsetIndex.h"
+#include "StreamingSource.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ * SourceRegistry - Process-wide table of the sources that plugin instances have open
+ * Every instance reaches the same registry through juce::SharedResourcePointer. A source is
+ * read-only once opened and may be read by any number of threads, so instances opening the
+ * same file (same path, size and modification time) share one mapping or one decoded chunk
+ * cache instead of each keeping its own. The registry only holds weak references: a source
+ * is freed as soon as the last instance using it lets go.
+ */
+class SourceRegistry
+{
+public:
+    //==============================================================================
+    /** An opened source, with what the loader needs to know about it. */
+    struct Entry
+    {
+        std::shared_ptr<GrainSource> source;          // nullptr if there is none
+        const StreamingSource* streaming = nullptr;   // source, if it streams
+        double sampleRate = 0.0;
+    };
+
+    SourceRegistry() = default;
+
+    /** Returns the source some instance already has open for identity, or an empty entry. */
+    Entry find(const OnsetIndex::SourceIdentity& identity) const;
+
+    /**
+     * Registers a newly opened source and returns the entry to use: entry itself, or the
+     * source another instance registered for the same file in the meantime.
+     */
+    Entry add(const OnsetIndex::SourceIdentity& identity, Entry entry);
+
+    /** Number of sources still held by some instance. */
+    int getNumSources() const;
+
+private:
+    //==============================================================================
+    struct Slot
+    {
+        OnsetIndex::SourceIdentity identity;
+        std::weak_ptr<GrainSource> source;
+        const StreamingSource* streaming = nullptr;
+        double sampleRate = 0.0;
+    };
+
+    static Entry lock(const Slot& slot);
+
+    mutable juce::CriticalSection registryLock;
+    std::vector<Slot> slots;   // Expired slots are dropped whenever a source is added
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SourceRegistry)
+};
@@ -0,0 +1,182 @@
+#include "SpectralGrainEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace
+{
+    // A periodic Hann window used for both analysis and synthesis sums to 1.5 at four-fold overlap
+    constexpr float overlapAddGain = 1.0f / 1.5f;
+
+    // Smearing at 1 would never let a new frame in; 0.99 averages over about a hundred frames
+    constexpr float maxSmearCoefficient = 0.99f;
+
+    // Frozen phases drift by up to this much per frame, so a held spectrum does not repeat every frame
+    constexpr float freezePhaseJitter = juce::MathConstants<float>::halfPi;
+
+    inline float wrapPhase(float phase) noexcept
+    {
+        return phase - juce::MathConstants<float>::twoPi * std::floor(phase / juce::MathConstants<float>::twoPi);
+    }
+
+    /** The phase a steady partial at the centre of bin turns by in one hop. */
+    inline float getHopPhaseAdvance(int bin) noexcept
+    {
+        return juce::MathConstants<float>::twoPi * static_cast<float>(bin * SpectralGrainEngine::hopSize)
+             / static_cast<float>(SpectralGrainEngine::fftSize);
+    }
+}
+
+//==============================================================================
+void SpectralGrainEngine::prepare()
+{
+    if (fft == nullptr)
+        fft = std::make_unique<juce::dsp::FFT>(fftOrder);
+
+    window.ensureSize(fftSize);
+    fftData.ensureSize(2 * fftSize);
+    magnitudes.ensureSize(numBins);
+    phases.ensureSize(numBins);
+    synthesisMagnitudes.ensureSize(numBins);
+    overlapAdd.ensureSize(fftSize);
+
+    for (int i = 0; i < fftSize; ++i)
+        window[i] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * static_cast<float>(i) / static_cast<float>(fftSize));
+
+    reset();
+}
+
+void SpectralGrainEngine::releaseResources()
+{
+    fft = nullptr;
+    window.free();
+    fftData.free();
+    magnitudes.free();
+    phases.free();
+    synthesisMagnitudes.free();
+    overlapAdd.free();
+    hasSpectrum = false;
+}
+
+void SpectralGrainEngine::reset() noexcept
+{
+    overlapAdd.clear();
+    magnitudes.clear();
+    phases.clear();
+    hopPosition = hopSize;
+    hasSpectrum = false;
+}
+
+//==============================================================================
+void SpectralGrainEngine::process(const Settings& settings, const GrainSource& source,
+                                  float* left, float* right, int numSamples) noexcept
+{
+    if (! isPrepared())
+        return;
+
+    for (int done = 0; done < numSamples;)
+    {
+        if (hopPosition == hopSize)
+        {
+            processFrame(settings, source);
+            hopPosition = 0;
+        }
+
+        const auto count = std::min(numSamples - done, hopSize - hopPosition);
+        juce::FloatVectorOperations::add(left + done, overlapAdd.get() + hopPosition, count);
+        juce::FloatVectorOperations::add(right + done, overlapAdd.get() + hopPosition, count);
+
+        hopPosition += count;
+        done += count;
+    }
+}
+
+void SpectralGrainEngine::processFrame(const Settings& settings, const GrainSource& source) noexcept
+{
+    // The hop just played is complete; every later sample still waits for more frames
+    auto* ring = overlapAdd.get();
+    juce::FloatVectorOperations::copy(ring, ring + hopSize, fftSize - hopSize);
+    juce::FloatVectorOperations::clear(ring + fftSize - hopSize, hopSize);
+
+    // A frozen spectrum keeps its magnitudes and turns each phase at its bin's own rate
+    if (settings.freeze && hasSpectrum)
+    {
+        // fftData is free until the synthesis below, so it holds this frame's jitter draws
+        auto* jitter = fftData.get();
+        random.fillFloats(jitter, numBins);
+
+        for (int bin = 0; bin < numBins; ++bin)
+            phases[bin] = wrapPhase(phases[bin] + getHopPhaseAdvance(bin) + freezePhaseJitter * (jitter[bin] - 0.5f));
+    }
+    else
+    {
+        analyse(settings, source);
+    }
+
+    // Shuffling moves magnitudes between nearby bins for this frame only, so it never accumulates
+    juce::FloatVectorOperations::copy(synthesisMagnitudes.get(), magnitudes.get(), numBins);
+
+    if (settings.shuffle > 0.0f)
+    {
+        for (int bin = 1; bin < numBins; ++bin)
+        {
+            if (random.nextFloat() >= settings.shuffle)
+                continue;
+
+            const auto other = juce::jlimit(1, numBins - 1, bin + random.nextInt(2 * maxShuffleDistance + 1) - maxShuffleDistance);
+            std::swap(synthesisMagnitudes[bin], synthesisMagnitudes[other]);
+        }
+    }
+
+    // juce::dsp::FFT fills in the negative frequencies itself and scales the inverse by 1 / fftSize
+    auto* data = fftData.get();
+
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        data[2 * bin] = synthesisMagnitudes[bin] * std::cos(phases[bin]);
+        data[2 * bin + 1] = synthesisMagnitudes[bin] * std::sin(phases[bin]);
+    }
+
+    juce::FloatVectorOperations::clear(data + 2 * numBins, 2 * (fftSize - numBins));
+    fft->performRealOnlyInverseTransform(data);
+
+    juce::FloatVectorOperations::multiply(data, window.get(), fftSize);
+    juce::FloatVectorOperations::addWithMultiply(ring, data, overlapAddGain, fftSize);
+}
+
+void SpectralGrainEngine::analyse(const Settings& settings, const GrainSource& source) noexcept
+{
+    // Frames start anywhere from the oldest readable sample to the newest full frame
+    const auto readable = source.getReadableRange();
+    const auto span = std::max<juce::int64>(0, readable.getLength() - fftSize);
+    auto offset = static_cast<double>(settings.position) * static_cast<double>(span);
+
+    if (settings.spray > 0.0f)
+        offset += static_cast<double>(settings.spray) * static_cast<double>(span) * (random.nextDouble() - 0.5);
+
+    const auto start = readable.getStart() + juce::jlimit<juce::int64>(0, span, static_cast<juce::int64>(offset));
+
+    auto* data = fftData.get();
+    source.readSamples(data, start, fftSize);
+    juce::FloatVectorOperations::multiply(data, window.get(), fftSize);
+    juce::FloatVectorOperations::clear(data + fftSize, fftSize);
+    fft->performRealOnlyForwardTransform(data, true);
+
+    const auto smear = hasSpectrum ? juce::jlimit(0.0f, maxSmearCoefficient, settings.smear) : 0.0f;
+
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        const auto real = data[2 * bin];
+        const auto imag = data[2 * bin + 1];
+        const auto analysed = (1.0f - smear) * std::sqrt(real * real + imag * imag);
+        const auto held = smear * magnitudes[bin];
+
+        // Where the smeared past outweighs the new frame, the bin keeps its own phase turning
+        // rather than taking the frame's, which is meaningless once the input has gone quiet
+        phases[bin] = analysed >= held ? std::atan2(imag, real) : wrapPhase(phases[bin] + getHopPhaseAdvance(bin));
+        magnitudes[bin] = analysed + held;
+    }
+
+    hasSpectrum = true;
+}
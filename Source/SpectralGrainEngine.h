@@ -0,0 +1,78 @@
+#pragma once
+
+#include "AlignedBuffer.h"
+#include "GrainRandom.h"
+#include "GrainSource.h"
+
+#include <juce_dsp/juce_dsp.h>
+
+#include <memory>
+
+/**
+ * SpectralGrainEngine - Spectral granulation of source frames through juce::dsp::FFT
+ * Every hop, one Hann-windowed frame is read from the source at the position setting and
+ * taken apart into magnitudes and phases. Three operations then act on the spectrum before
+ * it is resynthesised and overlap-added into the output ring: freeze holds the last analysed
+ * magnitudes and keeps their phases turning, smear averages each bin's magnitude over
+ * successive frames, and shuffle swaps bins with random neighbours. The FFT plan, windows
+ * and every buffer are made in prepare(), so process() never allocates.
+ */
+class SpectralGrainEngine
+{
+public:
+    //==============================================================================
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize = 1 << fftOrder;         // 2048 samples, about 43 ms at 48 kHz
+    static constexpr int numBins = fftSize / 2 + 1;
+    static constexpr int hopSize = fftSize / 4;            // Four frames overlap at every sample
+    static constexpr int maxShuffleDistance = 32;          // Bins a shuffled bin may move by
+
+    /** Per-block spectral settings, normally derived from the plugin parameters. */
+    struct Settings
+    {
+        float position = 1.0f;   // 0 = oldest readable material, 1 = newest
+        float spray = 0.0f;      // Random frame offset as a fraction of the readable range
+        bool freeze = false;     // Hold the last analysed spectrum instead of reading new frames
+        float smear = 0.0f;      // 0 = every frame as analysed, towards 1 = magnitudes averaged over more frames
+        float shuffle = 0.0f;    // Share of bins swapped with a random neighbour in every frame
+    };
+
+    //==============================================================================
+    SpectralGrainEngine() = default;
+
+    /** Builds the FFT plan and windows and allocates every buffer. Not for the audio thread. */
+    void prepare();
+
+    /** Frees everything prepare() made; process() does nothing until the next prepare(). */
+    void releaseResources();
+
+    /** Silences the output ring and forgets the analysed spectrum. */
+    void reset() noexcept;
+
+    /** Restarts the random sequence behind spray, shuffle and the frozen phases. Not while process() runs. */
+    void setRandomSeed(juce::uint64 seed) noexcept { random.setSeed(seed); }
+
+    bool isPrepared() const noexcept { return fft != nullptr; }
+
+    /** Adds numSamples of mono resynthesis into left and right, one frame behind the material it reads. */
+    void process(const Settings& settings, const GrainSource& source, float* left, float* right, int numSamples) noexcept;
+
+private:
+    //==============================================================================
+    void processFrame(const Settings& settings, const GrainSource& source) noexcept;
+    void analyse(const Settings& settings, const GrainSource& source) noexcept;
+
+    //==============================================================================
+    std::unique_ptr<juce::dsp::FFT> fft;
+    AlignedBuffer<float> window;
+    AlignedBuffer<float> fftData;              // 2 * fftSize floats, as juce::dsp::FFT wants them
+    AlignedBuffer<float> magnitudes, phases;   // Analysed spectrum, after smearing
+    AlignedBuffer<float> synthesisMagnitudes;  // magnitudes after shuffling, for one frame
+    AlignedBuffer<float> overlapAdd;           // fftSize samples; the first hop is output next
+
+    int hopPosition = hopSize;
+    bool hasSpectrum = false;
+    GrainRandom random;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectralGrainEngine)
+};
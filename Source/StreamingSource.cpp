@@ -0,0 +1,258 @@
+#include "StreamingSource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+//==============================================================================
+/**
+ * Decoder - Worker thread that fills the chunk cache from the compressed source
+ * Requested chunks come first; the chunk after each request is decoded as read-ahead,
+ * since grains move forward through the source.
+ */
+class StreamingSource::Decoder : public juce::Thread
+{
+public:
+    static constexpr int pollIntervalMs = 2;
+    static constexpr int maxChunksPerRequest = 8;
+
+    explicit Decoder(StreamingSource& ownerToUse)
+        : juce::Thread("Source streaming decoder"), owner(ownerToUse)
+    {
+        pendingChunks.reserve(static_cast<size_t>(256 * (maxChunksPerRequest + 1)));
+    }
+
+    ~Decoder() override
+    {
+        stopThread(2000);
+    }
+
+    /** Swaps the reader. Only called while the thread is stopped. */
+    void setReader(std::unique_ptr<juce::AudioFormatReader> newReader)
+    {
+        jassert(! isThreadRunning());
+
+        reader = std::move(newReader);
+
+        if (reader != nullptr)
+            decodeBuffer.setSize(2, chunkSize);
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            pendingChunks.clear();
+
+            owner.requests.drain([this](juce::int64 start, juce::int64 length)
+            {
+                const auto first = start / chunkSize;
+                const auto last = std::min(first + maxChunksPerRequest - 1, (start + std::max<juce::int64>(1, length) - 1) / chunkSize);
+
+                for (auto chunk = first; chunk <= last + 1; ++chunk)
+                    pendingChunks.push_back(chunk);
+            });
+
+            for (auto chunk : pendingChunks)
+            {
+                if (threadShouldExit())
+                    return;
+
+                decodeChunk(chunk);
+            }
+
+            if (pendingChunks.empty())
+                wait(pollIntervalMs);
+        }
+    }
+
+private:
+    void decodeChunk(juce::int64 chunkIndex)
+    {
+        const auto start = chunkIndex * chunkSize;
+
+        if (reader == nullptr || start >= reader->lengthInSamples)
+            return;
+
+        auto& slot = owner.getSlot(chunkIndex);
+
+        if (slot.tag.load(std::memory_order_acquire) == chunkIndex)
+            return;
+
+        const auto numFrames = static_cast<int>(std::min<juce::int64>(chunkSize, reader->lengthInSamples - start));
+
+        // Decode first, so the slot is only invalid for the duration of the copy
+        reader->read(&decodeBuffer, 0, numFrames, start, true, true);
+
+        slot.tag.store(-1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        juce::FloatVectorOperations::add(slot.frames, decodeBuffer.getReadPointer(0), decodeBuffer.getReadPointer(1), numFrames);
+        juce::FloatVectorOperations::multiply(slot.frames, 0.5f, numFrames);
+        juce::FloatVectorOperations::clear(slot.frames + numFrames, chunkSize - numFrames);
+
+        slot.tag.store(chunkIndex, std::memory_order_release);
+    }
+
+    StreamingSource& owner;
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    juce::AudioBuffer<float> decodeBuffer;
+    std::vector<juce::int64> pendingChunks;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Decoder)
+};
+
+//==============================================================================
+StreamingSource::StreamingSource()
+    : decoder(std::make_unique<Decoder>(*this))
+{
+    formatManager.registerBasicFormats();
+}
+
+StreamingSource::~StreamingSource()
+{
+    decoder = nullptr;
+}
+
+bool StreamingSource::canStreamFile(const juce::File& file) const
+{
+    return file.existsAsFile() && formatManager.findFormatForFileExtension(file.getFileExtension()) != nullptr;
+}
+
+bool StreamingSource::loadFile(const juce::File& file)
+{
+    if (! canStreamFile(file))
+        return false;
+
+    std::unique_ptr<juce::AudioFormatReader> newReader(formatManager.createReaderFor(file));
+
+    if (newReader == nullptr || newReader->numChannels == 0 || newReader->lengthInSamples <= 0)
+        return false;
+
+    // The cache is allocated on first use and reused by every later source
+    if (slots == nullptr)
+    {
+        cacheStorage.allocate(chunkSize * numCacheSlots);
+        slots = std::make_unique<CacheSlot[]>(static_cast<size_t>(numCacheSlots));
+
+        for (int i = 0; i < numCacheSlots; ++i)
+            slots[static_cast<size_t>(i)].frames = cacheStorage.get() + static_cast<size_t>(i) * chunkSize;
+    }
+
+    // Unpublish the old source before touching the cache; readers then see silence
+    decoder->stopThread(2000);
+    lengthInSamples.store(0, std::memory_order_release);
+    invalidateCache();
+
+    const auto newLength = newReader->lengthInSamples;
+    sourceSampleRate.store(newReader->sampleRate, std::memory_order_relaxed);
+    decoder->setReader(std::move(newReader));
+    loadedFile = file;
+
+    lengthInSamples.store(newLength, std::memory_order_release);
+
+    // Warm up the opening of the file straight away
+    requests.add(0, chunkSize);
+    decoder->startThread();
+    return true;
+}
+
+void StreamingSource::unload()
+{
+    decoder->stopThread(2000);
+    lengthInSamples.store(0, std::memory_order_release);
+    invalidateCache();
+    decoder->setReader(nullptr);
+    loadedFile = juce::File();
+}
+
+juce::File StreamingSource::getLoadedFile() const
+{
+    return loadedFile;
+}
+
+void StreamingSource::invalidateCache() noexcept
+{
+    requests.clear();
+    cacheMisses.store(0, std::memory_order_relaxed);
+
+    if (slots != nullptr)
+        for (int i = 0; i < numCacheSlots; ++i)
+            slots[static_cast<size_t>(i)].tag.store(-1, std::memory_order_release);
+}
+
+StreamingSource::CacheSlot& StreamingSource::getSlot(juce::int64 chunkIndex) const noexcept
+{
+    return slots[static_cast<size_t>(chunkIndex % numCacheSlots)];
+}
+
+bool StreamingSource::isCached(juce::int64 position) const noexcept
+{
+    if (! isLoaded() || position < 0)
+        return false;
+
+    const auto chunkIndex = position / chunkSize;
+    return getSlot(chunkIndex).tag.load(std::memory_order_acquire) == chunkIndex;
+}
+
+void StreamingSource::requestChunk(juce::int64 chunkIndex) const noexcept
+{
+    requests.add(chunkIndex * chunkSize, chunkSize);
+}
+
+//==============================================================================
+juce::Range<juce::int64> StreamingSource::getReadableRange() const noexcept
+{
+    return { 0, lengthInSamples.load(std::memory_order_acquire) };
+}
+
+void StreamingSource::readSamples(float* dest, juce::int64 startSample, int numSamples) const noexcept
+{
+    const auto length = lengthInSamples.load(std::memory_order_acquire);
+
+    for (int i = 0; i < numSamples;)
+    {
+        const auto position = startSample + i;
+
+        if (position < 0 || position >= length)
+        {
+            const auto gap = position < 0 ? static_cast<int>(std::min<juce::int64>(numSamples - i, -position))
+                                          : numSamples - i;
+            juce::FloatVectorOperations::clear(dest + i, gap);
+            i += gap;
+            continue;
+        }
+
+        const auto chunkIndex = position / chunkSize;
+        const auto offset = static_cast<int>(position % chunkSize);
+        const auto run = static_cast<int>(std::min<juce::int64>({ static_cast<juce::int64>(numSamples - i),
+                                                                 static_cast<juce::int64>(chunkSize - offset),
+                                                                 length - position }));
+
+        // Sequence check: the copy only counts if the slot held this chunk before and after it
+        auto& slot = getSlot(chunkIndex);
+        auto hit = slot.tag.load(std::memory_order_acquire) == chunkIndex;
+
+        if (hit)
+        {
+            std::memcpy(dest + i, slot.frames + offset, sizeof(float) * static_cast<size_t>(run));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            hit = slot.tag.load(std::memory_order_relaxed) == chunkIndex;
+        }
+
+        if (! hit)
+        {
+            juce::FloatVectorOperations::clear(dest + i, run);
+            cacheMisses.fetch_add(1, std::memory_order_relaxed);
+            requestChunk(chunkIndex);
+        }
+
+        i += run;
+    }
+}
+
+void StreamingSource::prefetch(juce::int64 startSample, juce::int64 numSamples) const noexcept
+{
+    if (isLoaded())
+        requests.add(startSample, numSamples);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "AlignedBuffer.h"
+#include "GrainSource.h"
+#include "ReadHintRing.h"
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include <atomic>
+#include <memory>
+
+/**
+ * StreamingSource - Compressed source material (FLAC, MP3, Ogg Vorbis) decoded on demand
+ * Compressed files cannot be memory-mapped, so a worker thread decodes fixed-size chunks of
+ * mono frames into a direct-mapped block cache. The worker is the only writer of the cache;
+ * the grain engine reads it wait-free, validating each chunk with a sequence tag that is
+ * checked before and after the copy. A miss never waits: the missing frames are silent, the
+ * miss is counted and the chunk is requested from the worker for the following blocks.
+ */
+class StreamingSource : public GrainSource
+{
+public:
+    //==============================================================================
+    static constexpr int chunkSize = 32768;   // Mono frames per cache chunk
+    static constexpr int numCacheSlots = 128; // About 16 MB of decoded audio
+
+    StreamingSource();
+    ~StreamingSource() override;
+
+    /** Returns true if one of the registered compressed formats can decode the file. */
+    bool canStreamFile(const juce::File& file) const;
+
+    /**
+     * Opens the file and makes it the current source, dropping everything cached for the
+     * previous one. Returns false and keeps the previous source on failure.
+     * Must not be called from the audio thread.
+     */
+    bool loadFile(const juce::File& file);
+
+    /** Releases the current source. Must not be called from the audio thread. */
+    void unload();
+
+    bool isLoaded() const noexcept { return lengthInSamples.load(std::memory_order_acquire) > 0; }
+    juce::File getLoadedFile() const;
+    double getSourceSampleRate() const noexcept { return sourceSampleRate.load(std::memory_order_relaxed); }
+
+    /** Number of chunk reads, since loading, that found their chunk missing. */
+    juce::uint32 getNumCacheMisses() const noexcept { return cacheMisses.load(std::memory_order_relaxed); }
+
+    /** Returns true if the chunk holding the given frame is currently cached. */
+    bool isCached(juce::int64 position) const noexcept;
+
+    //==============================================================================
+    juce::Range<juce::int64> getReadableRange() const noexcept override;
+    void readSamples(float* dest, juce::int64 startSample, int numSamples) const noexcept override;
+    void prefetch(juce::int64 startSample, juce::int64 numSamples) const noexcept override;
+
+private:
+    //==============================================================================
+    class Decoder;
+
+    struct CacheSlot
+    {
+        std::atomic<juce::int64> tag { -1 };  // Chunk index held by the slot, -1 while being written
+        float* frames = nullptr;              // chunkSize frames, zero-padded past the end of the file
+    };
+
+    CacheSlot& getSlot(juce::int64 chunkIndex) const noexcept;
+    void requestChunk(juce::int64 chunkIndex) const noexcept;
+    void invalidateCache() noexcept;
+
+    //==============================================================================
+    juce::AudioFormatManager formatManager;
+    std::unique_ptr<Decoder> decoder;
+
+    AlignedBuffer<float> cacheStorage;
+    std::unique_ptr<CacheSlot[]> slots;
+
+    mutable ReadHintRing<256> requests;
+    mutable std::atomic<juce::uint32> cacheMisses { 0 };
+
+    std::atomic<juce::int64> lengthInSamples { 0 };
+    std::atomic<double> sourceSampleRate { 0.0 };
+    juce::File loadedFile;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StreamingSource)
+};
@@ -0,0 +1,323 @@
+#include "WaveformDisplay.h"
+
+#include <cmath>
+
+//==============================================================================
+WaveformDisplay::WaveformDisplay(GranularPlunderphonicsAudioProcessor& processorToUse)
+    : audioProcessor(processorToUse)
+{
+    auto& state = audioProcessor.getValueTreeState();
+    positionValue = state.getRawParameterValue("position");
+    sprayValue = state.getRawParameterValue("spray");
+    jassert(positionValue != nullptr && sprayValue != nullptr);
+
+    grainBounds.reserve(GrainVisualFeed::maxGrainsPerFrame);
+
+    // Every pixel is covered by the waveform image or the placeholder fill
+    setOpaque(true);
+
+   #if GRANULAR_OPENGL
+    cloudRenderer.attachTo(*this);
+   #endif
+}
+
+WaveformDisplay::~WaveformDisplay()
+{
+    stopTimer();
+    audioProcessor.getGrainFeed().setActive(false);
+}
+
+//==============================================================================
+void WaveformDisplay::paint(juce::Graphics& g)
+{
+    if (overview == nullptr)
+    {
+        // Without a source file, grains read the live input and are drawn over its history
+        g.fillAll(juce::Colours::black);
+        g.setColour(juce::Colours::white.withAlpha(0.6f));
+        g.setFont(12.0f);
+
+        const auto text = audioProcessor.getSourceFile() == juce::File() ? "Live input" : "Reading source...";
+        g.drawText(text, getLocalBounds(), juce::Justification::centred, false);
+    }
+    else
+    {
+        if (! waveformImage.isValid())
+            renderWaveform();
+
+        // Only the invalidated strips are actually copied, however small the clip region is
+        g.drawImageAt(waveformImage, 0, 0);
+
+        if (! readWindowBounds.isEmpty())
+        {
+            g.setColour(juce::Colours::orange.withAlpha(0.25f));
+            g.fillRect(readWindowBounds);
+            g.setColour(juce::Colours::orange);
+            g.drawRect(readWindowBounds);
+        }
+    }
+
+    for (size_t i = 0; i < grainBounds.size(); ++i)
+    {
+        if (! g.clipRegionIntersects(grainBounds[i]))
+            continue;
+
+        g.setColour(juce::Colours::white.withAlpha(juce::jlimit(0.2f, 1.0f, grainFrame.grains[i].level)));
+        g.fillEllipse(grainBounds[i].toFloat());
+    }
+}
+
+template <typename ColumnFunction>
+void WaveformDisplay::forEachWaveformColumn(ColumnFunction&& function) const
+{
+    const auto width = getWidth();
+    const auto centreY = static_cast<float>(getHeight()) * 0.5f;
+    const auto samplesPerPixel = static_cast<double>(visibleRange.getLength()) / static_cast<double>(juce::jmax(1, width));
+
+    // Each column reads only the few peaks of the level just finer than a pixel
+    const auto level = overview->getLevelFor(samplesPerPixel);
+
+    for (int x = 0; x < width; ++x)
+    {
+        const auto start = visibleRange.getStart() + static_cast<juce::int64>(std::floor(x * samplesPerPixel));
+        const auto end = visibleRange.getStart() + static_cast<juce::int64>(std::ceil((x + 1) * samplesPerPixel));
+        const auto range = overview->getRange(level, start, end);
+
+        function(x, centreY - range.getEnd() * centreY, juce::jmax(centreY - range.getStart() * centreY,
+                                                                   centreY - range.getEnd() * centreY + 1.0f));
+    }
+}
+
+void WaveformDisplay::renderWaveform()
+{
+    waveformImage = juce::Image(juce::Image::RGB, juce::jmax(1, getWidth()), juce::jmax(1, getHeight()), true);
+    juce::Graphics g(waveformImage);
+    g.fillAll(juce::Colours::black);
+    g.setColour(juce::Colours::lightskyblue);
+
+    forEachWaveformColumn([&g](int x, float top, float bottom) { g.drawVerticalLine(x, top, bottom); });
+}
+
+void WaveformDisplay::resized()
+{
+    waveformImage = {};
+    readWindowBounds = getReadWindowBounds();
+    updateGrainBounds();
+    invalidate(getLocalBounds());
+}
+
+//==============================================================================
+void WaveformDisplay::mouseWheelMove(const juce::MouseEvent& event, const juce::MouseWheelDetails& wheel)
+{
+    if (overview == nullptr || wheel.deltaY == 0.0f)
+        return;
+
+    // The sample under the pointer stays where it is
+    const auto anchor = static_cast<double>(visibleRange.getStart())
+                      + static_cast<double>(visibleRange.getLength()) * event.position.x / juce::jmax(1, getWidth());
+    const auto scale = std::pow(zoomStep, -wheel.deltaY * 4.0f);
+    const auto sourceLength = static_cast<double>(overview->getLengthInSamples());
+    const auto length = juce::jlimit(juce::jmin(static_cast<double>(minVisibleSamples), sourceLength), sourceLength,
+                                     static_cast<double>(visibleRange.getLength()) * scale);
+    const auto start = anchor - (anchor - static_cast<double>(visibleRange.getStart())) * length
+                                  / static_cast<double>(juce::jmax<juce::int64>(1, visibleRange.getLength()));
+
+    setVisibleRange({ static_cast<juce::int64>(start), static_cast<juce::int64>(start + length) });
+}
+
+void WaveformDisplay::mouseDoubleClick(const juce::MouseEvent&)
+{
+    if (overview != nullptr)
+        setVisibleRange({ 0, overview->getLengthInSamples() });
+}
+
+void WaveformDisplay::setVisibleRange(juce::Range<juce::int64> newRange)
+{
+    // Keep the view inside the source, moving it rather than shrinking it where possible
+    const auto length = overview != nullptr ? overview->getLengthInSamples() : 0;
+    newRange = juce::Range<juce::int64>(0, length).constrainRange(newRange);
+
+    if (newRange == visibleRange)
+        return;
+
+    visibleRange = newRange;
+    waveformImage = {};
+    readWindowBounds = getReadWindowBounds();
+    updateGrainBounds();
+    invalidate(getLocalBounds());
+}
+
+void WaveformDisplay::visibilityChanged()
+{
+    // Only poll, and only have the audio thread gather grains, while the display is shown
+    audioProcessor.getGrainFeed().setActive(isVisible());
+
+    if (isVisible())
+    {
+        timerCallback();
+        startTimerHz(refreshRateHz);
+    }
+    else
+    {
+        stopTimer();
+    }
+}
+
+//==============================================================================
+void WaveformDisplay::timerCallback()
+{
+   #if GRANULAR_OPENGL
+    // Without a usable driver the renderer gives up, and the display paints itself again
+    if (cloudRenderer.isAttached() && cloudRenderer.hasFailed())
+    {
+        cloudRenderer.detach();
+        repaint();
+    }
+   #endif
+
+    // A new source, or the end of its analysis, brings a new overview and a full redraw
+    auto current = audioProcessor.getWaveformOverview();
+
+    if (current != overview)
+    {
+        overview = std::move(current);
+        visibleRange = overview != nullptr ? juce::Range<juce::int64>(0, overview->getLengthInSamples()) : juce::Range<juce::int64>();
+        waveformImage = {};
+        readWindowBounds = getReadWindowBounds();
+        updateGrainBounds();
+        invalidate(getLocalBounds());
+    }
+    else
+    {
+        // Otherwise only the strips the read window left or entered are repainted
+        const auto bounds = getReadWindowBounds();
+
+        if (bounds != readWindowBounds)
+        {
+            invalidate(readWindowBounds);
+            invalidate(bounds);
+            readWindowBounds = bounds;
+        }
+    }
+
+    // ... and the spots of the grains in the previous snapshot and the newest one
+    if (audioProcessor.getGrainFeed().readLatest(grainFrame))
+    {
+        for (const auto& grain : grainBounds)
+            invalidate(grain);
+
+        updateGrainBounds();
+
+        for (const auto& grain : grainBounds)
+            invalidate(grain);
+    }
+
+   #if GRANULAR_OPENGL
+    if (instancesInvalid && isRenderingWithOpenGL())
+        updateInstances();
+   #endif
+}
+
+void WaveformDisplay::invalidate(juce::Rectangle<int> area)
+{
+   #if GRANULAR_OPENGL
+    // The renderer redraws everything from one batch, so any change just rebuilds it once per frame
+    if (isRenderingWithOpenGL())
+    {
+        instancesInvalid = true;
+        return;
+    }
+   #endif
+
+    repaint(area);
+}
+
+bool WaveformDisplay::isRenderingWithOpenGL() const noexcept
+{
+   #if GRANULAR_OPENGL
+    return cloudRenderer.isAttached() && ! cloudRenderer.hasFailed();
+   #else
+    return false;
+   #endif
+}
+
+#if GRANULAR_OPENGL
+void WaveformDisplay::updateInstances()
+{
+    // The same layers paint() draws, back to front; the placeholder text is left to the editor's source label
+    instances.clear();
+
+    if (overview != nullptr)
+    {
+        forEachWaveformColumn([this](int x, float top, float bottom)
+        {
+            instances.emplace_back(juce::Rectangle<float>(static_cast<float>(x), top, 1.0f, bottom - top), juce::Colours::lightskyblue);
+        });
+
+        if (! readWindowBounds.isEmpty())
+        {
+            const auto window = readWindowBounds.toFloat();
+            instances.emplace_back(window, juce::Colours::orange.withAlpha(0.25f));
+            instances.emplace_back(window.withWidth(1.0f), juce::Colours::orange);
+            instances.emplace_back(window.withLeft(window.getRight() - 1.0f), juce::Colours::orange);
+            instances.emplace_back(window.withHeight(1.0f), juce::Colours::orange);
+            instances.emplace_back(window.withTop(window.getBottom() - 1.0f), juce::Colours::orange);
+        }
+    }
+
+    for (size_t i = 0; i < grainBounds.size(); ++i)
+        instances.emplace_back(grainBounds[i].toFloat(),
+                               juce::Colours::white.withAlpha(juce::jlimit(0.2f, 1.0f, grainFrame.grains[i].level)), true);
+
+    cloudRenderer.setInstances(instances, getLocalBounds());
+    instancesInvalid = false;
+}
+#endif
+
+juce::Rectangle<int> WaveformDisplay::getReadWindowBounds() const
+{
+    if (overview == nullptr)
+        return {};
+
+    // Grains start within spray of position across the whole source, as GrainScheduler places them
+    const auto length = static_cast<double>(overview->getLengthInSamples());
+    const auto centre = positionValue->load() * length;
+    const auto halfWidth = sprayValue->load() * length;
+
+    const auto left = sampleToX(static_cast<juce::int64>(juce::jmax(0.0, centre - halfWidth)));
+    const auto right = sampleToX(static_cast<juce::int64>(juce::jmin(length, centre + halfWidth)));
+
+    // At least one column, and nothing outside the component
+    return juce::Rectangle<int>::leftTopRightBottom(static_cast<int>(std::floor(left)), 0,
+                                                    static_cast<int>(std::ceil(right)) + 1, getHeight())
+        .getIntersection(getLocalBounds());
+}
+
+juce::Rectangle<int> WaveformDisplay::getGrainBounds(const GrainVisualFeed::Grain& grain) const noexcept
+{
+    // With a source file the grain follows the zoom; over the live input it spans the whole history
+    const auto x = overview != nullptr ? sampleToX(static_cast<juce::int64>(grain.position * static_cast<double>(overview->getLengthInSamples())))
+                                       : grain.position * static_cast<float>(getWidth());
+
+    const auto diameter = 3.0f + 6.0f * juce::jlimit(0.0f, 1.0f, grain.level);
+    const auto y = (0.5f + 0.5f * grain.pan) * (static_cast<float>(getHeight()) - diameter) + diameter * 0.5f;
+
+    return juce::Rectangle<float>(diameter, diameter).withCentre({ x, y }).getSmallestIntegerContainer();
+}
+
+void WaveformDisplay::updateGrainBounds()
+{
+    grainBounds.clear();
+
+    for (int i = 0; i < grainFrame.numGrains; ++i)
+        grainBounds.push_back(getGrainBounds(grainFrame.grains[static_cast<size_t>(i)]));
+}
+
+float WaveformDisplay::sampleToX(juce::int64 sample) const noexcept
+{
+    if (visibleRange.isEmpty())
+        return 0.0f;
+
+    return static_cast<float>(static_cast<double>(sample - visibleRange.getStart()) * getWidth()
+                              / static_cast<double>(visibleRange.getLength()));
+}
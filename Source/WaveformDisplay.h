@@ -0,0 +1,89 @@
+#pragma once
+
+#include "PluginProcessor.h"
+#include "WaveformOverview.h"
+
+#if GRANULAR_OPENGL
+ #include "GrainCloudRenderer.h"
+#endif
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include <vector>
+
+/**
+ * WaveformDisplay - Zoomable view of the loaded source, the region grains read from and the grains
+ * The waveform comes from the source's WaveformOverview, at the pyramid level that matches
+ * the zoom, and is drawn once into a cached image that is only redrawn when the source, the
+ * size or the zoom changes. A timer follows the position and spray parameters and drains the
+ * processor's GrainVisualFeed, then repaints just the strips of the read window that moved
+ * and the spots of the grains that moved, so even hour-long sources cost the message thread
+ * a few small blits per frame. Grains sit at their read position, higher for left and lower
+ * for right, and grow with their level. The feed only runs while the display is shown.
+ * The mouse wheel zooms around the pointer and a double click shows the whole source again.
+ * In builds with GRANULAR_OPENGL the same view is drawn by a GrainCloudRenderer instead, as
+ * one batch of instances rebuilt only when something moved; juce::Graphics takes over again
+ * if the renderer cannot run on the host's graphics driver.
+ */
+class WaveformDisplay : public juce::Component,
+                        private juce::Timer
+{
+public:
+    static constexpr int refreshRateHz = 30;
+    static constexpr double zoomStep = 1.25;   // Per wheel notch
+    static constexpr int minVisibleSamples = 1024;
+
+    explicit WaveformDisplay(GranularPlunderphonicsAudioProcessor& processorToUse);
+    ~WaveformDisplay() override;
+
+    //==============================================================================
+    void paint(juce::Graphics&) override;
+    void resized() override;
+
+    void mouseWheelMove(const juce::MouseEvent&, const juce::MouseWheelDetails&) override;
+    void mouseDoubleClick(const juce::MouseEvent&) override;
+
+    void visibilityChanged() override;
+
+private:
+    //==============================================================================
+    void timerCallback() override;
+
+    template <typename ColumnFunction>
+    void forEachWaveformColumn(ColumnFunction&& function) const;
+
+    void renderWaveform();
+    void invalidate(juce::Rectangle<int> area);
+    bool isRenderingWithOpenGL() const noexcept;
+    void setVisibleRange(juce::Range<juce::int64> newRange);
+    juce::Rectangle<int> getReadWindowBounds() const;
+    juce::Rectangle<int> getGrainBounds(const GrainVisualFeed::Grain& grain) const noexcept;
+    void updateGrainBounds();
+
+   #if GRANULAR_OPENGL
+    void updateInstances();
+   #endif
+
+    float sampleToX(juce::int64 sample) const noexcept;
+
+    //==============================================================================
+    GranularPlunderphonicsAudioProcessor& audioProcessor;
+    const std::atomic<float>* positionValue = nullptr;
+    const std::atomic<float>* sprayValue = nullptr;
+
+    std::shared_ptr<const WaveformOverview> overview;
+    juce::Range<juce::int64> visibleRange;   // Source samples across the width
+    juce::Image waveformImage;               // Invalid whenever it needs rendering again
+    juce::Rectangle<int> readWindowBounds;   // Where the read window was last painted
+
+    GrainVisualFeed::Frame grainFrame;
+    std::vector<juce::Rectangle<int>> grainBounds;   // Where each grain of grainFrame is painted
+
+   #if GRANULAR_OPENGL
+    std::vector<GrainCloudRenderer::Instance> instances;   // Reused between frames
+    bool instancesInvalid = true;
+    GrainCloudRenderer cloudRenderer;                      // Last, so it detaches before the rest goes
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformDisplay)
+};
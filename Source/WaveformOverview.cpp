@@ -0,0 +1,139 @@
+#include "WaveformOverview.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr float peakScale = 127.0f;
+
+    WaveformOverview::Peak combine(WaveformOverview::Peak a, WaveformOverview::Peak b) noexcept
+    {
+        return { std::min(a.minimum, b.minimum), std::max(a.maximum, b.maximum) };
+    }
+}
+
+//==============================================================================
+WaveformOverview::Builder::Builder(juce::int64 expectedLengthInSamples)
+{
+    if (expectedLengthInSamples > 0)
+        basePeaks.reserve(static_cast<size_t>(expectedLengthInSamples / baseSamplesPerPeak + 1));
+}
+
+void WaveformOverview::Builder::addPendingPeak()
+{
+    // Rounding outwards keeps quiet detail visible rather than flattening it to zero
+    const auto quantise = [](float scaled) { return static_cast<juce::int8>(juce::jlimit(-peakScale, peakScale, scaled)); };
+
+    basePeaks.push_back({ quantise(std::floor(low * peakScale)), quantise(std::ceil(high * peakScale)) });
+    lengthInSamples += numPending;
+    numPending = 0;
+}
+
+std::unique_ptr<WaveformOverview> WaveformOverview::Builder::build()
+{
+    if (numPending > 0)
+        addPendingPeak();
+
+    return std::make_unique<WaveformOverview>(std::move(basePeaks), lengthInSamples);
+}
+
+//==============================================================================
+WaveformOverview::WaveformOverview(std::vector<Peak> basePeaks, juce::int64 lengthInSamplesToUse)
+    : lengthInSamples(lengthInSamplesToUse)
+{
+    levels.push_back(std::move(basePeaks));
+
+    while (levels.back().size() > 1)
+    {
+        const auto& finer = levels.back();
+        std::vector<Peak> coarser((finer.size() + levelRatio - 1) / levelRatio);
+
+        for (size_t i = 0; i < finer.size(); ++i)
+            coarser[i / levelRatio] = i % levelRatio == 0 ? finer[i] : combine(coarser[i / levelRatio], finer[i]);
+
+        levels.push_back(std::move(coarser));
+    }
+}
+
+juce::int64 WaveformOverview::getSamplesPerPeak(int level) const noexcept
+{
+    auto samplesPerPeak = static_cast<juce::int64>(baseSamplesPerPeak);
+
+    for (int i = 0; i < level; ++i)
+        samplesPerPeak *= levelRatio;
+
+    return samplesPerPeak;
+}
+
+int WaveformOverview::getLevelFor(double samplesPerPixel) const noexcept
+{
+    int level = 0;
+
+    while (level + 1 < getNumLevels() && static_cast<double>(getSamplesPerPeak(level + 1)) <= samplesPerPixel)
+        ++level;
+
+    return level;
+}
+
+juce::Range<float> WaveformOverview::getRange(int level, juce::int64 start, juce::int64 end) const noexcept
+{
+    const auto& peaks = levels[static_cast<size_t>(juce::jlimit(0, getNumLevels() - 1, level))];
+    const auto samplesPerPeak = getSamplesPerPeak(level);
+    const auto numPeaks = static_cast<juce::int64>(peaks.size());
+
+    const auto first = juce::jlimit<juce::int64>(0, numPeaks, start / samplesPerPeak);
+    const auto last = juce::jlimit<juce::int64>(0, numPeaks, (end + samplesPerPeak - 1) / samplesPerPeak);
+
+    if (first >= last)
+        return {};
+
+    auto peak = peaks[static_cast<size_t>(first)];
+
+    for (auto i = first + 1; i < last; ++i)
+        peak = combine(peak, peaks[static_cast<size_t>(i)]);
+
+    return { peak.minimum / peakScale, peak.maximum / peakScale };
+}
+
+//==============================================================================
+juce::MemoryBlock WaveformOverview::toCacheData() const
+{
+    // The coarser levels take a third of the base level's size again and rebuild in no time
+    juce::MemoryOutputStream stream;
+    stream.writeInt64(lengthInSamples);
+
+    for (const auto& peak : levels.front())
+    {
+        stream.writeByte(static_cast<char>(peak.minimum));
+        stream.writeByte(static_cast<char>(peak.maximum));
+    }
+
+    return stream.getMemoryBlock();
+}
+
+std::unique_ptr<WaveformOverview> WaveformOverview::fromCacheData(const void* data, size_t size)
+{
+    if (data == nullptr || size < sizeof(juce::int64) || (size - sizeof(juce::int64)) % 2 != 0)
+        return nullptr;
+
+    const auto* bytes = static_cast<const char*>(data);
+    const auto length = static_cast<juce::int64>(juce::ByteOrder::littleEndianInt64(bytes));
+    const auto numPeaks = (size - sizeof(juce::int64)) / 2;
+
+    if (length < 0 || static_cast<juce::int64>(numPeaks) != (length + baseSamplesPerPeak - 1) / baseSamplesPerPeak)
+        return nullptr;
+
+    std::vector<Peak> basePeaks(numPeaks);
+
+    for (size_t i = 0; i < numPeaks; ++i)
+    {
+        basePeaks[i].minimum = static_cast<juce::int8>(bytes[sizeof(juce::int64) + 2 * i]);
+        basePeaks[i].maximum = static_cast<juce::int8>(bytes[sizeof(juce::int64) + 2 * i + 1]);
+
+        if (basePeaks[i].minimum > basePeaks[i].maximum)
+            return nullptr;
+    }
+
+    return std::make_unique<WaveformOverview>(std::move(basePeaks), length);
+}
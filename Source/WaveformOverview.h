@@ -0,0 +1,92 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+/**
+ * WaveformOverview - Min/max peak pyramid of one source file, for drawing it at any zoom
+ * The finest level holds the lowest and highest sample of every baseSamplesPerPeak, and each
+ * coarser level combines levelRatio peaks of the one below, down to a single peak. A display
+ * picks the level whose peaks are just finer than its pixels, so drawing any view of an
+ * hour-long source reads a few peaks per pixel and never touches the audio. Peaks are stored
+ * as 8-bit values rounded outwards, which is ample for pixels and keeps an hour at 48 kHz
+ * under 2 MB. Overviews are immutable once built; the base level is kept in the AnalysisCache.
+ */
+class WaveformOverview
+{
+public:
+    //==============================================================================
+    static constexpr int baseSamplesPerPeak = 256;
+    static constexpr int levelRatio = 4;
+
+    /** The range of a span of samples, in 127ths of full scale. */
+    struct Peak
+    {
+        juce::int8 minimum = 0;
+        juce::int8 maximum = 0;
+    };
+
+    /** Collects the base level one sample at a time, e.g. during onset analysis. */
+    class Builder
+    {
+    public:
+        /** The length is only a hint for reserving the base level. */
+        explicit Builder(juce::int64 expectedLengthInSamples = 0);
+
+        void addSample(float sample) noexcept
+        {
+            low = numPending > 0 ? std::min(low, sample) : sample;
+            high = numPending > 0 ? std::max(high, sample) : sample;
+
+            if (++numPending == baseSamplesPerPeak)
+                addPendingPeak();
+        }
+
+        /** Builds the pyramid over every sample added so far. */
+        std::unique_ptr<WaveformOverview> build();
+
+    private:
+        void addPendingPeak();
+
+        std::vector<Peak> basePeaks;
+        juce::int64 lengthInSamples = 0;
+        float low = 0.0f, high = 0.0f;
+        int numPending = 0;
+
+        JUCE_DECLARE_NON_COPYABLE(Builder)
+    };
+
+    //==============================================================================
+    /** Builds the coarser levels above basePeaks. */
+    WaveformOverview(std::vector<Peak> basePeaks, juce::int64 lengthInSamples);
+
+    juce::int64 getLengthInSamples() const noexcept { return lengthInSamples; }
+
+    int getNumLevels() const noexcept { return static_cast<int>(levels.size()); }
+    int getNumPeaks(int level) const noexcept { return static_cast<int>(levels[static_cast<size_t>(level)].size()); }
+    const Peak* getPeaks(int level) const noexcept { return levels[static_cast<size_t>(level)].data(); }
+    juce::int64 getSamplesPerPeak(int level) const noexcept;
+
+    /** The coarsest level whose peaks each cover no more than samplesPerPixel, or level 0. */
+    int getLevelFor(double samplesPerPixel) const noexcept;
+
+    /** The lowest and highest sample in [start, end), from -1 to 1, read from level. */
+    juce::Range<float> getRange(int level, juce::int64 start, juce::int64 end) const noexcept;
+
+    //==============================================================================
+    /** The AnalysisCache section: the source length as a little-endian int64, then the base level. */
+    juce::MemoryBlock toCacheData() const;
+
+    /** Returns nullptr if the data is not a valid section. */
+    static std::unique_ptr<WaveformOverview> fromCacheData(const void* data, size_t size);
+
+private:
+    //==============================================================================
+    std::vector<std::vector<Peak>> levels;   // Finest first
+    juce::int64 lengthInSamples = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformOverview)
+};
@@ -3,6 +3,10 @@
 
 #include "PluginProcessor.h"
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 TEST_CASE("Plugin initialization", "[processor]")
 {
     // Create an instance of the processor
@@ -15,7 +19,7 @@ TEST_CASE("Plugin initialization", "[processor]")
     
     SECTION("MIDI capabilities are correctly reported")
     {
-        REQUIRE_FALSE(processor.acceptsMidi());
+        REQUIRE(processor.acceptsMidi());
         REQUIRE_FALSE(processor.producesMidi());
         REQUIRE_FALSE(processor.isMidiEffect());
     }
@@ -29,10 +33,30 @@ TEST_CASE("Plugin initialization", "[processor]")
         
         REQUIRE(processor.isBusesLayoutSupported(layout));
         
-        // Test stereo input to stereo output (should not be supported)
+        // Stereo and multichannel inputs are mixed down for the grains
         layout.inputBuses.clear();
         layout.inputBuses.add(juce::AudioChannelSet::stereo());
         
+        REQUIRE(processor.isBusesLayoutSupported(layout));
+
+        // Surround and ambisonic outputs are panned over, but a mono output has nothing to pan across
+        for (const auto& output : { juce::AudioChannelSet::quadraphonic(), juce::AudioChannelSet::create5point1(),
+                                    juce::AudioChannelSet::create7point1(), juce::AudioChannelSet::ambisonic(2) })
+        {
+            layout.outputBuses.clear();
+            layout.outputBuses.add(output);
+            REQUIRE(processor.isBusesLayoutSupported(layout));
+        }
+
+        layout.outputBuses.clear();
+        layout.outputBuses.add(juce::AudioChannelSet::mono());
+        REQUIRE_FALSE(processor.isBusesLayoutSupported(layout));
+
+        // A disabled input leaves nothing to granulate
+        layout.outputBuses.clear();
+        layout.outputBuses.add(juce::AudioChannelSet::stereo());
+        layout.inputBuses.clear();
+        layout.inputBuses.add(juce::AudioChannelSet::disabled());
         REQUIRE_FALSE(processor.isBusesLayoutSupported(layout));
     }
 }
@@ -94,4 +118,399 @@ TEST_CASE("Audio processing functionality", "[processor]")
         
         REQUIRE(signalIntegrityMaintained);
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Audio thread telemetry", "[processor]")
+{
+    SECTION("Block loads are measured against the real-time budget")
+    {
+        PerformanceMonitor monitor;
+        monitor.prepare(48000.0);
+
+        // 480 samples at 48 kHz is a 10 ms budget
+        monitor.recordBlock(0.0022, 480, 12, 5, 0);
+        monitor.recordBlock(0.015, 480, 40, 8, 1);
+
+        auto statistics = monitor.getStatistics();
+        REQUIRE(statistics.numBlocks == 2);
+        REQUIRE(statistics.numOverruns == 1);
+        REQUIRE(statistics.lastLoad == Approx(1.5f));
+        REQUIRE(statistics.peakLoad == Approx(1.5f));
+        REQUIRE(statistics.histogram[4] == 1);
+        REQUIRE(statistics.histogram[PerformanceMonitor::numBuckets - 1] == 1);
+        REQUIRE(statistics.peakActiveGrains == 40);
+
+        // Cumulative counters are reported relative to the first block
+        REQUIRE(statistics.cacheMisses == 3);
+        REQUIRE(statistics.renderTimeouts == 1);
+
+        monitor.requestReset();
+        monitor.recordBlock(0.001, 480, 0, 8, 1);
+
+        statistics = monitor.getStatistics();
+        REQUIRE(statistics.numBlocks == 1);
+        REQUIRE(statistics.numOverruns == 0);
+        REQUIRE(statistics.cacheMisses == 0);
+    }
+
+    SECTION("Every processed block is recorded")
+    {
+        GranularPlunderphonicsAudioProcessor processor;
+        processor.prepareToPlay(44100.0, 256);
+
+        juce::AudioBuffer<float> buffer(2, 256);
+        juce::MidiBuffer midiBuffer;
+
+        for (int block = 0; block < 10; ++block)
+        {
+            buffer.clear();
+            processor.processBlock(buffer, midiBuffer);
+        }
+
+        const auto statistics = processor.getPerformanceStatistics();
+        REQUIRE(statistics.numBlocks == 10);
+
+        juce::uint32 histogramTotal = 0;
+
+        for (auto count : statistics.histogram)
+            histogramTotal += count;
+
+        REQUIRE(histogramTotal == 10);
+        REQUIRE(statistics.activeGrains == processor.getNumActiveGrains());
+    }
+}
+
+TEST_CASE("Reproducible renders", "[processor]")
+{
+    constexpr int blockSize = 256;
+
+    // Renders a fully wet, sprayed cloud over a fixed input from a freshly prepared processor
+    const auto render = [](juce::int64 seed)
+    {
+        GranularPlunderphonicsAudioProcessor processor;
+        const auto& parameters = processor.getParameters();
+        parameters[ParameterSnapshot::mix]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::spray]->setValueNotifyingHost(1.0f);
+        processor.setRandomSeed(seed);
+        processor.prepareToPlay(48000.0, blockSize);
+
+        juce::AudioBuffer<float> buffer(2, blockSize);
+        juce::MidiBuffer midi;
+        std::vector<float> output;
+
+        for (int block = 0; block < 100; ++block)
+        {
+            buffer.clear();
+
+            for (int i = 0; i < blockSize; ++i)
+                buffer.setSample(0, i, std::sin(0.01f * static_cast<float>(block * blockSize + i)));
+
+            processor.processBlock(buffer, midi);
+            output.insert(output.end(), buffer.getReadPointer(0), buffer.getReadPointer(0) + blockSize);
+            output.insert(output.end(), buffer.getReadPointer(1), buffer.getReadPointer(1) + blockSize);
+        }
+
+        return output;
+    };
+
+    SECTION("The same seed renders the same samples, and another seed other ones")
+    {
+        const auto first = render(7);
+
+        REQUIRE(render(7) == first);
+        REQUIRE(render(8) != first);
+        REQUIRE(std::any_of(first.begin(), first.end(), [](float sample) { return sample != 0.0f; }));
+    }
+}
+
+TEST_CASE("Offline renders", "[processor]")
+{
+    using Processor = GranularPlunderphonicsAudioProcessor;
+    constexpr int blockSize = 256;
+
+    Processor processor;
+    processor.getParameters()[ParameterSnapshot::mix]->setValueNotifyingHost(0.0f);
+
+    SECTION("Live playback runs at the host's block size without latency")
+    {
+        processor.prepareToPlay(48000.0, blockSize);
+        REQUIRE(processor.getLatencySamples() == 0);
+    }
+
+    SECTION("Small offline blocks are gathered into whole batches, one batch late")
+    {
+        processor.setNonRealtime(true);
+        processor.prepareToPlay(48000.0, blockSize);
+        REQUIRE(processor.getLatencySamples() == Processor::batchBlockSize);
+
+        constexpr int impulseAt = 100;
+        constexpr int numBlocks = Processor::batchBlockSize / blockSize + 2;
+        juce::AudioBuffer<float> buffer(2, blockSize);
+        juce::MidiBuffer midi;
+        std::vector<float> output;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            buffer.clear();
+
+            if (block == 0)
+                buffer.setSample(0, impulseAt, 1.0f);
+
+            processor.processBlock(buffer, midi);
+            output.insert(output.end(), buffer.getReadPointer(0), buffer.getReadPointer(0) + blockSize);
+        }
+
+        const auto delayedImpulse = output.begin() + impulseAt + Processor::batchBlockSize;
+
+        REQUIRE(std::all_of(output.begin(), delayedImpulse, [](float sample) { return sample == 0.0f; }));
+        REQUIRE(*delayedImpulse == Approx(0.5f));
+    }
+
+    SECTION("Offline blocks of a whole batch or more are rendered as they come")
+    {
+        processor.setNonRealtime(true);
+        processor.prepareToPlay(48000.0, Processor::batchBlockSize);
+        REQUIRE(processor.getLatencySamples() == 0);
+    }
+}
+
+TEST_CASE("MIDI events", "[processor]")
+{
+    constexpr int blockSize = 512;
+
+    GranularPlunderphonicsAudioProcessor processor;
+    const auto& parameters = processor.getParameters();
+
+    // Fully wet, with the density clock too slow to spawn a second grain during the test
+    parameters[ParameterSnapshot::mix]->setValueNotifyingHost(1.0f);
+    parameters[ParameterSnapshot::density]->setValueNotifyingHost(0.0f);
+    processor.prepareToPlay(48000.0, blockSize);
+
+    juce::AudioBuffer<float> buffer(2, blockSize);
+    juce::MidiBuffer midi;
+
+    const auto processInput = [&]
+    {
+        buffer.clear();
+        juce::FloatVectorOperations::fill(buffer.getWritePointer(0), 0.5f, blockSize);
+        processor.processBlock(buffer, midi);
+    };
+
+    // Let the one grain the clock spawns at the start finish
+    for (int block = 0; block < 20; ++block)
+        processInput();
+
+    REQUIRE(processor.getNumActiveGrains() == 0);
+
+    SECTION("Notes trigger grains at their exact sample")
+    {
+        constexpr int noteOffset = 300;
+        midi.addEvent(juce::MidiMessage::noteOn(1, GranularPlunderphonicsAudioProcessor::untransposedNote, 1.0f), noteOffset);
+        processInput();
+
+        REQUIRE(processor.getNumActiveGrains() == 1);
+
+        float before = 0.0f, after = 0.0f;
+
+        for (int i = 0; i < blockSize; ++i)
+        {
+            auto& peak = i < noteOffset ? before : after;
+            peak = std::max(peak, std::abs(buffer.getSample(0, i)) + std::abs(buffer.getSample(1, i)));
+        }
+
+        REQUIRE(before == 0.0f);
+        REQUIRE(after > 0.0f);
+    }
+
+    SECTION("Each note plays a voice until its note-off has faded it out")
+    {
+        midi.addEvent(juce::MidiMessage::noteOn(1, 60, 1.0f), 10);
+        midi.addEvent(juce::MidiMessage::noteOn(1, 67, 1.0f), 20);
+        processInput();
+        REQUIRE(processor.getNumActiveVoices() == 2);
+
+        midi.clear();
+        midi.addEvent(juce::MidiMessage::noteOff(1, 60), 0);
+        midi.addEvent(juce::MidiMessage::noteOn(1, 67, 0.0f), 0);
+
+        const auto releaseBlocks = static_cast<int>(GrainVoiceAllocator::releaseSeconds * 48000.0) / blockSize + 1;
+
+        for (int block = 0; block <= releaseBlocks; ++block)
+        {
+            processInput();
+            midi.clear();
+        }
+
+        REQUIRE(processor.getNumActiveVoices() == 0);
+    }
+
+    SECTION("Controllers move parameters until the host does")
+    {
+        using Parameter = ParameterSnapshot::Parameter;
+        const auto& snapshot = processor.getParameterSnapshot();
+
+        midi.addEvent(juce::MidiMessage::controllerEvent(1, GranularPlunderphonicsAudioProcessor::parameterControllers[ParameterSnapshot::spray],
+                                                         127), 100);
+        processInput();
+        REQUIRE(snapshot[Parameter::spray] == Approx(1.0f));
+
+        midi.clear();
+        processInput();
+        REQUIRE(snapshot[Parameter::spray] == Approx(1.0f));
+
+        parameters[ParameterSnapshot::spray]->setValueNotifyingHost(0.25f);
+        processInput();
+        REQUIRE(snapshot[Parameter::spray] == Approx(0.25f));
+    }
+
+    SECTION("Every parameter has a controller of its own below the channel mode messages")
+    {
+        using Processor = GranularPlunderphonicsAudioProcessor;
+        const auto& snapshot = processor.getParameterSnapshot();
+
+        for (int parameter = 0; parameter < ParameterSnapshot::numParameters; ++parameter)
+        {
+            const auto controller = Processor::parameterControllers[static_cast<size_t>(parameter)];
+
+            REQUIRE(controller < 120);
+            REQUIRE(Processor::getControllerParameter(controller) == parameter);
+        }
+
+        REQUIRE(Processor::getControllerParameter(120) == -1);
+
+        midi.addEvent(juce::MidiMessage::controllerEvent(1, Processor::parameterControllers[ParameterSnapshot::downsample], 127), 0);
+        processInput();
+        REQUIRE(snapshot[ParameterSnapshot::downsample] == Approx(1.0f));
+    }
+}
+
+TEST_CASE("Real-time safety", "[processor]")
+{
+    if (! RealtimeGuard::isEnabled)
+    {
+        WARN("Built without GRANULAR_REALTIME_GUARD; real-time safety is not checked");
+        return;
+    }
+
+    // Count instead of asserting, so the test can report what it found
+    RealtimeGuard::setTrapOnViolation(false);
+    RealtimeGuard::resetViolations();
+
+    SECTION("The guard traps allocation, locking and file access in a real-time section")
+    {
+        juce::uint32 allocations = 0, locks = 0, fileAccesses = 0;
+
+        {
+            const RealtimeGuard::ScopedRealtimeSection realtimeSection;
+
+            std::vector<float> resized;
+            resized.resize(64);
+            allocations = RealtimeGuard::getNumViolations(RealtimeGuard::Violation::allocation);
+
+            juce::CriticalSection lock;
+            lock.enter();
+            lock.exit();
+            locks = RealtimeGuard::getNumViolations(RealtimeGuard::Violation::lock);
+
+            juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("realtime-guard-probe").exists();
+            juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("realtime-guard-probe").loadFileAsString();
+            fileAccesses = RealtimeGuard::getNumViolations(RealtimeGuard::Violation::fileAccess);
+        }
+
+        REQUIRE(allocations > 0);
+
+       #if defined(__GLIBC__)
+        REQUIRE(locks > 0);
+        REQUIRE(fileAccesses > 0);
+       #endif
+
+        // Outside the section the same calls are fine
+        RealtimeGuard::resetViolations();
+        std::vector<float> resized(64);
+        REQUIRE(RealtimeGuard::getTotalViolations() == 0);
+    }
+
+    SECTION("processBlock neither allocates, locks nor touches files under a dense cloud")
+    {
+        GranularPlunderphonicsAudioProcessor processor;
+        const auto& parameters = processor.getParameters();
+
+        parameters[ParameterSnapshot::mix]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::density]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::spray]->setValueNotifyingHost(0.5f);
+        parameters[ParameterSnapshot::pitch]->setValueNotifyingHost(0.6f);
+        parameters[ParameterSnapshot::envelope]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::quality]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::multiCore]->setValueNotifyingHost(1.0f);
+
+        processor.prepareToPlay(48000.0, 256);
+
+        juce::AudioBuffer<float> buffer(2, 256);
+        juce::MidiBuffer midiBuffer;
+        juce::Random random(1);
+
+        // Every block also splits at a triggered note and a parameter controller
+        midiBuffer.addEvent(juce::MidiMessage::noteOn(1, 72, 0.8f), 40);
+        midiBuffer.addEvent(juce::MidiMessage::controllerEvent(1, GranularPlunderphonicsAudioProcessor::parameterControllers[ParameterSnapshot::spray],
+                                                               90), 130);
+
+        RealtimeGuard::resetViolations();
+
+        for (int block = 0; block < 200; ++block)
+        {
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                buffer.setSample(0, i, random.nextFloat() * 2.0f - 1.0f);
+
+            processor.processBlock(buffer, midiBuffer);
+        }
+
+        REQUIRE(processor.getNumActiveGrains() > 0);
+        REQUIRE(RealtimeGuard::getNumViolations(RealtimeGuard::Violation::allocation) == 0);
+        REQUIRE(RealtimeGuard::getNumViolations(RealtimeGuard::Violation::deallocation) == 0);
+        REQUIRE(RealtimeGuard::getNumViolations(RealtimeGuard::Violation::lock) == 0);
+        REQUIRE(RealtimeGuard::getNumViolations(RealtimeGuard::Violation::fileAccess) == 0);
+
+        processor.releaseResources();
+    }
+
+    SECTION("processBlock stays real-time safe while crossfading to the spectral engine")
+    {
+        GranularPlunderphonicsAudioProcessor processor;
+        const auto& parameters = processor.getParameters();
+
+        parameters[ParameterSnapshot::mix]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::smear]->setValueNotifyingHost(0.5f);
+        parameters[ParameterSnapshot::shuffle]->setValueNotifyingHost(0.3f);
+
+        processor.prepareToPlay(48000.0, 256);
+
+        juce::AudioBuffer<float> buffer(2, 256);
+        juce::MidiBuffer midiBuffer;
+        juce::Random random(1);
+
+        RealtimeGuard::resetViolations();
+
+        for (int block = 0; block < 200; ++block)
+        {
+            // Switch engines, then freeze, part of the way through
+            if (block == 20)
+                parameters[ParameterSnapshot::mode]->setValueNotifyingHost(1.0f);
+
+            if (block == 100)
+                parameters[ParameterSnapshot::freeze]->setValueNotifyingHost(1.0f);
+
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                buffer.setSample(0, i, random.nextFloat() * 2.0f - 1.0f);
+
+            processor.processBlock(buffer, midiBuffer);
+        }
+
+        REQUIRE(processor.getNumActiveGrains() == 0);
+        REQUIRE(buffer.getMagnitude(0, 0, buffer.getNumSamples()) > 0.0f);
+        REQUIRE(RealtimeGuard::getTotalViolations() == 0);
+
+        processor.releaseResources();
+    }
+
+    RealtimeGuard::setTrapOnViolation(true);
+}
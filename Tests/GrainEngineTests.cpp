@@ -0,0 +1,1078 @@
+#include "catch.hpp"
+
+#include "GrainEffects.h"
+#include "GrainEnvelopeTable.h"
+#include "GrainPool.h"
+#include "GrainRandom.h"
+#include "GrainRenderPool.h"
+#include "GrainResampler.h"
+#include "GrainScheduler.h"
+#include "GrainSpatialiser.h"
+#include "GrainVisualFeed.h"
+#include "GrainVoiceAllocator.h"
+#include "InputCaptureBuffer.h"
+#include "SpectralGrainEngine.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+TEST_CASE("Grain pool management", "[grains]")
+{
+    GrainPool pool;
+    pool.prepare(5, 4);
+
+    SECTION("Pool hands out exactly its capacity")
+    {
+        for (int i = 0; i < 5; ++i)
+            REQUIRE(pool.spawn() == i);
+
+        REQUIRE(pool.getNumActive() == 5);
+        REQUIRE(pool.spawn() == -1);
+    }
+
+    SECTION("Retiring keeps every attribute array densely packed")
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            const auto index = pool.spawn();
+            pool.getReadPositions()[index] = static_cast<double>(i);
+            pool.getGains()[index] = static_cast<float>(i) * 0.5f;
+            pool.getChannelGains()[index][3] = static_cast<float>(i);
+        }
+
+        pool.retire(0);
+
+        REQUIRE(pool.getNumActive() == 2);
+        REQUIRE(pool.getReadPositions()[0] == Approx(2.0));
+        REQUIRE(pool.getGains()[0] == Approx(1.0f));
+        REQUIRE(pool.getChannelGains()[0][3] == Approx(2.0f));
+        REQUIRE(pool.getReadPositions()[1] == Approx(1.0));
+    }
+
+    SECTION("Attribute arrays are SIMD aligned")
+    {
+        auto address = reinterpret_cast<std::uintptr_t>(pool.getEnvelopePhases());
+        REQUIRE(address % AlignedBuffer<float>::alignment == 0);
+    }
+
+    SECTION("Re-preparing for fewer grains keeps the arrays")
+    {
+        const auto* readPositions = pool.getReadPositions();
+        pool.spawn();
+
+        REQUIRE_FALSE(pool.needsToGrow(3, 4));
+        pool.prepare(3, 4);
+
+        REQUIRE(pool.getReadPositions() == readPositions);
+        REQUIRE(pool.getCapacity() == 3);
+        REQUIRE(pool.getNumActive() == 0);
+        REQUIRE(pool.needsToGrow(64, 4));
+    }
+}
+
+TEST_CASE("Input capture history", "[grains]")
+{
+    InputCaptureBuffer capture;
+    capture.prepare(8);
+
+    std::vector<float> input { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f };
+    capture.write(input.data(), 6);
+    capture.write(input.data(), 6);
+
+    SECTION("Only the newest samples stay readable")
+    {
+        auto readable = capture.getReadableRange();
+        REQUIRE(readable.getStart() == 4);
+        REQUIRE(readable.getEnd() == 12);
+    }
+
+    SECTION("Reads wrap around the history and return silence outside it")
+    {
+        std::vector<float> output(6, -1.0f);
+        capture.readSamples(output.data(), 9, 6);
+
+        REQUIRE(output[0] == Approx(4.0f));
+        REQUIRE(output[2] == Approx(6.0f));
+        REQUIRE(output[3] == Approx(0.0f));
+        REQUIRE(output[5] == Approx(0.0f));
+    }
+}
+
+TEST_CASE("Seeded random generator", "[grains]")
+{
+    GrainRandom random(1234);
+
+    SECTION("A seed always gives the same sequence, and other seeds others")
+    {
+        GrainRandom same(1234), other(1235);
+        int numDiffering = 0;
+
+        // Long enough to refill the buffer several times
+        for (int i = 0; i < 4 * GrainRandom::bufferSize + 7; ++i)
+        {
+            const auto bits = random.nextBits();
+            REQUIRE(same.nextBits() == bits);
+            numDiffering += other.nextBits() != bits ? 1 : 0;
+        }
+
+        REQUIRE(numDiffering > 4 * GrainRandom::bufferSize);
+
+        random.setSeed(1234);
+        same.setSeed(1234);
+        REQUIRE(random.nextDouble() == same.nextDouble());
+    }
+
+    SECTION("Block fills match single draws")
+    {
+        GrainRandom single(1234);
+        std::vector<float> block(3 * GrainRandom::bufferSize + 5);
+
+        // Starts part way through a buffer, so the fill crosses refills
+        REQUIRE(random.nextFloat() == single.nextFloat());
+        random.fillFloats(block.data(), static_cast<int>(block.size()));
+
+        for (auto value : block)
+            REQUIRE(value == single.nextFloat());
+    }
+
+    SECTION("Values are uniform over their ranges")
+    {
+        constexpr int numDraws = 100000;
+        std::array<int, 10> counts {};
+        double sum = 0.0;
+        int minInt = 1000, maxInt = -1;
+
+        for (int i = 0; i < numDraws; ++i)
+        {
+            const auto value = random.nextFloat();
+            REQUIRE(value >= 0.0f);
+            REQUIRE(value < 1.0f);
+            ++counts[static_cast<size_t>(value * 10.0f)];
+
+            const auto fine = random.nextDouble();
+            REQUIRE(fine >= 0.0);
+            REQUIRE(fine < 1.0);
+            sum += fine;
+
+            const auto integer = random.nextInt(65);
+            minInt = std::min(minInt, integer);
+            maxInt = std::max(maxInt, integer);
+        }
+
+        for (auto count : counts)
+            REQUIRE(count == Approx(numDraws / 10).epsilon(0.05));
+
+        REQUIRE(sum / numDraws == Approx(0.5).epsilon(0.01));
+        REQUIRE(minInt == 0);
+        REQUIRE(maxInt == 64);
+    }
+}
+
+TEST_CASE("Grain scheduling", "[grains]")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 64;
+
+    GrainScheduler scheduler;
+    scheduler.prepare(sampleRate, blockSize, 1000.0f);
+
+    InputCaptureBuffer capture;
+    capture.prepare(static_cast<int>(sampleRate));
+
+    std::vector<float> input(blockSize, 0.5f);
+    std::vector<float> left(blockSize), right(blockSize);
+
+    SECTION("Pool is sized for the maximum density")
+    {
+        // 1000 grains per second lasting up to one second each
+        REQUIRE(scheduler.getGrainCapacity() >= 1000);
+    }
+
+    SECTION("Vector rendering matches linear interpolation of the source")
+    {
+        // A ramp through the history makes every interpolated value predictable
+        std::vector<float> ramp(blockSize * 4);
+
+        for (size_t i = 0; i < ramp.size(); ++i)
+            ramp[i] = static_cast<float>(i) / static_cast<float>(ramp.size());
+
+        capture.write(ramp.data(), static_cast<int>(ramp.size()));
+
+        GrainScheduler::Settings settings;
+        settings.density = 0.1f;
+        settings.grainSizeMs = 1000.0f;
+        settings.position = 0.0f;
+        settings.spray = 0.0f;
+        settings.playbackRate = GrainScheduler::getPlaybackRate(12.0f, 1.0f);
+        settings.resamplerQuality = ResamplerQuality::linear;
+
+        scheduler.process(settings, capture, left.data(), right.data(), blockSize);
+
+        // A Hann-windowed ramp read at double speed, split across both channels by the pan law
+        for (int i = 1; i < blockSize; ++i)
+        {
+            const auto phase = static_cast<float>(i) / static_cast<float>(sampleRate);
+            const auto envelope = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * phase);
+            const auto expected = 2.0f * static_cast<float>(i) / static_cast<float>(ramp.size()) * envelope;
+            const auto rendered = std::sqrt(left[i] * left[i] + right[i] * right[i]);
+
+            REQUIRE(rendered == Approx(expected).margin(1e-6));
+        }
+    }
+
+    SECTION("Grains spawn, sound and retire")
+    {
+        GrainScheduler::Settings settings;
+        settings.density = 1000.0f;
+        settings.grainSizeMs = 10.0f;
+
+        float peak = 0.0f;
+        int maxActive = 0;
+
+        for (int block = 0; block < 200; ++block)
+        {
+            std::fill(left.begin(), left.end(), 0.0f);
+            std::fill(right.begin(), right.end(), 0.0f);
+
+            capture.write(input.data(), blockSize);
+            scheduler.process(settings, capture, left.data(), right.data(), blockSize);
+
+            maxActive = std::max(maxActive, scheduler.getNumActiveGrains());
+
+            for (int i = 0; i < blockSize; ++i)
+                peak = std::max(peak, std::abs(left[i]) + std::abs(right[i]));
+        }
+
+        // 10 ms grains at 1000 grains per second overlap roughly ten deep
+        REQUIRE(maxActive >= 8);
+        REQUIRE(maxActive <= 12);
+        REQUIRE(peak > 0.0f);
+    }
+
+    SECTION("Seeded alike, schedulers make the same grains")
+    {
+        GrainScheduler other;
+        other.prepare(sampleRate, blockSize, 1000.0f);
+        scheduler.setRandomSeed(42);
+        other.setRandomSeed(42);
+
+        GrainScheduler::Settings settings;
+        settings.density = 500.0f;
+        settings.grainSizeMs = 20.0f;
+        settings.spray = 1.0f;
+
+        std::vector<float> otherLeft(blockSize), otherRight(blockSize);
+        float peak = 0.0f;
+
+        for (int block = 0; block < 50; ++block)
+        {
+            for (int i = 0; i < blockSize; ++i)
+                input[static_cast<size_t>(i)] = std::sin(0.01f * static_cast<float>(block * blockSize + i));
+
+            std::fill(left.begin(), left.end(), 0.0f);
+            std::fill(right.begin(), right.end(), 0.0f);
+            std::fill(otherLeft.begin(), otherLeft.end(), 0.0f);
+            std::fill(otherRight.begin(), otherRight.end(), 0.0f);
+
+            capture.write(input.data(), blockSize);
+            scheduler.process(settings, capture, left.data(), right.data(), blockSize);
+            other.process(settings, capture, otherLeft.data(), otherRight.data(), blockSize);
+
+            REQUIRE(left == otherLeft);
+            REQUIRE(right == otherRight);
+
+            for (auto sample : left)
+                peak = std::max(peak, std::abs(sample));
+        }
+
+        REQUIRE(peak > 0.0f);
+    }
+
+    SECTION("Released engines render nothing until prepared again")
+    {
+        GrainScheduler::Settings settings;
+        settings.density = 1000.0f;
+
+        scheduler.releaseResources();
+        REQUIRE(scheduler.getGrainCapacity() == 0);
+        REQUIRE(scheduler.getMaxBlockSize() == 0);
+
+        capture.write(input.data(), blockSize);
+        scheduler.prepare(sampleRate, blockSize, 1000.0f);
+        scheduler.process(settings, capture, left.data(), right.data(), blockSize);
+        REQUIRE(scheduler.getNumActiveGrains() > 0);
+    }
+}
+
+TEST_CASE("Grain spatialisation", "[grains]")
+{
+    GrainSpatialiser spatialiser;
+    GrainSpatialiser::Gains gains {};
+
+    const auto getPower = [&]
+    {
+        float power = 0.0f;
+
+        for (int channel = 0; channel < spatialiser.getNumChannels(); ++channel)
+            power += gains[static_cast<size_t>(channel)] * gains[static_cast<size_t>(channel)];
+
+        return power;
+    };
+
+    SECTION("Speaker, ring and ambisonic layouts are supported, up to the channel limit")
+    {
+        REQUIRE(GrainSpatialiser::isLayoutSupported(juce::AudioChannelSet::stereo()));
+        REQUIRE(GrainSpatialiser::isLayoutSupported(juce::AudioChannelSet::quadraphonic()));
+        REQUIRE(GrainSpatialiser::isLayoutSupported(juce::AudioChannelSet::create5point1()));
+        REQUIRE(GrainSpatialiser::isLayoutSupported(juce::AudioChannelSet::create7point1point4()));
+        REQUIRE(GrainSpatialiser::isLayoutSupported(juce::AudioChannelSet::discreteChannels(24)));
+        REQUIRE(GrainSpatialiser::isLayoutSupported(juce::AudioChannelSet::ambisonic(3)));
+
+        REQUIRE_FALSE(GrainSpatialiser::isLayoutSupported(juce::AudioChannelSet::mono()));
+        REQUIRE_FALSE(GrainSpatialiser::isLayoutSupported(juce::AudioChannelSet::discreteChannels(2)));
+        REQUIRE_FALSE(GrainSpatialiser::isLayoutSupported(juce::AudioChannelSet::ambisonic(5)));
+    }
+
+    SECTION("Stereo grains span the pair at constant power")
+    {
+        spatialiser.prepare(juce::AudioChannelSet::stereo());
+        REQUIRE(spatialiser.isStereo());
+
+        spatialiser.computeGains(0.0f, 1.0f, gains.data());
+        REQUIRE(gains[0] == Approx(1.0f));
+        REQUIRE(gains[1] == Approx(0.0f).margin(1e-6));
+
+        spatialiser.computeGains(0.5f, 1.0f, gains.data());
+        REQUIRE(gains[0] == Approx(gains[1]));
+
+        for (auto position : { 0.1f, 0.3f, 0.8f, 1.0f })
+        {
+            spatialiser.computeGains(position, 0.5f, gains.data());
+            REQUIRE(getPower() == Approx(0.25f));
+        }
+    }
+
+    SECTION("Surround grains reach the two speakers around them and never the LFE")
+    {
+        const auto layout = juce::AudioChannelSet::create5point1();
+        spatialiser.prepare(layout);
+        REQUIRE(spatialiser.getNumChannels() == 6);
+
+        for (int step = 0; step < 100; ++step)
+        {
+            spatialiser.computeGains(static_cast<float>(step) / 100.0f, 1.0f, gains.data());
+
+            const auto reached = std::count_if(gains.begin(), gains.begin() + 6, [](float gain) { return gain > 1e-6f; });
+            REQUIRE(reached >= 1);
+            REQUIRE(reached <= 2);
+            REQUIRE(gains[3] == 0.0f);
+            REQUIRE(getPower() == Approx(1.0f));
+        }
+
+        // Grains go all the way round: a pan to the side lands between the front and the surround speaker
+        spatialiser.computeGainsForAzimuth(spatialiser.getPanAzimuth(-1.0f), 1.0f, gains.data());
+        REQUIRE(gains[0] > 0.0f);
+        REQUIRE(gains[4] > 0.0f);
+
+        // Straight ahead is the centre speaker alone
+        spatialiser.computeGainsForAzimuth(0.0f, 1.0f, gains.data());
+        REQUIRE(gains[2] == Approx(1.0f));
+    }
+
+    SECTION("Ambisonic grains are encoded in ACN order with SN3D normalisation")
+    {
+        spatialiser.prepare(juce::AudioChannelSet::ambisonic(2));
+        REQUIRE(spatialiser.getNumChannels() == 9);
+
+        const auto azimuth = 0.7f;
+        spatialiser.computeGainsForAzimuth(azimuth, 0.5f, gains.data());
+
+        REQUIRE(gains[0] == Approx(0.5f));                                         // W
+        REQUIRE(gains[1] == Approx(0.5f * std::sin(azimuth)));                     // Y
+        REQUIRE(gains[2] == Approx(0.0f).margin(1e-6));                            // Z, in the horizontal plane
+        REQUIRE(gains[3] == Approx(0.5f * std::cos(azimuth)));                     // X
+        REQUIRE(gains[4] == Approx(0.5f * std::sqrt(0.75f) * std::sin(2.0f * azimuth)));
+        REQUIRE(gains[6] == Approx(-0.25f));
+        REQUIRE(gains[8] == Approx(0.5f * std::sqrt(0.75f) * std::cos(2.0f * azimuth)));
+    }
+
+    SECTION("A scheduler spreads its grains over every speaker channel of the layout")
+    {
+        constexpr int blockSize = 64;
+        constexpr int numChannels = 8;
+
+        GrainScheduler scheduler;
+        scheduler.prepare(48000.0, blockSize, 1000.0f, 0, juce::AudioChannelSet::create7point1());
+        REQUIRE(scheduler.getNumOutputChannels() == numChannels);
+
+        InputCaptureBuffer capture;
+        capture.prepare(48000);
+
+        GrainScheduler::Settings settings;
+        settings.density = 1000.0f;
+        settings.grainSizeMs = 10.0f;
+
+        std::vector<float> input(blockSize, 0.5f);
+        std::vector<std::vector<float>> channels(numChannels, std::vector<float>(blockSize));
+        std::array<float*, numChannels> outputs {};
+        std::array<float, numChannels> peaks {};
+
+        for (int block = 0; block < 100; ++block)
+        {
+            for (size_t channel = 0; channel < channels.size(); ++channel)
+            {
+                std::fill(channels[channel].begin(), channels[channel].end(), 0.0f);
+                outputs[channel] = channels[channel].data();
+            }
+
+            capture.write(input.data(), blockSize);
+            scheduler.process(settings, capture, outputs.data(), blockSize);
+
+            for (size_t channel = 0; channel < channels.size(); ++channel)
+                for (auto sample : channels[channel])
+                    peaks[channel] = std::max(peaks[channel], std::abs(sample));
+        }
+
+        for (size_t channel = 0; channel < peaks.size(); ++channel)
+        {
+            if (channel == 3)
+                REQUIRE(peaks[channel] == 0.0f);   // LFE
+            else
+                REQUIRE(peaks[channel] > 0.0f);
+        }
+    }
+}
+
+TEST_CASE("Grain visual feed", "[grains]")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 64;
+
+    GrainScheduler scheduler;
+    scheduler.prepare(sampleRate, blockSize, 1000.0f);
+
+    InputCaptureBuffer capture;
+    capture.prepare(static_cast<int>(sampleRate));
+
+    GrainVisualFeed feed;
+    feed.prepare(sampleRate);
+
+    std::vector<float> input(blockSize, 0.5f);
+    std::vector<float> left(blockSize), right(blockSize);
+
+    GrainScheduler::Settings settings;
+    settings.density = 1000.0f;
+    settings.grainSizeMs = 1000.0f;
+
+    const auto run = [&](int numBlocks)
+    {
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            capture.write(input.data(), blockSize);
+            scheduler.process(settings, capture, left.data(), right.data(), blockSize);
+            feed.publish(blockSize, [&](GrainVisualFeed::Frame& frame) { scheduler.fillVisualFrame(frame); });
+        }
+    };
+
+    GrainVisualFeed::Frame frame;
+    const auto framePeriodInBlocks = static_cast<int>(sampleRate / GrainVisualFeed::framesPerSecond) / blockSize + 1;
+
+    SECTION("Nothing is gathered until a consumer is active")
+    {
+        run(100);
+        REQUIRE_FALSE(feed.readLatest(frame));
+        REQUIRE(feed.getNumDropped() == 0);
+    }
+
+    SECTION("Snapshots are decimated to the frame size")
+    {
+        feed.setActive(true);
+        run(static_cast<int>(sampleRate) / blockSize + framePeriodInBlocks);
+
+        // One-second grains at 1000 per second are more than a frame holds
+        REQUIRE(feed.readLatest(frame));
+        run(framePeriodInBlocks);
+        REQUIRE(feed.readLatest(frame));
+        REQUIRE(frame.numActive > GrainVisualFeed::maxGrainsPerFrame);
+        REQUIRE(frame.numGrains > GrainVisualFeed::maxGrainsPerFrame / 2);
+        REQUIRE(frame.numGrains <= GrainVisualFeed::maxGrainsPerFrame);
+
+        for (int i = 0; i < frame.numGrains; ++i)
+        {
+            const auto& grain = frame.grains[static_cast<size_t>(i)];
+            REQUIRE(grain.position >= 0.0f);
+            REQUIRE(grain.position <= 1.0f);
+            REQUIRE(grain.pan >= -1.0f);
+            REQUIRE(grain.pan <= 1.0f);
+            REQUIRE(grain.level >= 0.0f);
+        }
+
+        // Everything queued was drained
+        REQUIRE_FALSE(feed.readLatest(frame));
+    }
+
+    SECTION("A lagging consumer loses snapshots instead of blocking the producer")
+    {
+        feed.setActive(true);
+
+        // Two seconds at the display rate is far more than the queue holds
+        run(static_cast<int>(2.0 * sampleRate) / blockSize);
+        REQUIRE(feed.getNumDropped() > 0);
+
+        // Draining makes room again, so the next snapshot is queued rather than dropped
+        REQUIRE(feed.readLatest(frame));
+
+        const auto dropped = feed.getNumDropped();
+        run(framePeriodInBlocks);
+        REQUIRE(feed.getNumDropped() == dropped);
+        REQUIRE(feed.readLatest(frame));
+    }
+}
+
+TEST_CASE("Grain voice allocation", "[grains]")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 64;
+    constexpr float budget = 1000.0f;
+
+    GrainScheduler scheduler;
+    scheduler.prepare(sampleRate, blockSize, budget);
+
+    InputCaptureBuffer capture;
+    capture.prepare(static_cast<int>(sampleRate));
+
+    GrainVoiceAllocator voices;
+    voices.prepare(sampleRate);
+
+    std::vector<float> input(blockSize, 0.5f);
+    std::vector<float> left(blockSize), right(blockSize);
+
+    GrainScheduler::Settings settings;
+    settings.density = 100.0f;
+    settings.grainSizeMs = 10.0f;
+
+    // Renders like the processor does, returning the most grains sounding at once
+    const auto run = [&](int numBlocks)
+    {
+        int maxActive = 0;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            capture.write(input.data(), blockSize);
+
+            auto cloudSettings = settings;
+            cloudSettings.density *= voices.process(settings, capture, scheduler, budget, blockSize);
+            scheduler.process(cloudSettings, capture, left.data(), right.data(), blockSize);
+
+            maxActive = std::max(maxActive, scheduler.getNumActiveGrains());
+        }
+
+        return maxActive;
+    };
+
+    SECTION("A note's voice plays a cloud until it has faded out after the note-off")
+    {
+        settings.density = 0.1f;
+        run(20);
+        REQUIRE(scheduler.getNumActiveGrains() == 0);
+
+        // The first grain starts with the note, then the voice spawns at the density alongside the cloud,
+        // each overlapping about five deep
+        settings.density = 500.0f;
+        voices.noteOn(60, 1.0f, 1.0f);
+        REQUIRE(voices.getNumActiveVoices() == 1);
+        REQUIRE(run(20) >= 8);
+
+        voices.noteOff(60);
+        REQUIRE(voices.getNumHeldVoices() == 0);
+        REQUIRE(voices.getNumActiveVoices() == 1);
+
+        run(static_cast<int>(GrainVoiceAllocator::releaseSeconds * sampleRate) / blockSize + 1);
+        REQUIRE(voices.getNumActiveVoices() == 0);
+    }
+
+    SECTION("Without a free voice, the oldest held note is stolen")
+    {
+        for (int note = 0; note <= GrainVoiceAllocator::maxVoices; ++note)
+            voices.noteOn(note, 1.0f, 1.0f);
+
+        REQUIRE(voices.getNumActiveVoices() == GrainVoiceAllocator::maxVoices);
+        REQUIRE(voices.getNumStolen() == 1);
+
+        // Note 0 lost its voice, so releasing it changes nothing, while note 1 still sounds
+        voices.noteOff(0);
+        REQUIRE(voices.getNumHeldVoices() == GrainVoiceAllocator::maxVoices);
+        voices.noteOff(1);
+        REQUIRE(voices.getNumHeldVoices() == GrainVoiceAllocator::maxVoices - 1);
+    }
+
+    SECTION("Releasing voices are stolen before held ones, the quietest first")
+    {
+        for (int note = 0; note < GrainVoiceAllocator::maxVoices; ++note)
+            voices.noteOn(note, note == 5 ? 0.2f : 0.9f, 1.0f);
+
+        voices.noteOff(5);
+        voices.noteOff(9);
+        voices.noteOn(100, 1.0f, 1.0f);
+
+        REQUIRE(voices.getNumStolen() == 1);
+        REQUIRE(voices.getNumHeldVoices() == GrainVoiceAllocator::maxVoices - 1);
+
+        // Note 9 kept its voice and restarts it; note 5 has to steal another
+        voices.noteOn(9, 1.0f, 1.0f);
+        REQUIRE(voices.getNumStolen() == 1);
+        voices.noteOn(5, 1.0f, 1.0f);
+        REQUIRE(voices.getNumStolen() == 2);
+    }
+
+    SECTION("The voices and the cloud never exceed the grain budget together")
+    {
+        settings.density = budget;
+
+        for (int note = 0; note < GrainVoiceAllocator::maxVoices; ++note)
+            voices.noteOn(note, 1.0f, 1.0f);
+
+        // Unbudgeted, seventeen clouds of 10 ms grains at 1000 per second would overlap 170 deep.
+        // Thinned to the budget, each clock spawns less often than its grains last
+        const auto maxActive = run(200);
+        REQUIRE(maxActive > 0);
+        REQUIRE(maxActive <= GrainVoiceAllocator::maxVoices + 1);
+
+        REQUIRE(voices.process(settings, capture, scheduler, budget, 0)
+                == Approx(budget / (settings.density * (GrainVoiceAllocator::maxVoices + 1))));
+    }
+}
+
+TEST_CASE("Grain envelope tables", "[grains]")
+{
+    GrainEnvelopeTables tables;
+
+    SECTION("Table lookups follow the analytic Hann window")
+    {
+        for (int i = 0; i <= 100; ++i)
+        {
+            const auto phase = static_cast<float>(i) / 100.0f;
+            const auto expected = GrainEnvelopes::Hann::evaluate(phase);
+
+            REQUIRE(tables.hann.lookup(phase) == Approx(expected).margin(1e-6));
+        }
+    }
+
+    SECTION("Every shape starts and ends silent and peaks in the middle")
+    {
+        for (auto shape : { GrainEnvelopeShape::hann, GrainEnvelopeShape::tukey,
+                            GrainEnvelopeShape::gaussian, GrainEnvelopeShape::trapezoid })
+        {
+            tables.visit(shape, [](const auto& table)
+            {
+                REQUIRE(table.lookup(0.0f) == Approx(0.0f).margin(1e-6));
+                REQUIRE(table.lookup(1.0f) == Approx(0.0f).margin(1e-6));
+                REQUIRE(table.lookup(0.5f) == Approx(1.0f).margin(1e-6));
+
+                // Padded vector lanes can ask for phases just outside the grain
+                REQUIRE(table.lookup(1.01f) == Approx(0.0f).margin(1e-6));
+            });
+        }
+    }
+
+    SECTION("Flat-topped shapes hold unity gain")
+    {
+        REQUIRE(tables.tukey.lookup(0.3f) == Approx(1.0f));
+        REQUIRE(tables.trapezoid.lookup(0.1f) == Approx(0.5f).margin(1e-6));
+        REQUIRE(tables.trapezoid.lookup(0.7f) == Approx(1.0f));
+    }
+}
+
+TEST_CASE("Grain effects", "[grains]")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int numSamples = 4096;
+
+    GrainEffects effects;
+    effects.prepare(sampleRate);
+
+    GrainEffects::Settings settings;
+    GrainEffectState state;
+    std::vector<float> samples(numSamples);
+
+    const auto fillAlternating = [&] { for (int i = 0; i < numSamples; ++i) samples[i] = (i % 2 == 0) ? 0.5f : -0.5f; };
+    const auto fillConstant = [&] { std::fill(samples.begin(), samples.end(), 0.5f); };
+
+    SECTION("Stages at identity are bypassed")
+    {
+        effects.update(settings);
+        REQUIRE(effects.isBypassed(state));
+
+        // A fully open low-pass or high-pass without a peak passes everything
+        settings.cutoffHz = GrainEffects::maxCutoffHz;
+        effects.update(settings);
+        state.filterType = GrainFilterType::lowPass;
+        REQUIRE(effects.isBypassed(state));
+
+        settings.cutoffHz = GrainEffects::minCutoffHz;
+        effects.update(settings);
+        state.filterType = GrainFilterType::highPass;
+        REQUIRE(effects.isBypassed(state));
+
+        state.filterType = GrainFilterType::bandPass;
+        REQUIRE_FALSE(effects.isBypassed(state));
+
+        state.filterType = GrainFilterType::off;
+        settings.downsample = 2.0f;
+        effects.update(settings);
+        REQUIRE(effects.isCrushActive());
+        REQUIRE_FALSE(effects.isBypassed(state));
+    }
+
+    SECTION("The low-pass passes DC and stops Nyquist, the high-pass the opposite")
+    {
+        settings.cutoffHz = 1000.0f;
+        effects.update(settings);
+
+        state.filterType = GrainFilterType::lowPass;
+        fillConstant();
+        effects.process(state, samples.data(), numSamples);
+        REQUIRE(samples.back() == Approx(0.5f).margin(1e-3));
+
+        state = {};
+        state.filterType = GrainFilterType::lowPass;
+        fillAlternating();
+        effects.process(state, samples.data(), numSamples);
+        REQUIRE(std::abs(samples.back()) < 0.01f);
+
+        state = {};
+        state.filterType = GrainFilterType::highPass;
+        fillConstant();
+        effects.process(state, samples.data(), numSamples);
+        REQUIRE(std::abs(samples.back()) < 1e-3f);
+
+        state = {};
+        state.filterType = GrainFilterType::highPass;
+        fillAlternating();
+        effects.process(state, samples.data(), numSamples);
+        REQUIRE(std::abs(samples.back()) == Approx(0.5f).margin(0.01));
+    }
+
+    SECTION("The crusher quantises and holds samples")
+    {
+        settings.crushBits = 2.0f;
+        settings.downsample = 4.0f;
+        effects.update(settings);
+
+        for (int i = 0; i < numSamples; ++i)
+            samples[i] = static_cast<float>(i) / static_cast<float>(numSamples);
+
+        effects.process(state, samples.data(), numSamples);
+
+        // Two bits leave steps of a half, each held for four samples
+        for (int i = 0; i < numSamples; ++i)
+        {
+            REQUIRE(samples[i] * 2.0f == Approx(std::round(samples[i] * 2.0f)));
+            REQUIRE(samples[i] == samples[i - i % 4]);
+        }
+    }
+
+    SECTION("Scheduled grains go through the chain")
+    {
+        constexpr int blockSize = 64;
+
+        GrainScheduler scheduler;
+        scheduler.prepare(sampleRate, blockSize, 1000.0f);
+
+        InputCaptureBuffer capture;
+        capture.prepare(static_cast<int>(sampleRate));
+
+        std::vector<float> input(blockSize, 0.9f);
+        std::vector<float> left(blockSize), right(blockSize);
+        capture.write(input.data(), blockSize);
+        bool reachedFullScale = false;
+
+        // One bit rounds every enveloped sample to 0 or 1 before the pan law splits it
+        GrainScheduler::Settings grainSettings;
+        grainSettings.density = 0.1f;
+        grainSettings.effects.crushBits = 1.0f;
+
+        for (int block = 0; block < 80; ++block)
+        {
+            std::fill(left.begin(), left.end(), 0.0f);
+            std::fill(right.begin(), right.end(), 0.0f);
+            capture.write(input.data(), blockSize);
+            scheduler.process(grainSettings, capture, left.data(), right.data(), blockSize);
+
+            for (int i = 0; i < blockSize; ++i)
+            {
+                const auto rendered = std::sqrt(left[i] * left[i] + right[i] * right[i]);
+                REQUIRE((rendered == Approx(0.0f).margin(1e-6) || rendered == Approx(1.0f)));
+                reachedFullScale = reachedFullScale || rendered > 0.5f;
+            }
+        }
+
+        REQUIRE(reachedFullScale);
+    }
+}
+
+TEST_CASE("Grain resampler tiers", "[grains]")
+{
+    using FloatVector = GrainInterpolators::FloatVector;
+    constexpr int vectorSize = GrainInterpolators::vectorSize;
+
+    GrainSincTable sincTable;
+    std::vector<float> source(256);
+
+    // Reads vectorSize samples from evenly spaced fractional positions around the middle
+    const auto readAt = [&source](const auto& interpolator, float start, float step)
+    {
+        alignas(FloatVector::SIMDRegisterSize) float positions[vectorSize];
+        alignas(FloatVector::SIMDRegisterSize) float output[vectorSize];
+
+        for (int lane = 0; lane < vectorSize; ++lane)
+            positions[lane] = start + step * static_cast<float>(lane);
+
+        interpolator.process(source.data(), positions).copyToRawArray(output);
+        return std::vector<float>(output, output + vectorSize);
+    };
+
+    SECTION("Hermite interpolation reproduces a ramp exactly")
+    {
+        for (size_t i = 0; i < source.size(); ++i)
+            source[i] = static_cast<float>(i) * 0.01f;
+
+        const auto output = readAt(GrainInterpolators::Hermite {}, 100.3f, 0.7f);
+
+        for (int lane = 0; lane < vectorSize; ++lane)
+            REQUIRE(output[static_cast<size_t>(lane)] == Approx((100.3f + 0.7f * static_cast<float>(lane)) * 0.01f).margin(1e-5));
+    }
+
+    SECTION("Windowed sinc reproduces a low-frequency tone at unity rate")
+    {
+        const auto tone = [](double position) { return std::sin(juce::MathConstants<double>::twoPi * position / 32.0); };
+
+        for (size_t i = 0; i < source.size(); ++i)
+            source[i] = static_cast<float>(tone(static_cast<double>(i)));
+
+        const auto output = readAt(GrainInterpolators::WindowedSinc { sincTable, 1.0f }, 100.25f, 1.1f);
+
+        for (int lane = 0; lane < vectorSize; ++lane)
+            REQUIRE(output[static_cast<size_t>(lane)] == Approx(tone(100.25 + 1.1 * lane)).margin(2e-3));
+    }
+
+    SECTION("Faster grains use lower sinc cutoffs that reject aliasing content")
+    {
+        REQUIRE(GrainSincTable::getBandForRate(0.5f) == 0);
+        REQUIRE(GrainSincTable::getBandForRate(1.0f) == 0);
+        REQUIRE(GrainSincTable::getBandForRate(1.5f) == 1);
+        REQUIRE(GrainSincTable::getBandForRate(4.0f) == 2);
+
+        // Read at twice the rate, a tone at the source Nyquist frequency would alias into the output
+        for (size_t i = 0; i < source.size(); ++i)
+            source[i] = (i % 2 == 0) ? 1.0f : -1.0f;
+
+        const auto fast = readAt(GrainInterpolators::WindowedSinc { sincTable, 2.0f }, 100.0f, 2.5f);
+
+        for (auto sample : fast)
+            REQUIRE(std::abs(sample) < 0.05f);
+    }
+
+    SECTION("Sinc grains read through Hermite until the table is built")
+    {
+        GrainResampler resampler;
+        const auto isSinc = [&resampler]
+        {
+            auto sinc = false;
+            resampler.visit(ResamplerQuality::sinc, 1.0f, [&sinc](const auto& interpolator)
+            {
+                sinc = std::is_same<std::decay_t<decltype(interpolator)>, GrainInterpolators::WindowedSinc>::value;
+            });
+            return sinc;
+        };
+
+        REQUIRE(resampler.getSincTable() == nullptr);
+        REQUIRE_FALSE(isSinc());
+
+        REQUIRE(resampler.waitForTables(10000));
+        REQUIRE(resampler.getSincTable() != nullptr);
+        REQUIRE(isSinc());
+    }
+}
+
+TEST_CASE("Grain render pool", "[grains]")
+{
+    // Each chunk adds its index to the accumulator of whichever participant renders it
+    struct SummingJob : public GrainRenderPool::Job
+    {
+        void beginParticipant(int participant) noexcept override { sums[static_cast<size_t>(participant)] = 0; }
+        void loadChunk(int participant, int chunk) noexcept override { loaded[static_cast<size_t>(participant)] = chunk; }
+
+        void renderChunk(int participant) noexcept override
+        {
+            // Enough work per chunk for workers to take part
+            volatile float spin = 0.0f;
+
+            for (int i = 0; i < 2000; ++i)
+                spin = spin + 1.0f;
+
+            sums[static_cast<size_t>(participant)] += loaded[static_cast<size_t>(participant)] + 1;
+        }
+
+        std::array<juce::int64, GrainRenderPool::maxParticipants> sums {};
+        std::array<int, GrainRenderPool::maxParticipants> loaded {};
+    };
+
+    GrainRenderPool renderPool;
+    SummingJob job;
+    constexpr int numChunks = 100;
+    constexpr juce::int64 expectedSum = numChunks * (numChunks + 1) / 2;
+
+    const auto sumCompleted = [&job](juce::uint32 completed)
+    {
+        juce::int64 total = 0;
+
+        for (int p = 0; p < GrainRenderPool::maxParticipants; ++p)
+            if ((completed & (1u << p)) != 0)
+                total += job.sums[static_cast<size_t>(p)];
+
+        return total;
+    };
+
+    SECTION("Without workers the caller renders every chunk")
+    {
+        REQUIRE(renderPool.run(job, numChunks, 10.0) == 1u);
+        REQUIRE(job.sums[0] == expectedSum);
+    }
+
+    SECTION("With workers every chunk is rendered exactly once")
+    {
+        renderPool.start(3);
+        REQUIRE(renderPool.getNumWorkers() == 3);
+
+        for (int run = 0; run < 200; ++run)
+        {
+            const auto completed = renderPool.run(job, numChunks, 1000.0);
+
+            REQUIRE((completed & 1u) != 0);
+            REQUIRE(sumCompleted(completed) == expectedSum);
+        }
+
+        REQUIRE(renderPool.getNumTimeouts() == 0);
+        renderPool.stop();
+    }
+
+    SECTION("Without a deadline every worker's output is kept")
+    {
+        renderPool.start(3);
+
+        for (int run = 0; run < 50; ++run)
+        {
+            const auto completed = renderPool.run(job, numChunks, -1.0);
+            REQUIRE(sumCompleted(completed) == expectedSum);
+        }
+
+        REQUIRE(renderPool.getNumTimeouts() == 0);
+        renderPool.stop();
+    }
+}
+
+TEST_CASE("Spectral grain engine", "[grains][spectral]")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 64;
+
+    SpectralGrainEngine engine;
+    engine.prepare();
+
+    InputCaptureBuffer capture;
+    capture.prepare(static_cast<int>(sampleRate));
+
+    std::vector<float> input(blockSize), left(blockSize), right(blockSize);
+    double phase = 0.0;
+    const auto phaseIncrement = juce::MathConstants<double>::twoPi * 440.0 / sampleRate;
+
+    SpectralGrainEngine::Settings settings;
+    settings.position = 1.0f;
+
+    // Feeds numBlocks of the sine, or of silence, and returns the RMS of the left output
+    const auto run = [&](int numBlocks, bool silent)
+    {
+        double sumOfSquares = 0.0;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            for (auto& sample : input)
+            {
+                sample = silent ? 0.0f : 0.5f * static_cast<float>(std::sin(phase));
+                phase += phaseIncrement;
+            }
+
+            capture.write(input.data(), blockSize);
+            std::fill(left.begin(), left.end(), 0.0f);
+            std::fill(right.begin(), right.end(), 0.0f);
+            engine.process(settings, capture, left.data(), right.data(), blockSize);
+
+            for (auto sample : left)
+                sumOfSquares += static_cast<double>(sample) * sample;
+        }
+
+        return std::sqrt(sumOfSquares / (numBlocks * blockSize));
+    };
+
+    const auto sineRms = 0.5 / std::sqrt(2.0);
+    const auto framesToBlocks = SpectralGrainEngine::fftSize / blockSize;
+
+    SECTION("Unmodified frames resynthesise the input at its level")
+    {
+        run(4 * framesToBlocks, false);
+
+        REQUIRE(run(8 * framesToBlocks, false) == Approx(sineRms).epsilon(0.02));
+        REQUIRE(left == right);
+    }
+
+    SECTION("Without freezing, silence in gives silence out")
+    {
+        run(4 * framesToBlocks, false);
+        run(2 * framesToBlocks, true);
+
+        REQUIRE(run(framesToBlocks, true) < 1.0e-4);
+    }
+
+    SECTION("A frozen spectrum keeps sounding after the input stops")
+    {
+        run(4 * framesToBlocks, false);
+        settings.freeze = true;
+        run(2 * framesToBlocks, true);
+
+        REQUIRE(run(8 * framesToBlocks, true) > 0.5 * sineRms);
+    }
+
+    SECTION("Smearing lets a stopped input fade out over several frames")
+    {
+        settings.smear = 0.9f;
+        run(4 * framesToBlocks, false);
+        run(2 * framesToBlocks, true);
+
+        const auto fading = run(framesToBlocks, true);
+        REQUIRE(fading > 0.05 * sineRms);
+        REQUIRE(run(40 * framesToBlocks, true) < fading);
+    }
+
+    SECTION("Shuffled bins keep the output finite and near the input level")
+    {
+        settings.shuffle = 1.0f;
+        run(4 * framesToBlocks, false);
+
+        const auto rms = run(8 * framesToBlocks, false);
+        REQUIRE(std::isfinite(rms));
+        REQUIRE(rms > 0.1 * sineRms);
+        REQUIRE(rms < 2.0 * sineRms);
+    }
+
+    SECTION("Released engines render nothing until prepared again")
+    {
+        engine.releaseResources();
+        REQUIRE_FALSE(engine.isPrepared());
+        REQUIRE(run(framesToBlocks, false) == 0.0);
+    }
+}
@@ -0,0 +1,127 @@
+#include "catch.hpp"
+
+#include "OutputStage.h"
+
+#include <vector>
+
+TEST_CASE("Output stage mixing", "[output]")
+{
+    constexpr int numSamples = 256;
+
+    OutputStage::Targets targets;
+    targets.gain = 1.0f;
+    targets.mix = 0.0f;
+
+    OutputStage stage;
+    stage.prepare(48000.0, numSamples, targets);
+
+    std::vector<float> dry(numSamples, 0.5f);
+    std::vector<float> wetLeft(numSamples, 0.25f), wetRight(numSamples, -0.25f);
+    std::vector<float> left(numSamples), right(numSamples);
+
+    SECTION("Centre pan passes the dry signal at unity")
+    {
+        stage.process(dry.data(), wetLeft.data(), wetRight.data(), left.data(), right.data(), numSamples);
+
+        REQUIRE(left[0] == Approx(0.5f));
+        REQUIRE(right[numSamples - 1] == Approx(0.5f));
+    }
+
+    SECTION("Pan keeps constant power")
+    {
+        for (auto pan : { -1.0f, -0.3f, 0.0f, 0.7f, 1.0f })
+        {
+            auto gains = OutputStage::getPanGains(pan);
+            REQUIRE(gains.first * gains.first + gains.second * gains.second == Approx(2.0f));
+        }
+    }
+
+    SECTION("Dry may alias the left output")
+    {
+        auto inPlace = dry;
+        stage.process(inPlace.data(), wetLeft.data(), wetRight.data(), inPlace.data(), right.data(), numSamples);
+
+        REQUIRE(inPlace[10] == Approx(0.5f));
+        REQUIRE(right[10] == Approx(0.5f));
+    }
+
+    SECTION("Target changes ramp instead of jumping")
+    {
+        targets.mix = 1.0f;
+        targets.width = 0.0f;
+        stage.setTargets(targets);
+
+        stage.process(dry.data(), wetLeft.data(), wetRight.data(), left.data(), right.data(), numSamples);
+
+        // The first sample is still close to dry, and the ramp moves steadily towards the mono cloud
+        REQUIRE(left[0] == Approx(0.5f).margin(0.01f));
+        REQUIRE(left[numSamples - 1] < left[0]);
+
+        for (int block = 0; block < 8; ++block)
+            stage.process(dry.data(), wetLeft.data(), wetRight.data(), left.data(), right.data(), numSamples);
+
+        // Zero width collapses the opposite-polarity cloud to silence
+        REQUIRE(left[numSamples - 1] == Approx(0.0f).margin(1e-6));
+        REQUIRE(right[numSamples - 1] == Approx(0.0f).margin(1e-6));
+    }
+}
+
+TEST_CASE("Multichannel output stage mixing", "[output]")
+{
+    constexpr int numSamples = 256;
+    constexpr int numChannels = 6;
+
+    // A dry signal placed on the first two channels only, and a mix halfway to the cloud
+    OutputStage::Targets targets;
+    targets.gain = 1.0f;
+    targets.mix = 0.5f;
+    targets.dryPlacement[0] = 0.6f;
+    targets.dryPlacement[1] = 0.8f;
+
+    OutputStage stage;
+    stage.prepare(48000.0, numSamples, targets, numChannels);
+
+    std::vector<std::vector<float>> wet(numChannels), out(numChannels, std::vector<float>(numSamples));
+    std::vector<const float*> wetPointers;
+    std::vector<float*> outPointers;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        wet[static_cast<size_t>(channel)].assign(numSamples, 0.1f * static_cast<float>(channel + 1));
+        wetPointers.push_back(wet[static_cast<size_t>(channel)].data());
+        outPointers.push_back(out[static_cast<size_t>(channel)].data());
+    }
+
+    SECTION("Each channel gets its share of the dry signal and its own wet channel")
+    {
+        std::vector<float> dry(numSamples, 1.0f);
+        stage.process(dry.data(), wetPointers.data(), outPointers.data(), numSamples);
+
+        REQUIRE(out[0][10] == Approx(0.5f * 0.6f + 0.5f * 0.1f));
+        REQUIRE(out[1][10] == Approx(0.5f * 0.8f + 0.5f * 0.2f));
+
+        for (int channel = 2; channel < numChannels; ++channel)
+            REQUIRE(out[static_cast<size_t>(channel)][numSamples - 1] == Approx(0.05f * static_cast<float>(channel + 1)));
+    }
+
+    SECTION("Dry may alias any output")
+    {
+        out[1].assign(numSamples, 1.0f);
+        stage.process(out[1].data(), wetPointers.data(), outPointers.data(), numSamples);
+
+        REQUIRE(out[0][10] == Approx(0.5f * 0.6f + 0.5f * 0.1f));
+        REQUIRE(out[1][10] == Approx(0.5f * 0.8f + 0.5f * 0.2f));
+    }
+
+    SECTION("Mix changes ramp on every channel alike")
+    {
+        std::vector<float> dry(numSamples, 0.0f);
+        targets.mix = 1.0f;
+        stage.setTargets(targets);
+        stage.process(dry.data(), wetPointers.data(), outPointers.data(), numSamples);
+
+        REQUIRE(out[5][0] == Approx(0.3f).margin(0.01f));
+        REQUIRE(out[5][numSamples - 1] > out[5][0]);
+        REQUIRE(out[2][numSamples - 1] / out[5][numSamples - 1] == Approx(0.5f));
+    }
+}
@@ -0,0 +1,239 @@
+#include "RealtimeGuard.h"
+
+#include <cstdlib>
+#include <new>
+
+/**
+ * Replacements for the calls RealtimeGuard traps, linked into the test executable only.
+ * The global allocation functions are replaced everywhere. On glibc the C allocator, mutex
+ * locking and file access are replaced as well, forwarding to glibc's internal entry points
+ * (or, for the mutex, the next definition found by dlsym), which keeps std::vector,
+ * juce::String, juce::HeapBlock, std::mutex, juce::CriticalSection and juce::File all covered.
+ */
+#if GRANULAR_REALTIME_GUARD
+
+#if defined(__GLIBC__)
+ #include <cstdarg>
+ #include <cstdio>
+ #include <dlfcn.h>
+ #include <fcntl.h>
+ #include <pthread.h>
+ #include <unistd.h>
+
+extern "C"
+{
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+    void __libc_free(void*);
+    int __open64(const char*, int, ...);
+    FILE* _IO_fopen(const char*, const char*);
+    ssize_t __read(int, void*, size_t);
+    ssize_t __write(int, const void*, size_t);
+}
+#endif
+
+//==============================================================================
+namespace
+{
+    using Violation = RealtimeGuard::Violation;
+
+    void* allocate(size_t size) noexcept
+    {
+        RealtimeGuard::check(Violation::allocation);
+
+       #if defined(__GLIBC__)
+        return __libc_malloc(size == 0 ? 1 : size);
+       #else
+        return std::malloc(size == 0 ? 1 : size);
+       #endif
+    }
+
+    void* allocateAligned(size_t size, std::align_val_t alignment) noexcept
+    {
+        RealtimeGuard::check(Violation::allocation);
+
+       #if defined(__GLIBC__)
+        return __libc_memalign(static_cast<size_t>(alignment), size == 0 ? 1 : size);
+       #elif defined(_MSC_VER)
+        return _aligned_malloc(size == 0 ? 1 : size, static_cast<size_t>(alignment));
+       #else
+        void* result = nullptr;
+        return posix_memalign(&result, static_cast<size_t>(alignment), size == 0 ? 1 : size) == 0 ? result : nullptr;
+       #endif
+    }
+
+    void deallocate(void* pointer) noexcept
+    {
+        if (pointer == nullptr)
+            return;
+
+        RealtimeGuard::check(Violation::deallocation);
+
+       #if defined(__GLIBC__)
+        __libc_free(pointer);
+       #else
+        std::free(pointer);
+       #endif
+    }
+
+    void deallocateAligned(void* pointer) noexcept
+    {
+       #if defined(_MSC_VER)
+        if (pointer != nullptr)
+        {
+            RealtimeGuard::check(Violation::deallocation);
+            _aligned_free(pointer);
+        }
+       #else
+        deallocate(pointer);
+       #endif
+    }
+
+   #if defined(__GLIBC__)
+    /** True if open() was passed a mode: O_TMPFILE includes O_DIRECTORY, so it has to match in full. */
+    bool hasModeArgument(int flags) noexcept
+    {
+        return (flags & O_CREAT) != 0 || (flags & O_TMPFILE) == O_TMPFILE;
+    }
+   #endif
+
+    void* allocateOrThrow(size_t size)
+    {
+        if (auto* result = allocate(size))
+            return result;
+
+        throw std::bad_alloc();
+    }
+
+    void* allocateAlignedOrThrow(size_t size, std::align_val_t alignment)
+    {
+        if (auto* result = allocateAligned(size, alignment))
+            return result;
+
+        throw std::bad_alloc();
+    }
+}
+
+//==============================================================================
+void* operator new(size_t size)                                              { return allocateOrThrow(size); }
+void* operator new[](size_t size)                                            { return allocateOrThrow(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept              { return allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept            { return allocate(size); }
+void* operator new(size_t size, std::align_val_t alignment)                  { return allocateAlignedOrThrow(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment)                { return allocateAlignedOrThrow(size, alignment); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept   { return allocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocateAligned(size, alignment); }
+
+void operator delete(void* pointer) noexcept                                 { deallocate(pointer); }
+void operator delete[](void* pointer) noexcept                               { deallocate(pointer); }
+void operator delete(void* pointer, size_t) noexcept                         { deallocate(pointer); }
+void operator delete[](void* pointer, size_t) noexcept                       { deallocate(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept          { deallocate(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept        { deallocate(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept               { deallocateAligned(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept             { deallocateAligned(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept       { deallocateAligned(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept     { deallocateAligned(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept   { deallocateAligned(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { deallocateAligned(pointer); }
+
+//==============================================================================
+#if defined(__GLIBC__)
+extern "C"
+{
+    void* malloc(size_t size)
+    {
+        RealtimeGuard::check(Violation::allocation);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        RealtimeGuard::check(Violation::allocation);
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* pointer, size_t size)
+    {
+        RealtimeGuard::check(Violation::allocation);
+        return __libc_realloc(pointer, size);
+    }
+
+    void free(void* pointer)
+    {
+        if (pointer != nullptr)
+            RealtimeGuard::check(Violation::deallocation);
+
+        __libc_free(pointer);
+    }
+
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        using LockFunction = int (*)(pthread_mutex_t*);
+        static std::atomic<LockFunction> nextLock { nullptr };
+
+        auto lock = nextLock.load(std::memory_order_relaxed);
+
+        if (lock == nullptr)
+        {
+            lock = reinterpret_cast<LockFunction>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+            nextLock.store(lock, std::memory_order_relaxed);
+        }
+
+        RealtimeGuard::check(Violation::lock);
+        return lock(mutex);
+    }
+
+    int open(const char* path, int flags, ...)
+    {
+        RealtimeGuard::check(Violation::fileAccess);
+
+        va_list args;
+        va_start(args, flags);
+        const auto mode = hasModeArgument(flags) ? va_arg(args, int) : 0;
+        va_end(args);
+
+        return __open64(path, flags, mode);
+    }
+
+    int open64(const char* path, int flags, ...)
+    {
+        RealtimeGuard::check(Violation::fileAccess);
+
+        va_list args;
+        va_start(args, flags);
+        const auto mode = hasModeArgument(flags) ? va_arg(args, int) : 0;
+        va_end(args);
+
+        return __open64(path, flags, mode);
+    }
+
+    FILE* fopen(const char* path, const char* mode)
+    {
+        RealtimeGuard::check(Violation::fileAccess);
+        return _IO_fopen(path, mode);
+    }
+
+    FILE* fopen64(const char* path, const char* mode)
+    {
+        RealtimeGuard::check(Violation::fileAccess);
+        return _IO_fopen(path, mode);
+    }
+
+    ssize_t read(int fd, void* buffer, size_t size)
+    {
+        RealtimeGuard::check(Violation::fileAccess);
+        return __read(fd, buffer, size);
+    }
+
+    ssize_t write(int fd, const void* buffer, size_t size)
+    {
+        RealtimeGuard::check(Violation::fileAccess);
+        return __write(fd, buffer, size);
+    }
+}
+#endif
+
+#endif
@@ -0,0 +1,667 @@
+#include "catch.hpp"
+
+#include "AnalysisCache.h"
+#include "OnsetAnalyser.h"
+#include "SampleLibrary.h"
+#include "SourceLoader.h"
+#include "SourceRegistry.h"
+#include "StreamingSource.h"
+#include "WaveformOverview.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    /** Writes a 24-bit file whose left channel is a repeating ramp and right channel half of it. */
+    void writeTestFile(juce::AudioFormat& format, const juce::File& file, int numChannels, int numSamples)
+    {
+        file.deleteFile();
+
+        auto stream = file.createOutputStream();
+        REQUIRE(stream != nullptr);
+
+        std::unique_ptr<juce::AudioFormatWriter> writer(format.createWriterFor(stream.get(), 48000.0,
+                                                                               static_cast<unsigned int>(numChannels),
+                                                                               24, {}, 0));
+        REQUIRE(writer != nullptr);
+        stream.release();
+
+        juce::AudioBuffer<float> buffer(numChannels, numSamples);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            for (int i = 0; i < numSamples; ++i)
+                buffer.setSample(channel, i, static_cast<float>(i % 1000) / 1000.0f * (channel == 0 ? 1.0f : 0.5f));
+
+        REQUIRE(writer->writeFromAudioSampleBuffer(buffer, 0, numSamples));
+    }
+
+    void writeTestWav(const juce::File& file, int numChannels, int numSamples)
+    {
+        juce::WavAudioFormat format;
+        writeTestFile(format, file, numChannels, numSamples);
+    }
+}
+
+TEST_CASE("Memory-mapped sample library", "[sources]")
+{
+    juce::TemporaryFile tempFile(".wav");
+    SampleLibrary library;
+
+    SECTION("Unloaded library reads silence")
+    {
+        std::vector<float> output(16, 1.0f);
+        library.readSamples(output.data(), 0, 16);
+
+        REQUIRE_FALSE(library.isLoaded());
+        REQUIRE(library.getReadableRange().isEmpty());
+        REQUIRE(output[15] == 0.0f);
+    }
+
+    SECTION("Mono files read back through the mapping")
+    {
+        writeTestWav(tempFile.getFile(), 1, 5000);
+        REQUIRE(library.loadFile(tempFile.getFile()));
+
+        REQUIRE(library.getReadableRange().getEnd() == 5000);
+        REQUIRE(library.getSourceSampleRate() == Approx(48000.0));
+
+        std::vector<float> output(600);
+        library.readSamples(output.data(), 1500, 600);
+
+        REQUIRE(output[0] == Approx(0.5f).margin(1e-5));
+        REQUIRE(output[499] == Approx(0.999f).margin(1e-5));
+        REQUIRE(output[500] == Approx(0.0f).margin(1e-5));
+    }
+
+    SECTION("Stereo files are mixed down and reads past the end are silent")
+    {
+        writeTestWav(tempFile.getFile(), 2, 1000);
+        REQUIRE(library.loadFile(tempFile.getFile()));
+
+        std::vector<float> output(20, 1.0f);
+        library.readSamples(output.data(), 990, 20);
+
+        REQUIRE(output[0] == Approx(0.99f * 0.75f).margin(1e-5));
+        REQUIRE(output[10] == 0.0f);
+        REQUIRE(output[19] == 0.0f);
+
+        // Prefetch hints never block and tolerate any range
+        library.prefetch(-100, 1 << 30);
+        library.prefetch(500, 100);
+    }
+
+    SECTION("Unsupported files keep the previous source")
+    {
+        writeTestWav(tempFile.getFile(), 1, 1000);
+        REQUIRE(library.loadFile(tempFile.getFile()));
+
+        REQUIRE_FALSE(library.loadFile(tempFile.getFile().withFileExtension(".txt")));
+        REQUIRE(library.isLoaded());
+        REQUIRE(library.getLoadedFile() == tempFile.getFile());
+    }
+}
+
+TEST_CASE("Streaming compressed sources", "[sources]")
+{
+    juce::TemporaryFile tempFile(".flac");
+    juce::FlacAudioFormat flac;
+    writeTestFile(flac, tempFile.getFile(), 2, StreamingSource::chunkSize * 3);
+
+    StreamingSource source;
+    REQUIRE(source.canStreamFile(tempFile.getFile()));
+    REQUIRE(source.loadFile(tempFile.getFile()));
+    REQUIRE(source.getReadableRange().getEnd() == StreamingSource::chunkSize * 3);
+
+    const auto waitUntilCached = [&source](juce::int64 position)
+    {
+        for (int attempt = 0; attempt < 500 && ! source.isCached(position); ++attempt)
+            juce::Thread::sleep(2);
+
+        return source.isCached(position);
+    };
+
+    SECTION("The opening chunk is decoded straight after loading")
+    {
+        REQUIRE(waitUntilCached(0));
+
+        std::vector<float> output(10);
+        source.readSamples(output.data(), 1500, 10);
+        REQUIRE(output[0] == Approx(0.5f * 0.75f).margin(1e-5));
+    }
+
+    SECTION("A miss returns silence and requests the chunk")
+    {
+        const auto position = static_cast<juce::int64>(StreamingSource::chunkSize * 2 + 1500);
+        std::vector<float> output(10, 1.0f);
+
+        if (! source.isCached(position))
+        {
+            const auto missesBefore = source.getNumCacheMisses();
+            source.readSamples(output.data(), position, 10);
+
+            REQUIRE(output[0] == 0.0f);
+            REQUIRE(source.getNumCacheMisses() > missesBefore);
+        }
+
+        REQUIRE(waitUntilCached(position));
+
+        // The stereo test signal mixes down to three quarters of the left channel ramp
+        source.readSamples(output.data(), position, 10);
+        const auto expected = static_cast<float>((position + 1) % 1000) / 1000.0f * 0.75f;
+        REQUIRE(output[1] == Approx(expected).margin(1e-5));
+    }
+
+    SECTION("Unloading drops the source")
+    {
+        source.unload();
+
+        REQUIRE_FALSE(source.isLoaded());
+        REQUIRE_FALSE(source.isCached(0));
+    }
+}
+
+TEST_CASE("Onset index", "[sources]")
+{
+    const std::vector<juce::int64> transients { 12000, 30000, 55555, 80000, 100000, 123456 };
+
+    SECTION("Analysis finds each transient just ahead of its attack")
+    {
+        // Decaying noise bursts over a quiet noise floor
+        constexpr int numSamples = 48000 * 3;
+        juce::AudioBuffer<float> buffer(1, numSamples);
+        juce::Random random(7);
+
+        for (int i = 0; i < numSamples; ++i)
+            buffer.setSample(0, i, 0.01f * (random.nextFloat() * 2.0f - 1.0f));
+
+        for (auto transient : transients)
+            for (int i = 0; i < 4000; ++i)
+                buffer.addSample(0, static_cast<int>(transient) + i,
+                                 0.8f * std::exp(-static_cast<float>(i) / 800.0f) * (random.nextFloat() * 2.0f - 1.0f));
+
+        juce::WavAudioFormat format;
+        auto* stream = new juce::MemoryOutputStream();
+        std::unique_ptr<juce::AudioFormatWriter> writer(format.createWriterFor(stream, 48000.0, 1, 24, {}, 0));
+        REQUIRE(writer != nullptr);
+        REQUIRE(writer->writeFromAudioSampleBuffer(buffer, 0, numSamples));
+        writer->flush();
+
+        std::unique_ptr<juce::AudioFormatReader> reader(format.createReaderFor(
+            new juce::MemoryInputStream(stream->getData(), stream->getDataSize(), true), true));
+        REQUIRE(reader != nullptr);
+
+        auto index = OnsetIndex::analyse(*reader, {});
+        REQUIRE(index != nullptr);
+        REQUIRE(index->getLengthInSamples() == numSamples);
+
+        for (auto transient : transients)
+        {
+            const auto onset = index->findNearest(transient);
+            REQUIRE(onset <= transient);
+            REQUIRE(onset >= transient - OnsetIndex::fftSize);
+        }
+
+        // Nothing but the bursts and, at most, the start of the noise floor
+        REQUIRE(index->getNumOnsets() <= static_cast<int>(transients.size()) + 1);
+    }
+
+    SECTION("Nearest-onset lookups pick the closer neighbour")
+    {
+        OnsetIndex index(transients, 150000, {});
+
+        REQUIRE(index.findNearest(0) == 12000);
+        REQUIRE(index.findNearest(20999) == 12000);
+        REQUIRE(index.findNearest(21001) == 30000);
+        REQUIRE(index.findNearest(55555) == 55555);
+        REQUIRE(index.findNearest(149999) == 123456);
+
+        OnsetIndex empty({}, 150000, {});
+        REQUIRE(empty.findNearest(1000) == -1);
+    }
+
+    SECTION("Indices survive a round trip through saved state")
+    {
+        OnsetIndex::SourceIdentity identity;
+        identity.path = "/material/breaks.flac";
+        identity.fileSize = 123456789;
+        identity.modificationTime = 1700000000000;
+
+        OnsetIndex index(transients, 150000, identity);
+        const auto data = index.toStateData();
+        auto restored = OnsetIndex::fromStateData(data.getData(), data.getSize(), identity);
+
+        REQUIRE(restored != nullptr);
+        REQUIRE(restored->getSourceIdentity() == identity);
+        REQUIRE(restored->getLengthInSamples() == 150000);
+        REQUIRE(restored->getNumOnsets() == static_cast<int>(transients.size()));
+
+        for (int i = 0; i < restored->getNumOnsets(); ++i)
+            REQUIRE(restored->getOnset(i) == transients[static_cast<size_t>(i)]);
+
+        // An index saved for a file that has changed since is not decoded
+        auto changed = identity;
+        changed.fileSize += 1;
+        REQUIRE(OnsetIndex::fromStateData(data.getData(), data.getSize(), changed) == nullptr);
+    }
+
+    SECTION("The analyser publishes restored indices to the audio thread")
+    {
+        OnsetAnalyser analyser;
+
+        {
+            const OnsetAnalyser::ScopedIndex current(analyser);
+            REQUIRE(current.get() == nullptr);
+        }
+
+        analyser.setIndex(std::make_unique<OnsetIndex>(transients, 150000, OnsetIndex::SourceIdentity()));
+
+        const OnsetAnalyser::ScopedIndex current(analyser);
+        REQUIRE(current.get() != nullptr);
+        REQUIRE(current.get()->getNumOnsets() == static_cast<int>(transients.size()));
+        REQUIRE_FALSE(analyser.isAnalysing());
+    }
+}
+
+TEST_CASE("Analysis cache", "[sources]")
+{
+    const auto directory = juce::File::createTempFile("AnalysisCache");
+    REQUIRE(directory.createDirectory());
+
+    juce::TemporaryFile source(".wav");
+    writeTestWav(source.getFile(), 1, 48000 * 4);
+
+    const auto key = AnalysisCache::Key::of(source.getFile());
+    REQUIRE(key.isValid());
+    REQUIRE(key.fileSize == source.getFile().getSize());
+
+    const std::vector<juce::int64> onsets { 0, 24000, 96000, 150000 };
+    const OnsetIndex index(onsets, 48000 * 4, {});
+    const auto data = index.toCacheData();
+
+    SECTION("Stored sections map back in place")
+    {
+        AnalysisCache cache(directory);
+        REQUIRE(cache.open(key) == nullptr);
+        REQUIRE(cache.store(key, { { AnalysisCache::SectionType::onsets, data.getData(), data.getSize() } }));
+
+        auto entry = cache.open(key);
+        REQUIRE(entry != nullptr);
+
+        size_t size = 0;
+        const auto* section = entry->getSection(AnalysisCache::SectionType::onsets, size);
+        REQUIRE(size == data.getSize());
+        REQUIRE(reinterpret_cast<juce::pointer_sized_uint>(section) % 8 == 0);
+
+        auto restored = OnsetIndex::fromCacheData(section, size, {});
+        REQUIRE(restored != nullptr);
+        REQUIRE(restored->getLengthInSamples() == 48000 * 4);
+        REQUIRE(restored->getNumOnsets() == static_cast<int>(onsets.size()));
+
+        for (int i = 0; i < restored->getNumOnsets(); ++i)
+            REQUIRE(restored->getOnset(i) == onsets[static_cast<size_t>(i)]);
+    }
+
+    SECTION("Entries for changed content or modification times miss")
+    {
+        AnalysisCache cache(directory);
+        REQUIRE(cache.store(key, { { AnalysisCache::SectionType::onsets, data.getData(), data.getSize() } }));
+
+        auto touched = key;
+        touched.modificationTime += 1000;
+        REQUIRE(cache.open(touched) == nullptr);
+
+        // Same length, different samples
+        writeTestWav(source.getFile(), 2, 48000 * 2);
+        const auto rewritten = AnalysisCache::Key::of(source.getFile());
+        REQUIRE(rewritten.isValid());
+        REQUIRE(rewritten.contentHash != key.contentHash);
+        REQUIRE(cache.open(rewritten) == nullptr);
+
+        REQUIRE(OnsetIndex::fromCacheData(data.getData(), data.getSize() - 1, {}) == nullptr);
+    }
+
+    SECTION("Trimming keeps the cache within its budget")
+    {
+        AnalysisCache cache(directory, 1);
+        REQUIRE(cache.store(key, { { AnalysisCache::SectionType::onsets, data.getData(), data.getSize() } }));
+        REQUIRE(cache.open(key) == nullptr);
+        REQUIRE(directory.getNumberOfChildFiles(juce::File::findFiles) == 0);
+    }
+
+    directory.deleteRecursively();
+}
+
+TEST_CASE("Waveform overview", "[sources]")
+{
+    // Noise whose level steps up every 10000 samples, and a partial last peak
+    constexpr int numSamples = 100000;
+    std::vector<float> samples(numSamples);
+    juce::Random random(3);
+
+    for (int i = 0; i < numSamples; ++i)
+        samples[static_cast<size_t>(i)] = static_cast<float>(i / 10000 + 1) * 0.09f * (random.nextFloat() * 2.0f - 1.0f);
+
+    WaveformOverview::Builder builder(numSamples);
+
+    for (auto sample : samples)
+        builder.addSample(sample);
+
+    const auto overview = builder.build();
+    REQUIRE(overview->getLengthInSamples() == numSamples);
+
+    SECTION("Levels shrink by the ratio down to a single peak")
+    {
+        REQUIRE(overview->getNumPeaks(0) == (numSamples + WaveformOverview::baseSamplesPerPeak - 1) / WaveformOverview::baseSamplesPerPeak);
+
+        for (int level = 1; level < overview->getNumLevels(); ++level)
+            REQUIRE(overview->getNumPeaks(level) == (overview->getNumPeaks(level - 1) + WaveformOverview::levelRatio - 1)
+                                                        / WaveformOverview::levelRatio);
+
+        REQUIRE(overview->getNumPeaks(overview->getNumLevels() - 1) == 1);
+
+        REQUIRE(overview->getLevelFor(1.0) == 0);
+        REQUIRE(overview->getLevelFor(1.0e9) == overview->getNumLevels() - 1);
+        REQUIRE(overview->getSamplesPerPeak(overview->getLevelFor(5000.0)) <= 5000);
+        REQUIRE(overview->getSamplesPerPeak(overview->getLevelFor(5000.0) + 1) > 5000);
+    }
+
+    SECTION("Every level covers the samples of the span it is asked for")
+    {
+        for (int level = 0; level < overview->getNumLevels(); ++level)
+        {
+            for (int trial = 0; trial < 20; ++trial)
+            {
+                const auto start = random.nextInt(numSamples - 1);
+                const auto end = start + 1 + random.nextInt(numSamples - start);
+                const auto begin = samples.begin();
+                const auto range = overview->getRange(level, start, end);
+
+                REQUIRE(range.getStart() <= *std::min_element(begin + start, begin + end));
+                REQUIRE(range.getEnd() >= *std::max_element(begin + start, begin + end));
+            }
+        }
+
+        // Peak-aligned spans of the finest level are exact to the 8-bit step
+        const auto range = overview->getRange(0, 2560, 5120);
+        REQUIRE(range.getEnd() == Approx(*std::max_element(samples.begin() + 2560, samples.begin() + 5120)).margin(1.0 / 127.0));
+        REQUIRE(range.getStart() == Approx(*std::min_element(samples.begin() + 2560, samples.begin() + 5120)).margin(1.0 / 127.0));
+    }
+
+    SECTION("Overviews survive a round trip through the analysis cache")
+    {
+        const auto data = overview->toCacheData();
+        const auto restored = WaveformOverview::fromCacheData(data.getData(), data.getSize());
+
+        REQUIRE(restored != nullptr);
+        REQUIRE(restored->getLengthInSamples() == numSamples);
+        REQUIRE(restored->getNumLevels() == overview->getNumLevels());
+
+        for (int level = 0; level < overview->getNumLevels(); ++level)
+        {
+            const auto expected = overview->getRange(level, 0, numSamples);
+            REQUIRE(restored->getRange(level, 0, numSamples) == expected);
+        }
+
+        REQUIRE(WaveformOverview::fromCacheData(data.getData(), data.getSize() - 2) == nullptr);
+        REQUIRE(WaveformOverview::fromCacheData(data.getData(), 4) == nullptr);
+    }
+
+    SECTION("The analyser builds overviews with the onsets and caches them")
+    {
+        const auto directory = juce::File::createTempFile("AnalysisCache");
+        REQUIRE(directory.createDirectory());
+
+        juce::TemporaryFile source(".wav");
+        writeTestWav(source.getFile(), 2, 48000 * 2);
+
+        const auto waitForOverview = [](const OnsetAnalyser& analyser)
+        {
+            for (int i = 0; i < 500 && analyser.getOverview() == nullptr; ++i)
+                juce::Thread::sleep(10);
+
+            return analyser.getOverview();
+        };
+
+        {
+            OnsetAnalyser analyser(std::make_unique<AnalysisCache>(directory));
+            analyser.analyse(source.getFile(), 1);
+
+            const auto built = waitForOverview(analyser);
+            REQUIRE(built != nullptr);
+            REQUIRE(built->getLengthInSamples() == 48000 * 2);
+
+            // The mono mix of the ramp and its half peaks at three quarters of full scale
+            REQUIRE(built->getRange(0, 0, 48000 * 2).getEnd() == Approx(0.75f).margin(0.01f));
+        }
+
+        // Restored sessions bring their onsets but look the overview up afresh
+        OnsetAnalyser restored(std::make_unique<AnalysisCache>(directory));
+        restored.setIndex(std::make_unique<OnsetIndex>(std::vector<juce::int64>(), 48000 * 2, OnsetIndex::SourceIdentity()),
+                          1, source.getFile());
+
+        REQUIRE_FALSE(restored.isAnalysing());
+        REQUIRE(waitForOverview(restored) != nullptr);
+
+        restored.clear();
+        REQUIRE(restored.getOverview() == nullptr);
+
+        directory.deleteRecursively();
+    }
+}
+
+TEST_CASE("Background source loading", "[sources]")
+{
+    juce::TemporaryFile firstFile(".wav"), secondFile(".wav");
+    writeTestWav(firstFile.getFile(), 1, 48000);
+    writeTestWav(secondFile.getFile(), 2, 96000);
+
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 480;
+
+    SourceLoader loader;
+    loader.prepare(sampleRate, 0.1);
+
+    const auto waitForLoad = [&loader]
+    {
+        for (int i = 0; i < 500 && loader.isLoading(); ++i)
+            juce::Thread::sleep(10);
+
+        REQUIRE_FALSE(loader.isLoading());
+    };
+
+    SECTION("Loading returns at once and the audio thread takes the source over")
+    {
+        REQUIRE(loader.canLoad(firstFile.getFile()));
+        const auto tag = loader.load(firstFile.getFile());
+        REQUIRE(loader.getRequestedFile() == firstFile.getFile());
+
+        waitForLoad();
+        REQUIRE(loader.getCurrent() == nullptr);
+
+        loader.beginBlock(blockSize);
+        REQUIRE(loader.getCurrent() != nullptr);
+        REQUIRE(loader.getCurrent()->tag == tag);
+        REQUIRE(loader.getCurrent()->file == firstFile.getFile());
+        REQUIRE(loader.getCurrent()->source->getReadableRange().getLength() == 48000);
+    }
+
+    SECTION("New grains cross over during the fade, and the old source is kept for the last of them")
+    {
+        loader.load(firstFile.getFile());
+        waitForLoad();
+        loader.beginBlock(blockSize);
+
+        loader.load(secondFile.getFile());
+        waitForLoad();
+        loader.beginBlock(blockSize);
+
+        REQUIRE(loader.getCurrent()->file == secondFile.getFile());
+        REQUIRE(loader.isFading());
+        REQUIRE(loader.getFading()->file == firstFile.getFile());
+        REQUIRE(loader.getCrossfade() == Approx(0.0f));
+
+        const auto fadeBlocks = static_cast<int>(std::ceil(SourceLoader::crossfadeSeconds * sampleRate / blockSize));
+        const auto holdBlocks = static_cast<int>(std::ceil(0.1 * sampleRate / blockSize));
+
+        for (int i = 0; i < fadeBlocks / 2; ++i)
+            loader.beginBlock(blockSize);
+
+        REQUIRE(loader.getCrossfade() == Approx(0.5f).margin(0.05f));
+
+        for (int i = fadeBlocks / 2; i < fadeBlocks + holdBlocks - 1; ++i)
+            loader.beginBlock(blockSize);
+
+        REQUIRE(loader.getCrossfade() == Approx(1.0f));
+        REQUIRE(loader.isFading());
+
+        loader.beginBlock(blockSize);
+        loader.beginBlock(blockSize);
+        REQUIRE_FALSE(loader.isFading());
+        REQUIRE(loader.getFading() == nullptr);
+    }
+
+    SECTION("A source cut off mid-fade is kept until its last grains have ended")
+    {
+        juce::TemporaryFile thirdFile(".wav");
+        writeTestWav(thirdFile.getFile(), 1, 24000);
+
+        loader.load(firstFile.getFile());
+        waitForLoad();
+        loader.beginBlock(blockSize);
+
+        loader.load(secondFile.getFile());
+        waitForLoad();
+        loader.beginBlock(blockSize);
+
+        // Only the loader holds the first source, so it lives exactly as long as the loader keeps it
+        const std::weak_ptr<GrainSource> first = loader.getFading()->source;
+        const auto holdBlocks = static_cast<int>(std::ceil(0.1 * sampleRate / blockSize));
+
+        loader.beginBlock(blockSize);
+        REQUIRE(loader.getCrossfade() > 0.0f);
+        REQUIRE(loader.getCrossfade() < 1.0f);
+
+        // A third source arrives while the first is still fading out
+        loader.load(thirdFile.getFile());
+        waitForLoad();
+        loader.beginBlock(blockSize);
+
+        REQUIRE(loader.getCurrent()->file == thirdFile.getFile());
+        REQUIRE(loader.getFading()->file == secondFile.getFile());
+
+        // However long the loading thread runs, grains spawned just before the switch may still be reading it
+        for (int i = 0; i < holdBlocks - 1; ++i)
+        {
+            loader.beginBlock(blockSize);
+            juce::Thread::sleep(SourceLoader::reclaimIntervalMs / 10);
+        }
+
+        juce::Thread::sleep(SourceLoader::reclaimIntervalMs * 4);
+        REQUIRE_FALSE(first.expired());
+
+        // Once the hold has been rendered, the loading thread frees it
+        loader.beginBlock(blockSize);
+        loader.beginBlock(blockSize);
+
+        for (int i = 0; i < 100 && ! first.expired(); ++i)
+            juce::Thread::sleep(SourceLoader::reclaimIntervalMs / 5);
+
+        REQUIRE(first.expired());
+    }
+
+    SECTION("A fade that ends mid-block keeps the old source for grains spawned late in its last block")
+    {
+        // The 11025-sample fade ends partway through a 1024-sample block, and grains spawn until that block's end
+        constexpr double fadeSampleRate = 44100.0;
+        constexpr int fadeBlockSize = 1024;
+        loader.prepare(fadeSampleRate, 1.0);
+
+        loader.load(firstFile.getFile());
+        waitForLoad();
+        loader.beginBlock(fadeBlockSize);
+
+        loader.load(secondFile.getFile());
+        waitForLoad();
+        loader.beginBlock(fadeBlockSize);
+
+        const std::weak_ptr<GrainSource> first = loader.getFading()->source;
+        const auto crossfadeLength = static_cast<int>(std::ceil(SourceLoader::crossfadeSeconds * fadeSampleRate));
+        const auto holdLength = static_cast<int>(fadeSampleRate);
+        REQUIRE(crossfadeLength % fadeBlockSize != 0);
+
+        // The last grain starts before the end of the last block with a crossfade below 1
+        const auto lastSpawnEnd = (crossfadeLength / fadeBlockSize + 1) * fadeBlockSize;
+        const auto lastGrainEnd = lastSpawnEnd + holdLength;
+        int rendered = fadeBlockSize;
+
+        for (; rendered < lastGrainEnd; rendered += fadeBlockSize)
+            loader.beginBlock(fadeBlockSize);
+
+        // The block that renders the end of the last grain has started, so the source must still be there
+        REQUIRE(rendered - fadeBlockSize < lastGrainEnd);
+        juce::Thread::sleep(SourceLoader::reclaimIntervalMs * 4);
+        REQUIRE_FALSE(first.expired());
+
+        loader.beginBlock(fadeBlockSize);
+        REQUIRE_FALSE(loader.isFading());
+
+        for (int i = 0; i < 100 && ! first.expired(); ++i)
+            juce::Thread::sleep(SourceLoader::reclaimIntervalMs / 5);
+
+        REQUIRE(first.expired());
+    }
+
+    SECTION("Files that fail to open leave the current source in place")
+    {
+        juce::TemporaryFile broken(".wav");
+        REQUIRE(broken.getFile().replaceWithText("not audio"));
+
+        loader.load(firstFile.getFile());
+        waitForLoad();
+        loader.beginBlock(blockSize);
+
+        loader.load(broken.getFile());
+        waitForLoad();
+        loader.beginBlock(blockSize);
+
+        REQUIRE(loader.getCurrent()->file == firstFile.getFile());
+        REQUIRE(loader.getRequestedFile() == firstFile.getFile());
+    }
+
+    SECTION("Clearing returns to the live input")
+    {
+        loader.load(firstFile.getFile());
+        waitForLoad();
+        loader.beginBlock(blockSize);
+
+        const auto tag = loader.clear();
+        waitForLoad();
+        loader.beginBlock(blockSize);
+
+        REQUIRE(loader.getCurrent()->tag == tag);
+        REQUIRE(loader.getCurrent()->source == nullptr);
+        REQUIRE(loader.getRequestedFile() == juce::File());
+    }
+
+    SECTION("Loaders opening the same file share one source")
+    {
+        SourceLoader other;
+        const juce::SharedResourcePointer<SourceRegistry> registry;
+
+        loader.load(firstFile.getFile());
+        other.load(firstFile.getFile());
+        waitForLoad();
+
+        for (int i = 0; i < 500 && other.isLoading(); ++i)
+            juce::Thread::sleep(10);
+
+        loader.beginBlock(blockSize);
+        other.beginBlock(blockSize);
+
+        REQUIRE(loader.getCurrent()->source != nullptr);
+        REQUIRE(loader.getCurrent()->source == other.getCurrent()->source);
+        REQUIRE(registry->getNumSources() == 1);
+    }
+}
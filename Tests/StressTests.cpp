@@ -0,0 +1,280 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "GrainResampler.h"
+#include "PluginProcessor.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+/**
+ * Stress tests - processBlock at its worst case, timed against the real-time budget
+ * Each scenario drives a processor at the smallest block size the plugin is expected to meet,
+ * with the densest cloud, the longest grains, the sinc resampler, both per-grain effects and
+ * every note voice held, and fails if the 99th-percentile block load goes over the allowed
+ * share of the budget, if it rose too far above the recorded baseline for this architecture,
+ * or if the real-time guard caught the callback allocating, locking or touching files.
+ *
+ * With GRANULAR_STRESS_TESTS on, CTest runs every scenario on its own and passes the limits in
+ * from the cache variables:
+ *   GRANULAR_STRESS_BUDGET             p99 load allowed, as a fraction of the budget
+ *   GRANULAR_STRESS_TOLERANCE          how far above its baseline a scenario may rise, 0.25 = 25%
+ *   GRANULAR_STRESS_REQUIRE_BASELINES  1 fails a scenario that has no baseline instead of warning
+ * and these are read from the environment when set:
+ *   GRANULAR_STRESS_BLOCKS             blocks timed per scenario
+ *   GRANULAR_STRESS_WRITE_BASELINES    1 records the measured loads as this architecture's baselines
+ *
+ * Baselines live in Tests/Baselines, one JSON file per architecture, so the x86_64 and arm64
+ * slices of a universal build are each held to their own numbers.
+ */
+namespace
+{
+    using Processor = GranularPlunderphonicsAudioProcessor;
+
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 32;
+    constexpr int warmUpBlocks = 1000;   // Long enough for the grain pool and every voice to fill up
+    constexpr int numNotes = 16;
+
+   #if JUCE_DEBUG
+    constexpr bool isDebugBuild = true;
+   #else
+    constexpr bool isDebugBuild = false;
+   #endif
+
+    struct Result
+    {
+        double p99Load = 0.0, peakLoad = 0.0;   // 1 = the whole budget
+        int activeGrains = 0;
+        juce::uint32 violations = 0;
+    };
+
+    double getEnvironment(const char* name, double defaultValue)
+    {
+        const auto value = juce::SystemStats::getEnvironmentVariable(name, {});
+        return value.isNotEmpty() ? value.getDoubleValue() : defaultValue;
+    }
+
+    juce::String getArchitecture()
+    {
+       #if defined(__aarch64__) || defined(_M_ARM64)
+        return "arm64";
+       #elif defined(__x86_64__) || defined(_M_X64)
+        return "x86_64";
+       #else
+        return "unknown";
+       #endif
+    }
+
+    juce::File getBaselineFile()
+    {
+        return juce::File(GRANULAR_STRESS_BASELINE_DIR).getChildFile(getArchitecture() + ".json");
+    }
+
+    /** The grain cloud at its most expensive: every grain the pool holds, resampled with sinc and filtered and crushed. */
+    void configureWorstCaseCloud(Processor& processor)
+    {
+        const auto& parameters = processor.getParameters();
+
+        parameters[ParameterSnapshot::mix]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::density]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::grainSize]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::spray]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::pitch]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::quality]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::filter]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::resonance]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::crushBits]->setValueNotifyingHost(0.0f);
+        parameters[ParameterSnapshot::downsample]->setValueNotifyingHost(1.0f);
+    }
+
+    /** Prepares a processor configured by configure, warms it up and times numBlocks blocks of noise. */
+    Result run(const std::function<void(Processor&)>& configure, bool holdNotes)
+    {
+        Processor processor;
+        configure(processor);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        // The sinc table is shared, so waiting on any resampler waits for the processor's as well
+        GrainResampler resampler;
+        resampler.waitForTables();
+
+        const auto numInputs = processor.getTotalNumInputChannels();
+        juce::AudioBuffer<float> buffer(juce::jmax(numInputs, processor.getTotalNumOutputChannels()), blockSize);
+        juce::MidiBuffer notes, noEvents;
+
+        if (holdNotes)
+            for (int note = 0; note < numNotes; ++note)
+                notes.addEvent(juce::MidiMessage::noteOn(1, 48 + 2 * note, 1.0f), note);
+
+        // Everything the measurement needs is allocated up front
+        const auto numBlocks = juce::jmax(100, static_cast<int>(getEnvironment("GRANULAR_STRESS_BLOCKS", 8000.0)));
+        std::vector<double> loads(static_cast<size_t>(numBlocks));
+        const auto budgetSeconds = blockSize / sampleRate;
+        juce::Random random(1);
+
+        // The guard watches the warm-up as well, since the first blocks are where buffers would grow
+        RealtimeGuard::resetViolations();
+
+        for (int block = -warmUpBlocks; block < numBlocks; ++block)
+        {
+            for (int channel = 0; channel < numInputs; ++channel)
+                for (int i = 0; i < blockSize; ++i)
+                    buffer.setSample(channel, i, random.nextFloat() * 2.0f - 1.0f);
+
+            const auto startTicks = juce::Time::getHighResolutionTicks();
+            processor.processBlock(buffer, block == -warmUpBlocks ? notes : noEvents);
+            const auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+            if (block >= 0)
+                loads[static_cast<size_t>(block)] = elapsed / budgetSeconds;
+        }
+
+        Result result;
+        result.violations = RealtimeGuard::getTotalViolations();
+        result.activeGrains = processor.getNumActiveGrains();
+        processor.releaseResources();
+
+        auto percentile = loads.begin() + (numBlocks * 99) / 100;
+        std::nth_element(loads.begin(), percentile, loads.end());
+        result.p99Load = *percentile;
+        result.peakLoad = *std::max_element(percentile, loads.end());
+        return result;
+    }
+
+    /** Records result as the scenario's baseline in this architecture's file. */
+    void writeBaseline(const juce::String& scenario, const Result& result)
+    {
+        const auto file = getBaselineFile();
+        auto baselines = juce::JSON::parse(file);
+
+        if (! baselines.isObject())
+            baselines = new juce::DynamicObject();
+
+        auto* object = baselines.getDynamicObject();
+        object->setProperty("architecture", getArchitecture());
+        object->setProperty("sampleRate", sampleRate);
+        object->setProperty("blockSize", blockSize);
+
+        if (! object->getProperty("p99Load").isObject())
+            object->setProperty("p99Load", new juce::DynamicObject());
+
+        object->getProperty("p99Load").getDynamicObject()->setProperty(scenario, result.p99Load);
+        REQUIRE(file.replaceWithText(juce::JSON::toString(baselines) + "\n"));
+
+        WARN("Recorded a p99 load of " << result.p99Load << " as the " << getArchitecture() << " baseline for " << scenario);
+    }
+
+    /** Applies every check a scenario must pass; see the comment at the top. */
+    void check(const juce::String& scenario, const Result& result)
+    {
+        INFO(scenario << " on " << getArchitecture() << ": p99 load " << result.p99Load
+                      << ", peak load " << result.peakLoad << ", " << result.activeGrains << " grains");
+
+        if (RealtimeGuard::isEnabled)
+            REQUIRE(result.violations == 0);
+        else
+            WARN("Built without GRANULAR_REALTIME_GUARD; real-time safety is not checked");
+
+        if (isDebugBuild)
+        {
+            WARN("Debug build; block times are not checked against the budget or the baselines");
+            return;
+        }
+
+        REQUIRE(result.p99Load <= getEnvironment("GRANULAR_STRESS_BUDGET", 0.5));
+
+        if (getEnvironment("GRANULAR_STRESS_WRITE_BASELINES", 0.0) != 0.0)
+        {
+            writeBaseline(scenario, result);
+            return;
+        }
+
+        const auto baselines = juce::JSON::parse(getBaselineFile());
+        const auto baseline = baselines["p99Load"][juce::Identifier(scenario)];
+        const auto comparable = static_cast<double>(baselines["sampleRate"]) == sampleRate
+                             && static_cast<int>(baselines["blockSize"]) == blockSize;
+
+        if (baseline.isVoid() || ! comparable)
+        {
+            // Without a baseline a slowdown goes unnoticed, so runs that must catch one can insist on it
+            const auto message = "No " + getArchitecture() + " baseline for " + scenario
+                               + " at this rate and block size; record one with GRANULAR_STRESS_WRITE_BASELINES=1";
+
+            if (getEnvironment("GRANULAR_STRESS_REQUIRE_BASELINES", 0.0) != 0.0)
+                FAIL(message);
+
+            WARN(message);
+            return;
+        }
+
+        REQUIRE(result.p99Load <= static_cast<double>(baseline) * (1.0 + getEnvironment("GRANULAR_STRESS_TOLERANCE", 0.25)));
+    }
+
+    /** Counts violations for check() instead of trapping on them, for as long as it is in scope. */
+    struct ScopedViolationCounting
+    {
+        ScopedViolationCounting() { RealtimeGuard::setTrapOnViolation(false); }
+        ~ScopedViolationCounting() { RealtimeGuard::setTrapOnViolation(true); }
+    };
+}
+
+//==============================================================================
+TEST_CASE("Granular cloud stress", "[stress]")
+{
+    const ScopedViolationCounting counting;
+    const auto result = run(configureWorstCaseCloud, true);
+
+    REQUIRE(result.activeGrains > 0);
+    check("granularCloud", result);
+}
+
+TEST_CASE("Multi-core granular cloud stress", "[stress]")
+{
+    const ScopedViolationCounting counting;
+
+    const auto result = run([](Processor& processor)
+    {
+        configureWorstCaseCloud(processor);
+        processor.getParameters()[ParameterSnapshot::multiCore]->setValueNotifyingHost(1.0f);
+    }, true);
+
+    REQUIRE(result.activeGrains > 0);
+    check("multiCoreGranularCloud", result);
+}
+
+TEST_CASE("Surround output stress", "[stress]")
+{
+    const ScopedViolationCounting counting;
+
+    // Stereo in to 7.1 out: the downmix, seven panned channels per grain and the widest output mix
+    const auto result = run([](Processor& processor)
+    {
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add(juce::AudioChannelSet::stereo());
+        layout.outputBuses.add(juce::AudioChannelSet::create7point1());
+        REQUIRE(processor.setBusesLayout(layout));
+
+        configureWorstCaseCloud(processor);
+    }, true);
+
+    REQUIRE(result.activeGrains > 0);
+    check("surroundOutput", result);
+}
+
+TEST_CASE("Spectral engine stress", "[stress]")
+{
+    const ScopedViolationCounting counting;
+
+    const auto result = run([](Processor& processor)
+    {
+        const auto& parameters = processor.getParameters();
+        parameters[ParameterSnapshot::mix]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::mode]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::smear]->setValueNotifyingHost(1.0f);
+        parameters[ParameterSnapshot::shuffle]->setValueNotifyingHost(1.0f);
+    }, false);
+
+    check("spectralEngine", result);
+}